@@ -689,6 +689,8 @@ static const char *node_disp_name(const Node *n, char *buf, size_t bufsz) {
     if (n->x == 'a') {
         const char *v = (n->val && n->val[0]) ? n->val : "____";
         snprintf(buf, bufsz, "[%s] %s", n->name, v);
+        /* 多选结果是多行：显示时折成一行 */
+        for (char *c = buf; *c; c++) if (*c == '\n' || *c == '\r' || *c == '\t') *c = ' ';
     } else if (n->x == 'b') {
         snprintf(buf, bufsz, "[ ] %s", n->name);
     } else { /* 'c' */
@@ -1212,6 +1214,32 @@ static Node *ui_get_cursor_node(UI *u) {
     return row_selected_node(&u->rows[c][r], u->sel_sub[c]);
 }
 
+/* 预取：当前列里带 cmd 的 a 类节点，离光标近的在前（dim=2 的子集行逐个展开） */
+static void ui_prefetch(UI *u, HotPopup *pop) {
+    Node *nodes[HOT_PREFETCH_MAX];
+    int n = 0;
+    int c = u->focus_col;
+    if (c >= 0 && c < u->col_count && u->nrows[c] > 0) {
+        int sel = u->sel_row[c];
+        if (sel < 0) sel = 0;
+        if (sel >= u->nrows[c]) sel = u->nrows[c] - 1;
+        for (int d = 0; d < u->nrows[c] && n < HOT_PREFETCH_MAX; d++) {
+            for (int side = 0; side < 2 && n < HOT_PREFETCH_MAX; side++) {
+                if (d == 0 && side == 1) break;
+                int r = side ? sel - d : sel + d;
+                if (r < 0 || r >= u->nrows[c]) continue;
+                const Row *row = &u->rows[c][r];
+                int cnt = row->type == ROW_HGROUP ? visible_child_count(row->node) : 1;
+                for (int k = 0; k < cnt && n < HOT_PREFETCH_MAX; k++) {
+                    Node *nd = row->type == ROW_HGROUP ? nth_visible_child(row->node, k) : row->node;
+                    if (nd && nd->x == 'a' && nd->cmd && nd->cmd[0]) nodes[n++] = nd;
+                }
+            }
+        }
+    }
+    hot_prefetch(pop, nodes, n);
+}
+
 static void run_tui(Ndx *ndx) {
 
     validate_subset_dim_or_die(ndx);
@@ -1236,6 +1264,13 @@ static void run_tui(Ndx *ndx) {
     keypad(stdscr, TRUE);
     curs_set(0);
 
+    /* Host bracketed paste: a paste arrives as one key run between
+     * HOT_KEY_PASTE_BEGIN/END, so the hot popup can forward it in one write. */
+    define_key("\x1b[200~", HOT_KEY_PASTE_BEGIN);
+    define_key("\x1b[201~", HOT_KEY_PASTE_END);
+    fputs("\x1b[?2004h", stdout);
+    fflush(stdout);
+
     if (has_colors()) {
         start_color();
         use_default_colors();
@@ -1250,13 +1285,18 @@ static void run_tui(Ndx *ndx) {
     hot_init(&pop);
     Node *hot_suppress = NULL;
 
+    /* a 类节点的 cmd 在光标停留 pop.dwell_ms 之后才运行（快速移动光标时不启动），
+     * 期间相邻节点的选择器输入已在后台预取（ui_prefetch） */
+    Node *hot_dwell = NULL;
+    uint64_t hot_dwell_until = 0;
+    Node *pf_cursor = NULL;
+    uint64_t vals_us = 0; /* last relayout for OSC 7717 values */
+
     bool force_redraw = false;
-    uint64_t last_hot_draw_ms = 0;
-    uint64_t last_hot_pump_ms = 0;
 
-    /* Hot-terminal render/pump pacing (ms). Lower FPS drastically reduces CPU
-     * for heavy ncurses apps like htop running inside our simple renderer. */
-    const uint64_t HOT_FRAME_MS = 100;      /* ~10 FPS */
+    /* Hot-terminal pacing lives in mterm.c (HotPacer): the pty is pumped as
+     * soon as poll() reports output, and frames are drawn when the echo of a
+     * forwarded key arrives or when the adaptive frame interval elapses. */
 
     /* Resize coalescing: during mouse-drag resize, KEY_RESIZE can fire in a
      * tight loop and cause 90%+ CPU. We only apply the final size after the
@@ -1296,6 +1336,18 @@ static void run_tui(Ndx *ndx) {
         bool hot_geom_changed = false;
         bool hot_autorun = false;
 
+        /* a running command sent a value (OSC 7717): relayout the menu at
+         * most once per frame, so a command streaming values still leaves
+         * room for drawing and keys */
+        if (pop.vals_changed) {
+            uint64_t now = hot_now_us();
+            if (now - vals_us >= pop.pace.frame_us) {
+                pop.vals_changed = false;
+                vals_us = now;
+                dirty = true;
+            }
+        }
+
         bool need_redraw = dirty || force_redraw;
 
         if (dirty) {
@@ -1316,6 +1368,14 @@ static void run_tui(Ndx *ndx) {
         if (visible_cols < u.focus_col + 1) visible_cols = u.focus_col + 1;
         u.col_count = visible_cols;
 
+        /* popup closed itself (fzy selection / Ctrl+X): do not reopen it on
+         * the same node until the cursor moves away */
+        if (pop.closed_by_enter) {
+            hot_suppress = pop.last_owner;
+            pop.closed_by_enter = false;
+            pop.last_owner = NULL;
+        }
+
         /* a 类热点：光标停留在 x=='a' 的节点上时弹出，并允许在红框内运行 top */
         Node *cursor = ui_get_cursor_node(&u);
         if (hot_suppress && cursor != hot_suppress) hot_suppress = NULL;
@@ -1326,13 +1386,14 @@ static void run_tui(Ndx *ndx) {
 
         if (!want_hot) {
             if (pop.active) {
-                hot_close(&pop);
+                /* running sessions are parked, not killed (see hot_detach) */
+                hot_detach(&pop);
                 need_redraw = true;
                 base_force = true; /* erase old popup area */
             }
         } else {
             if (!pop.active || pop.owner != cursor) {
-                hot_close(&pop);
+                hot_detach(&pop);
                 pop.active = true;
                 pop.mode = HOT_INPUT;
                 pop.owner = cursor;
@@ -1341,7 +1402,18 @@ static void run_tui(Ndx *ndx) {
                 need_redraw = true;
                 base_force = true;
 
-                if (cursor && cursor->cmd && cursor->cmd[0]) hot_autorun = true;
+                /* Coming back to a node whose session is still alive in the
+                 * background: reattach it with its screen intact. */
+                hot_dwell = NULL;
+                if (!hot_attach(&pop, cursor) && cursor && cursor->cmd && cursor->cmd[0]) {
+                    hot_dwell = cursor;
+                    hot_dwell_until = now_ms() + (uint64_t)pop.dwell_ms;
+                }
+            }
+            if (hot_dwell && (hot_dwell != cursor || pop.owner != cursor || pop.mode != HOT_INPUT)) hot_dwell = NULL;
+            if (hot_dwell && now_ms() >= hot_dwell_until) {
+                hot_dwell = NULL;
+                hot_autorun = true;
             }
 
             int xs[MAX_COLS] = {0}, ws[MAX_COLS] = {0};
@@ -1374,55 +1446,75 @@ static void run_tui(Ndx *ndx) {
                 }
             }
 
-            bool do_pump = true;
-            if (pop.active && pop.mode == HOT_TERM) {
-                uint64_t now = now_ms();
-                if (now - last_hot_pump_ms < HOT_FRAME_MS) {
-                    do_pump = false;
-                } else {
-                    last_hot_pump_ms = now;
-                }
-            }
-            if (do_pump && hot_pump(&pop)) {
+            if (hot_pump(&pop)) {
                 need_redraw = true;
             }
+            /* output pumped earlier but not yet drawn (frame was not due) */
+            if (pop.active && pop.mode == HOT_TERM && pop.pace.dirty) need_redraw = true;
+        }
+
+        if (!want_hot) hot_dwell = NULL;
+        if (cursor != pf_cursor || base_rebuilt) {
+            pf_cursor = cursor;
+            ui_prefetch(&u, &pop);
+        }
+
+        hot_bg_pump(&pop);
+        /* values that arrived since the relayout: wake up when it is due */
+        int vals_left = -1;
+        if (pop.vals_changed) {
+            uint64_t since = hot_now_us() - vals_us;
+            vals_left = since >= pop.pace.frame_us ? 0 : (int)((pop.pace.frame_us - since + 999u) / 1000u);
         }
 
         if (need_redraw) {
             bool did_draw = true;
-            if (pop.active && pop.mode == HOT_TERM) {
-                uint64_t now = now_ms();
-                if (now - last_hot_draw_ms < HOT_FRAME_MS) {
-                    did_draw = false;
-                } else {
-                    last_hot_draw_ms = now;
-                }
+            bool hot_frame = pop.active && pop.mode == HOT_TERM;
+            if (hot_frame && !(base_rebuilt || force_redraw || base_force)) {
+                did_draw = hot_frame_due(&pop, hot_now_us());
             }
             if (did_draw) {
+                uint64_t t0 = hot_now_us();
                 /* Avoid redrawing the whole main UI for every frame while a
                  * hot-terminal is running; usually only the popup changes. */
-                bool need_base = base_rebuilt || force_redraw || base_force || !(pop.active && pop.mode == HOT_TERM);
+                bool need_base = base_rebuilt || force_redraw || base_force || !(pop.active && pop.mode != HOT_INPUT);
                 if (need_base) {
                     draw_ui(&u);
+                    hot_touch(&pop);
                 }
                 if (pop.active) {
                     hot_draw(&pop);
                 }
                 doupdate();
+                if (hot_frame && pop.active && pop.mode == HOT_TERM) hot_frame_done(&pop, t0, hot_now_us());
                 force_redraw = false;
             }
         }
 
-        if (pop.closed_by_enter) {
-            hot_suppress = pop.last_owner;
-            pop.closed_by_enter = false;
-            pop.last_owner = NULL;
+        /* time left until the dwelling node autoruns or the menu relayouts, -1 = none */
+        int wake_left = -1;
+        if (hot_dwell) {
+            uint64_t now = now_ms();
+            wake_left = now >= hot_dwell_until ? 0 : (int)(hot_dwell_until - now);
         }
+        if (vals_left >= 0 && (wake_left < 0 || vals_left < wake_left)) wake_left = vals_left;
 
-        if (pop.active && pop.mode == HOT_TERM) timeout((int)HOT_FRAME_MS);
-        else timeout(-1);
-
-        int ch = getch();
+        int ch;
+        if ((pop.active && pop.mode != HOT_INPUT) || hot_bg_busy(&pop)) {
+            /* Non-blocking read first (ncurses may hold buffered keys), then
+             * sleep on keyboard + pty until the next frame is due. */
+            timeout(0);
+            ch = getch();
+            if (ch == ERR) {
+                int ms = hot_wait_ms(&pop, hot_now_us());
+                if (wake_left >= 0 && (ms < 0 || wake_left < ms)) ms = wake_left;
+                hot_wait(&pop, STDIN_FILENO, ms);
+                continue;
+            }
+        } else {
+            timeout(wake_left);
+            ch = getch();
+        }
         if (ch == ERR) continue;
 
         /* Always handle resize at the top-level, even when hot popup is active.
@@ -1447,7 +1539,19 @@ static void run_tui(Ndx *ndx) {
 
         if (pop.active) {
             if (hot_handle_key(&pop, ch)) {
-                if (pop.mode == HOT_INPUT) force_redraw = true;
+                /* A paste arrives as one key per byte: take what is already
+                 * buffered in one go, so keys typed after it (Ctrl+X) are
+                 * not stuck behind a full main-loop pass per byte. */
+                while (pop.active && pop.mode == HOT_TERM && pop.pasting) {
+                    timeout(0);
+                    int c2 = getch();
+                    if (c2 == ERR) break;
+                    if (c2 == KEY_RESIZE) { ungetch(c2); break; }
+                    hot_handle_key(&pop, c2);
+                }
+                /* typing into the input line: do not autorun over it */
+                hot_dwell = NULL;
+                if (pop.mode == HOT_INPUT || !pop.active) force_redraw = true;
                 continue;
             }
         }
@@ -1517,6 +1621,9 @@ static void run_tui(Ndx *ndx) {
         }
     }
 
+    hot_shutdown(&pop);
+    fputs("\x1b[?2004l", stdout);
+    fflush(stdout);
     endwin();
     ui_free_rows(&u);
 }
@@ -0,0 +1,300 @@
+#define _GNU_SOURCE
+
+#include "mcg.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+/* =========================
+ *  cgroup v2（不依赖 curses）
+ *  - 自己所在的 cgroup：/proc/self/cgroup 的 "0::<路径>"，挂载点取自 mountinfo
+ *  - 只在被委派时使用：层级的根 cgroup，或目录属于当前（非 root）用户，
+ *    或带 systemd 的 trusted.delegate / user.delegate 标记
+ *  - perftui 先把自己移进子组 "perftui"（有进程的组不能给子组开控制器），
+ *    再在 cgroup.subtree_control 里打开 cpu / memory / cpuset；
+ *    退出时（cg_root_close）关掉打开过的控制器、移回原组并删除 "perftui"
+ *  - 每条命令一个 "hot-<pid>-<序号>" 子组；cpu.stat、memory.peak 保持打开，pread 读取
+ * ========================= */
+
+/* Write s to dir/name; false on error. */
+static bool cg_write(const char *dir, const char *name, const char *s) {
+    char path[700];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    size_t n = strlen(s);
+    bool ok = write(fd, s, n) == (ssize_t)n;
+    close(fd);
+    return ok;
+}
+
+static bool cg_read_file(const char *dir, const char *name, char *buf, size_t cap) {
+    char path[700];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    ssize_t r = read(fd, buf, cap - 1);
+    close(fd);
+    if (r < 0) return false;
+    buf[r] = 0;
+    return true;
+}
+
+/* word is one of the space-separated words in list. */
+static bool cg_has_word(const char *list, const char *word) {
+    size_t n = strlen(word);
+    for (const char *q = list; (q = strstr(q, word)) != NULL; q += n) {
+        bool start = q == list || q[-1] == ' ';
+        bool end = q[n] == 0 || q[n] == ' ' || q[n] == '\n';
+        if (start && end) return true;
+    }
+    return false;
+}
+
+/* Mount point of the cgroup2 hierarchy. */
+static bool cg_mount(char *out, size_t cap) {
+    FILE *f = fopen("/proc/self/mountinfo", "re");
+    if (!f) return false;
+    char line[1024];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), f)) {
+        /* "id parent maj:min root mountpoint opts... - fstype source opts" */
+        char *sep = strstr(line, " - cgroup2 ");
+        if (!sep) continue;
+        char *q = line;
+        for (int i = 0; i < 4 && q; i++) {
+            q = strchr(q, ' ');
+            if (q) q++;
+        }
+        if (!q) continue;
+        char *e = strchr(q, ' ');
+        if (!e || (size_t)(e - q) >= cap) continue;
+        memcpy(out, q, (size_t)(e - q));
+        out[e - q] = 0;
+        found = true;
+    }
+    fclose(f);
+    return found;
+}
+
+static bool cg_delegated(const char *dir, bool is_root) {
+    char p[700];
+    snprintf(p, sizeof(p), "%s/cgroup.procs", dir);
+    if (access(p, W_OK) != 0) return false;
+    if (is_root) return true;
+    struct stat st;
+    if (stat(dir, &st) == 0 && geteuid() != 0 && st.st_uid == geteuid()) return true;
+    char v[8];
+    ssize_t n = getxattr(dir, "trusted.delegate", v, sizeof(v));
+    if (n <= 0) n = getxattr(dir, "user.delegate", v, sizeof(v));
+    return n > 0 && v[0] == '1';
+}
+
+static const char *const cg_ctl[] = { "cpu", "memory", "cpuset" };
+
+/* Groups left behind by a perftui that did not exit cleanly. */
+static void cg_remove_stale(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        int pid;
+        unsigned seq;
+        if (sscanf(de->d_name, "hot-%d-%u", &pid, &seq) != 2) continue;
+        if (pid <= 0 || kill((pid_t)pid, 0) == 0 || errno != ESRCH) continue;
+        CgGroup g;
+        memset(&g, 0, sizeof(g));
+        g.stat_fd = g.peak_fd = g.events_fd = -1;
+        if ((size_t)snprintf(g.path, sizeof(g.path), "%s/%s", dir, de->d_name) >= sizeof(g.path)) continue;
+        cg_remove(&g, true);
+    }
+    closedir(d);
+}
+
+bool cg_root_init(CgRoot *r) {
+    memset(r, 0, sizeof(*r));
+    char mnt[256], line[512], rel[512] = "";
+    if (!cg_mount(mnt, sizeof(mnt))) return false;
+    FILE *f = fopen("/proc/self/cgroup", "re");
+    if (!f) return false;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "0::", 3) != 0) continue;
+        line[strcspn(line, "\n")] = 0;
+        snprintf(rel, sizeof(rel), "%s", line + 3);
+    }
+    fclose(f);
+    if (!rel[0]) return false;
+
+    bool is_root = strcmp(rel, "/") == 0;
+    char dir[512];
+    if ((size_t)snprintf(dir, sizeof(dir), "%s%s", mnt, is_root ? "" : rel) >= sizeof(dir)) return false;
+    if (!cg_delegated(dir, is_root)) return false;
+
+    /* leave the group so controllers can be enabled for the ones below it */
+    if (!is_root) {
+        char leaf[600];
+        snprintf(leaf, sizeof(leaf), "%s/perftui", dir);
+        if (mkdir(leaf, 0755) != 0 && errno != EEXIST) return false;
+        if (!cg_write(leaf, "cgroup.procs", "0")) {
+            rmdir(leaf);
+            return false;
+        }
+        r->moved = true;
+    }
+    char avail[256] = "", on[256] = "";
+    cg_read_file(dir, "cgroup.controllers", avail, sizeof(avail));
+    cg_read_file(dir, "cgroup.subtree_control", on, sizeof(on));
+    for (int i = 0; i < 3; i++) {
+        char w[16];
+        snprintf(w, sizeof(w), "+%s", cg_ctl[i]);
+        if (cg_has_word(avail, cg_ctl[i]) && !cg_has_word(on, cg_ctl[i]) &&
+            cg_write(dir, "cgroup.subtree_control", w))
+            r->added |= 1u << i;
+    }
+    cg_read_file(dir, "cgroup.subtree_control", on, sizeof(on));
+    r->cpu = cg_has_word(on, "cpu");
+    r->memory = cg_has_word(on, "memory");
+    r->cpuset = cg_has_word(on, "cpuset");
+    snprintf(r->base, sizeof(r->base), "%s", dir);
+    cg_remove_stale(dir);
+    return true;
+}
+
+/* Another running perftui has groups in dir. */
+static bool cg_others_live(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) return false;
+    bool live = false;
+    struct dirent *de;
+    while (!live && (de = readdir(d)) != NULL) {
+        int pid;
+        unsigned seq;
+        if (sscanf(de->d_name, "hot-%d-%u", &pid, &seq) != 2 || pid == (int)getpid()) continue;
+        live = pid > 0 && (kill((pid_t)pid, 0) == 0 || errno != ESRCH);
+    }
+    closedir(d);
+    return live;
+}
+
+void cg_root_close(CgRoot *r) {
+    if (!r->base[0]) return;
+    if (!cg_others_live(r->base)) {
+        for (int i = 0; i < 3; i++) {
+            char w[16];
+            snprintf(w, sizeof(w), "-%s", cg_ctl[i]);
+            if (r->added & (1u << i)) cg_write(r->base, "cgroup.subtree_control", w);
+        }
+        /* base takes processes again only with no controllers enabled;
+         * the leaf goes once it is empty (another perftui may be in it) */
+        if (r->moved && cg_write(r->base, "cgroup.procs", "0")) {
+            char leaf[600];
+            snprintf(leaf, sizeof(leaf), "%s/perftui", r->base);
+            rmdir(leaf);
+        }
+    }
+    memset(r, 0, sizeof(*r));
+}
+
+bool cg_create(CgRoot *r, CgGroup *g, const CgLimits *lim) {
+    memset(g, 0, sizeof(*g));
+    g->stat_fd = g->peak_fd = g->events_fd = -1;
+    if (!r->base[0]) return false;
+    snprintf(g->path, sizeof(g->path), "%s/hot-%d-%u", r->base, (int)getpid(), ++r->seq);
+    if (mkdir(g->path, 0755) != 0) { g->path[0] = 0; return false; }
+
+    /* a limit that did not take would let the command run without it:
+     * no group then, the caller falls back as for a missing controller */
+    char v[64];
+    bool ok = true;
+    if (r->cpu && lim->cpu_pct > 0) {
+        snprintf(v, sizeof(v), "%d 100000", lim->cpu_pct * 1000);
+        ok = cg_write(g->path, "cpu.max", v);
+    }
+    if (ok && r->memory && lim->mem_mb > 0) {
+        snprintf(v, sizeof(v), "%llu", (unsigned long long)lim->mem_mb * 1024u * 1024u);
+        ok = cg_write(g->path, "memory.max", v);
+    }
+    if (ok && r->cpuset && lim->cpus[0]) ok = cg_write(g->path, "cpuset.cpus", lim->cpus);
+    if (!ok) {
+        rmdir(g->path);
+        g->path[0] = 0;
+        return false;
+    }
+
+    char path[700];
+    snprintf(path, sizeof(path), "%s/cpu.stat", g->path);
+    g->stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+    snprintf(path, sizeof(path), "%s/cgroup.events", g->path);
+    g->events_fd = open(path, O_RDONLY | O_CLOEXEC);
+    snprintf(path, sizeof(path), "%s/memory.peak", g->path);
+    g->peak_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (g->peak_fd < 0) {
+        /* before Linux 5.19: the current usage is the best there is */
+        snprintf(path, sizeof(path), "%s/memory.current", g->path);
+        g->peak_fd = open(path, O_RDONLY | O_CLOEXEC);
+    }
+    return true;
+}
+
+bool cg_read(CgGroup *g) {
+    if (!g->path[0] || g->stat_fd < 0) return false;
+    char b[512];
+    ssize_t n = pread(g->stat_fd, b, sizeof(b) - 1, 0);
+    if (n <= 0) return false;
+    b[n] = 0;
+    const char *q = strstr(b, "usage_usec ");
+    if (q) g->cpu_usec = strtoull(q + 11, NULL, 10);
+    if (g->peak_fd >= 0) {
+        n = pread(g->peak_fd, b, sizeof(b) - 1, 0);
+        if (n > 0) {
+            b[n] = 0;
+            uint64_t v = strtoull(b, NULL, 10);
+            if (v > g->mem_peak) g->mem_peak = v;
+        }
+    }
+    return true;
+}
+
+int cg_populated(CgGroup *g) {
+    if (!g->path[0] || g->events_fd < 0) return -1;
+    char b[256];
+    ssize_t n = pread(g->events_fd, b, sizeof(b) - 1, 0);
+    if (n <= 0) return -1;
+    b[n] = 0;
+    const char *q = strstr(b, "populated ");
+    return q ? q[10] == '1' : -1;
+}
+
+bool cg_remove(CgGroup *g, bool kill_left) {
+    if (!g->path[0]) return true;
+    if (kill_left && !cg_write(g->path, "cgroup.kill", "1")) {
+        /* before Linux 5.14: one by one */
+        char b[4096];
+        if (cg_read_file(g->path, "cgroup.procs", b, sizeof(b))) {
+            for (char *q = b; *q; ) {
+                char *e;
+                long pid = strtol(q, &e, 10);
+                if (e == q) break;
+                if (pid > 0) kill((pid_t)pid, SIGKILL);
+                q = e;
+                while (*q == '\n') q++;
+            }
+        }
+    }
+    if (rmdir(g->path) != 0) return false;
+    if (g->stat_fd >= 0) close(g->stat_fd);
+    if (g->peak_fd >= 0) close(g->peak_fd);
+    if (g->events_fd >= 0) close(g->events_fd);
+    g->stat_fd = g->peak_fd = g->events_fd = -1;
+    g->path[0] = 0;
+    return true;
+}
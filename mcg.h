@@ -0,0 +1,57 @@
+#ifndef MCG_H
+#define MCG_H
+
+/* cgroup v2 groups for launched commands, no curses: when perftui's own
+ * cgroup is delegated to it, every command gets a transient child group
+ * with cpu.max / memory.max / cpuset.cpus limits, and its cpu.stat and
+ * memory.peak can be read back. mterm.c places hot commands in them. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    int   cpu_pct;       /* cpu.max in percent of one CPU, 0 = no limit */
+    int   mem_mb;        /* memory.max, 0 = no limit */
+    char  cpus[256];     /* cpuset.cpus, "" = no limit */
+} CgLimits;
+
+typedef struct {
+    char      base[512];   /* delegated cgroup the groups are made in, "" = none */
+    bool      cpu, memory, cpuset;   /* controllers enabled for the groups */
+    unsigned  seq;
+    bool      moved;       /* perftui moved itself into base/perftui */
+    unsigned  added;       /* controllers cg_root_init enabled (bit per controller) */
+} CgRoot;
+
+typedef struct {
+    char      path[600];   /* "" = none */
+    int       stat_fd;     /* cpu.stat, kept open and re-read with pread */
+    int       peak_fd;     /* memory.peak (or memory.current), -1 = none */
+    int       events_fd;   /* cgroup.events */
+    uint64_t  cpu_usec;
+    uint64_t  mem_peak;    /* bytes, 0 = unknown */
+} CgGroup;
+
+/* Find perftui's cgroup v2 and check it is delegated (the root group, or
+ * owned by or marked delegated for this user). perftui itself moves into
+ * a leaf "perftui" below it so controllers can be enabled for siblings.
+ * False leaves r->base empty: no groups, callers fall back to rlimits. */
+bool cg_root_init(CgRoot *r);
+/* Undo cg_root_init once the groups are gone: disable the controllers it
+ * enabled, move perftui back and remove the "perftui" leaf. Left alone
+ * while another perftui still has groups there. */
+void cg_root_close(CgRoot *r);
+
+/* New group under r with the limits r's controllers support; false if it
+ * could not be created or one of those limits could not be set. */
+bool cg_create(CgRoot *r, CgGroup *g, const CgLimits *lim);
+/* Update cpu_usec and mem_peak. */
+bool cg_read(CgGroup *g);
+/* 1 if processes are in the group, 0 if not, -1 if unknown. */
+int  cg_populated(CgGroup *g);
+/* Remove the group once its processes are gone; true when removed (or
+ * there was none). kill first kills what is left (cgroup.kill). */
+bool cg_remove(CgGroup *g, bool kill);
+
+#endif
@@ -0,0 +1,298 @@
+#define _GNU_SOURCE
+
+#include "mcpu.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* =========================
+ *  CPU 拓扑与利用率（不依赖 curses）
+ *  - 拓扑只在打开时读一次：present/online 列表，每个 CPU 的
+ *    topology/{physical_package_id,die_id,cluster_id,core_id}，
+ *    NUMA 节点来自 node/nodeN/cpulist
+ *  - /proc/stat 打开一次，之后每次采样 pread(fd, ..., 0) 重读，不再 open/close；
+ *    利用率 = 两次采样间 (total - idle - iowait) / total
+ *  - scaling_cur_freq 同样保持打开（CPU 太多时不读频率，避免占用过多 fd）
+ * ========================= */
+
+#ifndef MCPU_SYS
+#define MCPU_SYS       "/sys/devices/system"
+#endif
+#ifndef MCPU_PROC_STAT
+#define MCPU_PROC_STAT "/proc/stat"
+#endif
+#define CPU_FREQ_FDS_MAX 256
+
+/* Whole small file into buf (NUL-terminated); false if unreadable. */
+static bool cpu_read_file(const char *path, char *buf, size_t cap) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    ssize_t r = read(fd, buf, cap - 1);
+    close(fd);
+    if (r < 0) return false;
+    buf[r] = 0;
+    return true;
+}
+
+static int cpu_read_int(const char *path, int def) {
+    char b[64];
+    if (!cpu_read_file(path, b, sizeof(b))) return def;
+    char *end;
+    long v = strtol(b, &end, 10);
+    return end == b ? def : (int)v;
+}
+
+int cpulist_parse(const char *s, bool *set) {
+    if (!s) return -1;
+    memset(set, 0, CPU_MAX * sizeof(bool));
+    int count = 0;
+    const char *q = s;
+    while (*q == ' ' || *q == '\t') q++;
+    while (*q && *q != '\n') {
+        if (!isdigit((unsigned char)*q)) return -1;
+        char *end;
+        long a = strtol(q, &end, 10), b = a;
+        q = end;
+        if (*q == '-') {
+            q++;
+            if (!isdigit((unsigned char)*q)) return -1;
+            b = strtol(q, &end, 10);
+            q = end;
+        }
+        if (a < 0 || b < a || b >= CPU_MAX) return -1;
+        for (long i = a; i <= b; i++) if (!set[i]) { set[i] = true; count++; }
+        while (*q == ' ') q++;
+        if (*q == ',') {
+            q++;
+            while (*q == ' ') q++;
+            if (!*q) return -1;
+        } else if (*q && *q != '\n') {
+            return -1;
+        }
+    }
+    return count;
+}
+
+size_t cpulist_format(const bool *set, char *out, size_t cap) {
+    size_t len = 0;
+    if (cap) out[0] = 0;
+    for (int i = 0; i < CPU_MAX; ) {
+        if (!set[i]) { i++; continue; }
+        int j = i;
+        while (j + 1 < CPU_MAX && set[j + 1]) j++;
+        char tmp[32];
+        int n = j > i ? snprintf(tmp, sizeof(tmp), "%s%d-%d", len ? "," : "", i, j)
+                      : snprintf(tmp, sizeof(tmp), "%s%d", len ? "," : "", i);
+        if (len + (size_t)n >= cap) break;
+        memcpy(out + len, tmp, (size_t)n + 1);
+        len += (size_t)n;
+        i = j + 1;
+    }
+    return len;
+}
+
+static int cpu_cmp(const void *a, const void *b) {
+    const CpuInfo *x = (const CpuInfo*)a, *y = (const CpuInfo*)b;
+    if (x->pkg != y->pkg) return x->pkg < y->pkg ? -1 : 1;
+    if (x->node != y->node) return x->node < y->node ? -1 : 1;
+    if (x->die != y->die) return x->die < y->die ? -1 : 1;
+    if (x->cluster != y->cluster) return x->cluster < y->cluster ? -1 : 1;
+    if (x->core != y->core) return x->core < y->core ? -1 : 1;
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+/* Node of every CPU from node/nodeN/cpulist. */
+static void cpu_read_nodes(int *node_of) {
+    for (int i = 0; i < CPU_MAX; i++) node_of[i] = -1;
+    DIR *d = opendir(MCPU_SYS "/node");
+    if (!d) return;
+    bool *set = (bool*)malloc(CPU_MAX * sizeof(bool));
+    if (!set) { perror("malloc"); exit(1); }
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (strncmp(de->d_name, "node", 4) || !isdigit((unsigned char)de->d_name[4])) continue;
+        char path[300], b[4096];
+        snprintf(path, sizeof(path), MCPU_SYS "/node/%s/cpulist", de->d_name);
+        if (!cpu_read_file(path, b, sizeof(b)) || cpulist_parse(b, set) < 0) continue;
+        int nd = atoi(de->d_name + 4);
+        for (int i = 0; i < CPU_MAX; i++) if (set[i]) node_of[i] = nd;
+    }
+    closedir(d);
+    free(set);
+}
+
+/* Busy and total jiffies of every "cpuN" line (and "cpu") in /proc/stat. */
+static bool cpu_read_stat(CpuTopo *t) {
+    size_t len = 0;
+    for (;;) {
+        if (t->cap - len < 4096) {
+            size_t nc = t->cap ? t->cap * 2 : 16384;
+            char *nb = (char*)realloc(t->buf, nc);
+            if (!nb) { perror("realloc"); exit(1); }
+            t->buf = nb;
+            t->cap = nc;
+        }
+        ssize_t r = pread(t->stat_fd, t->buf + len, t->cap - len - 1, (off_t)len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return false;
+        if (r == 0) break;
+        len += (size_t)r;
+    }
+    t->buf[len] = 0;
+
+    for (char *l = t->buf; l && l[0] == 'c' && l[1] == 'p' && l[2] == 'u'; ) {
+        char *q = l + 3;
+        int id = -1;
+        if (isdigit((unsigned char)*q)) id = (int)strtol(q, &q, 10);
+        uint64_t v[10] = {0};
+        for (int k = 0; k < 10; k++) {
+            char *end;
+            v[k] = strtoull(q, &end, 10);
+            if (end == q) break;
+            q = end;
+        }
+        /* user nice system idle iowait irq softirq steal (guest is in user) */
+        uint64_t total = v[0] + v[1] + v[2] + v[3] + v[4] + v[5] + v[6] + v[7];
+        uint64_t busy = total - v[3] - v[4];
+        float *util;
+        uint64_t *pb, *pt;
+        if (id < 0) {
+            util = &t->util; pb = &t->busy; pt = &t->total;
+        } else if (id < t->nslot && t->slot[id] >= 0) {
+            CpuInfo *c = &t->cpu[t->slot[id]];
+            util = &c->util; pb = &c->busy; pt = &c->total;
+        } else {
+            util = NULL; pb = pt = NULL;
+        }
+        if (util) {
+            if (*pt && total > *pt && busy >= *pb)
+                *util = (float)(busy - *pb) / (float)(total - *pt);
+            else if (!*pt || total < *pt)
+                *util = -1.0f;   /* first sample, or counters reset (CPU re-onlined) */
+            /* else no time passed on this CPU: keep the last value */
+            *pb = busy;
+            *pt = total;
+        }
+        l = strchr(l, '\n');
+        if (l) l++;
+    }
+    return true;
+}
+
+bool cpu_sample(CpuTopo *t) {
+    if (!t || t->stat_fd < 0) return false;
+    for (int i = 0; i < t->n; i++) {
+        CpuInfo *c = &t->cpu[i];
+        if (c->freq_fd < 0) continue;
+        char b[32];
+        ssize_t r = pread(c->freq_fd, b, sizeof(b) - 1, 0);
+        if (r > 0) { b[r] = 0; c->mhz = (int)(strtol(b, NULL, 10) / 1000); }
+    }
+    /* CPUs missing from /proc/stat (offline) stay unknown */
+    for (int i = 0; i < t->n; i++) if (!t->cpu[i].online) t->cpu[i].util = -1.0f;
+    bool ok = cpu_read_stat(t);
+    if (ok) t->samples++;
+    return ok;
+}
+
+bool cpu_topo_open(CpuTopo *t) {
+    memset(t, 0, sizeof(*t));
+    t->stat_fd = -1;
+
+    char b[4096];
+    bool *present = (bool*)malloc(CPU_MAX * sizeof(bool));
+    bool *online = (bool*)malloc(CPU_MAX * sizeof(bool));
+    int *node_of = (int*)malloc(CPU_MAX * sizeof(int));
+    if (!present || !online || !node_of) { perror("malloc"); exit(1); }
+    int np = -1;
+    if (cpu_read_file(MCPU_SYS "/cpu/present", b, sizeof(b))) np = cpulist_parse(b, present);
+    if (np <= 0) {
+        /* no sysfs: as many CPUs as are online, no topology */
+        long nc = sysconf(_SC_NPROCESSORS_CONF);
+        if (nc < 1) nc = 1;
+        if (nc > CPU_MAX) nc = CPU_MAX;
+        memset(present, 0, CPU_MAX * sizeof(bool));
+        for (long i = 0; i < nc; i++) present[i] = true;
+        np = (int)nc;
+    }
+    if (!cpu_read_file(MCPU_SYS "/cpu/online", b, sizeof(b)) || cpulist_parse(b, online) < 0)
+        memcpy(online, present, CPU_MAX * sizeof(bool));
+    cpu_read_nodes(node_of);
+
+    t->cpu = (CpuInfo*)calloc((size_t)np, sizeof(CpuInfo));
+    if (!t->cpu) { perror("calloc"); exit(1); }
+    for (int id = 0; id < CPU_MAX && t->n < np; id++) {
+        if (!present[id]) continue;
+        CpuInfo *c = &t->cpu[t->n++];
+        char path[128];
+        c->id = id;
+        c->online = online[id];
+        c->node = node_of[id];
+        c->util = -1.0f;
+        c->freq_fd = -1;
+        snprintf(path, sizeof(path), MCPU_SYS "/cpu/cpu%d/topology/physical_package_id", id);
+        c->pkg = cpu_read_int(path, 0);
+        snprintf(path, sizeof(path), MCPU_SYS "/cpu/cpu%d/topology/die_id", id);
+        c->die = cpu_read_int(path, 0);
+        snprintf(path, sizeof(path), MCPU_SYS "/cpu/cpu%d/topology/cluster_id", id);
+        c->cluster = cpu_read_int(path, -1);
+        snprintf(path, sizeof(path), MCPU_SYS "/cpu/cpu%d/topology/core_id", id);
+        c->core = cpu_read_int(path, id);
+        if (np <= CPU_FREQ_FDS_MAX) {
+            snprintf(path, sizeof(path), MCPU_SYS "/cpu/cpu%d/cpufreq/scaling_cur_freq", id);
+            c->freq_fd = open(path, O_RDONLY | O_CLOEXEC);
+        }
+    }
+    free(present);
+    free(online);
+    free(node_of);
+    qsort(t->cpu, (size_t)t->n, sizeof(CpuInfo), cpu_cmp);
+
+    t->nslot = t->n ? t->cpu[0].id + 1 : 0;
+    for (int i = 0; i < t->n; i++) if (t->cpu[i].id + 1 > t->nslot) t->nslot = t->cpu[i].id + 1;
+    t->slot = (int16_t*)malloc((size_t)(t->nslot ? t->nslot : 1) * sizeof(int16_t));
+    if (!t->slot) { perror("malloc"); exit(1); }
+    for (int i = 0; i < t->nslot; i++) t->slot[i] = -1;
+    for (int i = 0; i < t->n; i++) t->slot[t->cpu[i].id] = (int16_t)i;
+
+    /* distinct packages / nodes; threads per core */
+    t->npkg = t->nnode = 0;
+    t->nsmt = 1;
+    bool *seen = (bool*)calloc(CPU_MAX, sizeof(bool));
+    if (!seen) { perror("calloc"); exit(1); }
+    for (int i = 0, run = 0; i < t->n; i++) {
+        const CpuInfo *c = &t->cpu[i], *pc = i ? &t->cpu[i - 1] : NULL;
+        if (!pc || c->pkg != pc->pkg) t->npkg++;
+        if (c->node >= 0 && c->node < CPU_MAX && !seen[c->node]) { seen[c->node] = true; t->nnode++; }
+        bool same_core = pc && c->pkg == pc->pkg && c->die == pc->die && c->core == pc->core &&
+                         c->cluster == pc->cluster && c->node == pc->node;
+        run = same_core ? run + 1 : 1;
+        if (run > t->nsmt) t->nsmt = run;
+    }
+    free(seen);
+
+    t->stat_fd = open(MCPU_PROC_STAT, O_RDONLY | O_CLOEXEC);
+    if (t->n == 0 || t->stat_fd < 0) {
+        cpu_topo_close(t);
+        return false;
+    }
+    cpu_sample(t);
+    return true;
+}
+
+void cpu_topo_close(CpuTopo *t) {
+    if (!t) return;
+    for (int i = 0; i < t->n; i++) if (t->cpu[i].freq_fd >= 0) close(t->cpu[i].freq_fd);
+    if (t->stat_fd >= 0) close(t->stat_fd);
+    free(t->cpu);
+    free(t->slot);
+    free(t->buf);
+    memset(t, 0, sizeof(*t));
+    t->stat_fd = -1;
+}
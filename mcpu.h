@@ -0,0 +1,53 @@
+#ifndef MCPU_H
+#define MCPU_H
+
+/* CPU topology and utilization, no curses: packages, dies, clusters, cores
+ * (SMT siblings) and NUMA nodes from sysfs, per-CPU busy % sampled from
+ * /proc/stat. mterm.c draws the CPU picker from it (HOT_CPU). */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CPU_MAX 4096   /* highest CPU number + 1 that is handled */
+
+typedef struct {
+    int      id;        /* logical CPU number */
+    int      pkg, die, cluster, core;
+    int      node;      /* NUMA node, -1 = none */
+    bool     online;
+    float    util;      /* busy fraction over the last interval, -1 = unknown */
+    int      mhz;       /* current frequency, 0 = unknown */
+    int      freq_fd;   /* cpufreq/scaling_cur_freq, -1 = none */
+    uint64_t busy, total;   /* /proc/stat counters at the last sample */
+} CpuInfo;
+
+typedef struct {
+    CpuInfo *cpu;       /* sorted by package, node, die, cluster, core, id */
+    int      n;
+    int16_t *slot;      /* CPU number -> index in cpu, -1 = not present */
+    int      nslot;
+    int      npkg, nnode, nsmt;   /* distinct packages / nodes, threads per core (max) */
+
+    int      stat_fd;   /* /proc/stat, kept open and re-read with pread */
+    char    *buf;
+    size_t   cap;
+    float    util;      /* all CPUs */
+    uint64_t busy, total;
+    uint64_t samples;
+} CpuTopo;
+
+/* Read the topology of the present CPUs and take the first sample;
+ * false if nothing could be read. */
+bool cpu_topo_open(CpuTopo *t);
+void cpu_topo_close(CpuTopo *t);
+/* Update util (and mhz) from the counters since the last call. */
+bool cpu_sample(CpuTopo *t);
+
+/* "0-3,8,10-11" -> set[cpu] = true (set holds CPU_MAX entries); returns the
+ * number of CPUs, -1 if s is not a cpulist. */
+int    cpulist_parse(const char *s, bool *set);
+/* The inverse; the shortest form with ranges. Returns the length. */
+size_t cpulist_format(const bool *set, char *out, size_t cap);
+
+#endif
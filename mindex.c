@@ -0,0 +1,703 @@
+#define _GNU_SOURCE
+
+#include "mindex.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+/* =========================
+ *  持久文件索引（不依赖 curses）
+ *  - 根目录下所有普通文件（与 find <root> -type f 相同，不跟随符号链接）
+ *    连同 mode、mtime、是否可执行/ELF 保存在内存表里，路径连续存放
+ *  - 打开时先读磁盘上的上一份索引（立即可用），同时后台多线程重新扫描：
+ *    目录放进共享栈，各线程取目录 readdir，子目录再压栈
+ *  - 扫描时给每个目录加 inotify 监视，之后的增删改就地更新，不再全量扫描
+ *  - 扫描结果按路径排序后整体替换内存表，并写回磁盘（先写临时文件再 rename）
+ * ========================= */
+
+#define IDX_MAGIC       "PTIDX\0\0\1"
+#define IDX_WATCH_MASK  (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | \
+                         IN_CLOSE_WRITE | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+#define IDX_COMPACT_MIN 4096   /* dead entries before the table is compacted */
+
+typedef struct {
+    char     magic[8];
+    uint32_t count;
+    uint32_t root_len;
+    uint64_t names_len;
+    /* then root, count IdxEntry, names */
+} IdxFileHdr;
+
+static uint64_t idx_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t idx_hash_str(const char *s) {
+    uint64_t h = 1469598103934665603ull;
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 1099511628211ull;
+    return h;
+}
+
+/* dir + "/" + name into buf; 0 if it does not fit. */
+static size_t idx_join(char *buf, size_t cap, const char *dir, const char *name) {
+    size_t dl = strlen(dir);
+    bool sep = dl > 0 && dir[dl - 1] != '/';
+    int n = snprintf(buf, cap, "%s%s%s", dir, sep ? "/" : "", name);
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+/* =========================
+ *  Table
+ *  条目追加在末尾；删除只打 IDX_DEAD 标记，死条目过多时整体压缩。
+ *  路径 -> 条目用开放寻址哈希（只在主线程的 live 表上维护）。
+ * ========================= */
+static void idx_table_free(IdxTable *t) {
+    free(t->names);
+    free(t->ent);
+    free(t->hash);
+    for (int i = 0; i < t->wd_cap; i++) free(t->wd_dir[i]);
+    free(t->wd_dir);
+    memset(t, 0, sizeof(*t));
+}
+
+static void idx_reserve(IdxTable *t, uint32_t n, size_t names) {
+    if (n > t->cap) {
+        IdxEntry *e = (IdxEntry*)realloc(t->ent, (size_t)n * sizeof(IdxEntry));
+        if (!e) { perror("realloc"); exit(1); }
+        t->ent = e;
+        t->cap = n;
+    }
+    if (names > t->names_cap) {
+        char *s = (char*)realloc(t->names, names);
+        if (!s) { perror("realloc"); exit(1); }
+        t->names = s;
+        t->names_cap = names;
+    }
+}
+
+static uint32_t idx_append(IdxTable *t, const char *path, size_t len, int64_t mtime,
+                           uint32_t mode, uint32_t flags) {
+    if (t->n == t->cap || t->names_len + len + 1 > t->names_cap) {
+        size_t nc = t->names_cap ? t->names_cap : 64 * 1024;
+        while (t->names_len + len + 1 > nc) nc *= 2;
+        idx_reserve(t, t->n == t->cap ? (t->cap ? t->cap * 2 : 1024) : t->cap, nc);
+    }
+    IdxEntry *e = &t->ent[t->n];
+    e->off = t->names_len;
+    e->mtime = mtime;
+    e->mode = mode;
+    e->flags = flags;
+    memcpy(t->names + t->names_len, path, len);
+    t->names[t->names_len + len] = 0;
+    t->names_len += len + 1;
+    return t->n++;
+}
+
+static void idx_hash_put(IdxTable *t, uint32_t i) {
+    uint32_t m = t->hash_cap - 1;
+    uint32_t h = (uint32_t)idx_hash_str(idx_path(t, i)) & m;
+    while (t->hash[h]) h = (h + 1) & m;
+    t->hash[h] = i + 1;
+}
+
+static void idx_hash_rebuild(IdxTable *t) {
+    uint32_t cap = 1024;
+    while (cap < 2u * (t->n + 1)) cap *= 2;
+    free(t->hash);
+    t->hash = (uint32_t*)calloc(cap, sizeof(uint32_t));
+    if (!t->hash) { perror("calloc"); exit(1); }
+    t->hash_cap = cap;
+    for (uint32_t i = 0; i < t->n; i++) idx_hash_put(t, i);
+}
+
+static int64_t idx_find(const IdxTable *t, const char *path) {
+    if (!t->hash_cap) return -1;
+    uint32_t m = t->hash_cap - 1;
+    for (uint32_t h = (uint32_t)idx_hash_str(path) & m; t->hash[h]; h = (h + 1) & m)
+        if (strcmp(idx_path(t, t->hash[h] - 1), path) == 0) return t->hash[h] - 1;
+    return -1;
+}
+
+/* Insert or refresh path; true if the table changed. */
+static bool idx_upsert(IdxTable *t, const char *path, int64_t mtime, uint32_t mode, uint32_t flags) {
+    int64_t i = idx_find(t, path);
+    if (i >= 0) {
+        IdxEntry *e = &t->ent[i];
+        if (!(e->flags & IDX_DEAD) && e->mtime == mtime && e->mode == mode && e->flags == flags)
+            return false;
+        if (e->flags & IDX_DEAD) t->ndead--;
+        e->mtime = mtime;
+        e->mode = mode;
+        e->flags = flags;
+        return true;
+    }
+    uint32_t j = idx_append(t, path, strlen(path), mtime, mode, flags);
+    if (2u * (t->n + 1) > t->hash_cap) idx_hash_rebuild(t);
+    else idx_hash_put(t, j);
+    return true;
+}
+
+static bool idx_remove(IdxTable *t, const char *path) {
+    int64_t i = idx_find(t, path);
+    if (i < 0 || (t->ent[i].flags & IDX_DEAD)) return false;
+    t->ent[i].flags |= IDX_DEAD;
+    t->ndead++;
+    return true;
+}
+
+/* Drop dead entries (keeps order). */
+static void idx_compact(IdxTable *t) {
+    IdxTable c;
+    memset(&c, 0, sizeof(c));
+    idx_reserve(&c, t->n - t->ndead + 1, t->names_len + 1);
+    for (uint32_t i = 0; i < t->n; i++) {
+        const IdxEntry *e = &t->ent[i];
+        if (e->flags & IDX_DEAD) continue;
+        const char *p = idx_path(t, i);
+        idx_append(&c, p, strlen(p), e->mtime, e->mode, e->flags);
+    }
+    free(t->names);
+    free(t->ent);
+    t->names = c.names;
+    t->names_len = c.names_len;
+    t->names_cap = c.names_cap;
+    t->ent = c.ent;
+    t->n = c.n;
+    t->cap = c.cap;
+    t->ndead = 0;
+    idx_hash_rebuild(t);
+}
+
+static void idx_set_wd(IdxTable *t, int wd, char *dir) {
+    if (wd >= t->wd_cap) {
+        int nc = t->wd_cap ? t->wd_cap : 256;
+        while (nc <= wd) nc *= 2;
+        char **w = (char**)realloc(t->wd_dir, (size_t)nc * sizeof(char*));
+        if (!w) { perror("realloc"); exit(1); }
+        memset(w + t->wd_cap, 0, (size_t)(nc - t->wd_cap) * sizeof(char*));
+        t->wd_dir = w;
+        t->wd_cap = nc;
+    }
+    free(t->wd_dir[wd]);
+    t->wd_dir[wd] = dir;
+}
+
+/* =========================
+ *  Directory scan
+ * ========================= */
+typedef void (*IdxPushFn)(void *ctx, const char *dir);
+
+/* IDX_EXEC / IDX_ELF of a regular file; only executables are opened. */
+static uint32_t idx_file_flags(int dfd, const char *name, const struct stat *st) {
+    if (!(st->st_mode & 0111)) return 0;
+    uint32_t f = IDX_EXEC;
+    int fd = openat(dfd, name, O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK | O_NOATIME);
+    if (fd < 0 && errno == EPERM) fd = openat(dfd, name, O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+    if (fd >= 0) {
+        unsigned char m[4];
+        if (read(fd, m, sizeof(m)) == 4 && memcmp(m, "\x7f" "ELF", 4) == 0) f |= IDX_ELF;
+        close(fd);
+    }
+    return f;
+}
+
+/* Read one directory: regular files are appended to out, subdirectories
+ * go to push, and the directory gets an inotify watch (out->wd_dir). The
+ * watch is added before reading, so nothing created meanwhile is missed. */
+static void idx_scan_dir(IdxTable *out, int ino_fd, const char *dir, IdxPushFn push, void *ctx) {
+    int dfd = open(dir, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dfd < 0) return;
+    if (ino_fd >= 0 && !out->watch_full) {
+        int wd = inotify_add_watch(ino_fd, dir, IDX_WATCH_MASK);
+        if (wd >= 0) {
+            char *d = strdup(dir);
+            if (!d) { perror("strdup"); exit(1); }
+            idx_set_wd(out, wd, d);
+        } else if (errno == ENOSPC) {
+            out->watch_full = true;
+        }
+    }
+    DIR *d = fdopendir(dfd);
+    if (!d) { close(dfd); return; }
+    char path[PATH_MAX];
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        const char *nm = de->d_name;
+        if (nm[0] == '.' && (!nm[1] || (nm[1] == '.' && !nm[2]))) continue;
+        size_t len = idx_join(path, sizeof(path), dir, nm);
+        if (!len) continue;
+        if (de->d_type == DT_DIR) { push(ctx, path); continue; }
+        if (de->d_type != DT_REG && de->d_type != DT_UNKNOWN) continue;
+        struct stat st;
+        if (fstatat(dirfd(d), nm, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+        if (S_ISDIR(st.st_mode)) { push(ctx, path); continue; }
+        if (!S_ISREG(st.st_mode)) continue;
+        idx_append(out, path, len, (int64_t)st.st_mtim.tv_sec, (uint32_t)st.st_mode,
+                   idx_file_flags(dirfd(d), nm, &st));
+    }
+    closedir(d);
+}
+
+/* =========================
+ *  Index file
+ * ========================= */
+static void idx_save(const char *file, const char *root, const IdxTable *t) {
+    if (!file[0]) return;
+    char tmp[sizeof(((FileIndex*)0)->file) + 32];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", file, (int)getpid());
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return;
+
+    IdxFileHdr h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, IDX_MAGIC, sizeof(h.magic));
+    h.count = t->n - t->ndead;
+    h.root_len = (uint32_t)strlen(root);
+    for (uint32_t i = 0; i < t->n; i++)
+        if (!(t->ent[i].flags & IDX_DEAD)) h.names_len += strlen(idx_path(t, i)) + 1;
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(root, 1, h.root_len, f) == h.root_len;
+    size_t off = 0;
+    for (uint32_t i = 0; ok && i < t->n; i++) {
+        if (t->ent[i].flags & IDX_DEAD) continue;
+        IdxEntry e = t->ent[i];
+        e.off = off;
+        off += strlen(idx_path(t, i)) + 1;
+        ok = fwrite(&e, sizeof(e), 1, f) == 1;
+    }
+    for (uint32_t i = 0; ok && i < t->n; i++) {
+        if (t->ent[i].flags & IDX_DEAD) continue;
+        const char *p = idx_path(t, i);
+        size_t n = strlen(p) + 1;
+        ok = fwrite(p, 1, n, f) == n;
+    }
+    if (fclose(f) != 0) ok = false;
+    if (!ok || rename(tmp, file) != 0) unlink(tmp);
+}
+
+static bool idx_load(FileIndex *ix) {
+    if (!ix->file[0]) return false;
+    int fd = open(ix->file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    char *buf = NULL;
+    bool ok = fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(IdxFileHdr);
+    if (ok) {
+        buf = (char*)malloc((size_t)st.st_size);
+        if (!buf) { perror("malloc"); exit(1); }
+        size_t got = 0;
+        while (got < (size_t)st.st_size) {
+            ssize_t r = read(fd, buf + got, (size_t)st.st_size - got);
+            if (r <= 0) break;
+            got += (size_t)r;
+        }
+        ok = got == (size_t)st.st_size;
+    }
+    close(fd);
+
+    IdxFileHdr h;
+    if (ok) {
+        memcpy(&h, buf, sizeof(h));
+        size_t root_len = strlen(ix->root);
+        ok = memcmp(h.magic, IDX_MAGIC, sizeof(h.magic)) == 0 && h.root_len == root_len &&
+             (uint64_t)st.st_size == sizeof(h) + h.root_len + (uint64_t)h.count * sizeof(IdxEntry) + h.names_len &&
+             memcmp(buf + sizeof(h), ix->root, root_len) == 0;
+    }
+    if (ok) {
+        const char *ents = buf + sizeof(h) + h.root_len;
+        const char *names = ents + (size_t)h.count * sizeof(IdxEntry);
+        ok = h.names_len == 0 ? h.count == 0 : names[h.names_len - 1] == 0;
+        IdxTable *t = &ix->live;
+        idx_reserve(t, h.count + 1, (size_t)h.names_len + 1);
+        memcpy(t->ent, ents, (size_t)h.count * sizeof(IdxEntry));
+        memcpy(t->names, names, (size_t)h.names_len);
+        t->n = h.count;
+        t->names_len = (size_t)h.names_len;
+        for (uint32_t i = 0; ok && i < t->n; i++) {
+            ok = t->ent[i].off < t->names_len;
+            t->ent[i].flags &= IDX_EXEC | IDX_ELF;
+        }
+        if (ok) idx_hash_rebuild(t);
+        else idx_table_free(t);
+    }
+    free(buf);
+    return ok;
+}
+
+/* =========================
+ *  Background scan
+ *  各线程从共享栈取目录读，结果写自己的表（不加锁）；
+ *  最后一个退出的线程负责合并、排序、写盘，再通过 eventfd 唤醒主循环。
+ *  线程屏蔽全部信号（SIGWINCH/SIGCHLD 仍由主线程处理）。
+ * ========================= */
+struct IdxBuild {
+    pthread_mutex_t mu;
+    pthread_cond_t  cv;
+    pthread_t      *tid;
+    int             n;        /* workers started */
+    int             exited;
+    bool            done;     /* merged (or stopped): out may be taken */
+    char          **stack;    /* directories still to read (owned) */
+    size_t          sn, scap;
+    int             busy;     /* workers reading a directory */
+    bool            stop;
+
+    const char     *root, *file;   /* FileIndex strings (constant) */
+    int             ino_fd, wake_fd;
+    IdxTable       *part;     /* one per worker */
+    IdxTable        out;      /* merged, sorted result */
+    uint64_t        t0_ns, ns;
+};
+
+typedef struct {
+    IdxBuild *b;
+    int       id;
+} IdxWorkerArg;
+
+typedef struct {
+    const char     *path;
+    const IdxEntry *e;
+} IdxSortItem;
+
+static int idx_sort_cmp(const void *a, const void *b) {
+    return strcmp(((const IdxSortItem*)a)->path, ((const IdxSortItem*)b)->path);
+}
+
+static void idx_build_push(void *ctx, const char *dir) {
+    IdxBuild *b = (IdxBuild*)ctx;
+    char *d = strdup(dir);
+    if (!d) { perror("strdup"); exit(1); }
+    pthread_mutex_lock(&b->mu);
+    if (b->sn == b->scap) {
+        size_t nc = b->scap ? b->scap * 2 : 256;
+        char **s = (char**)realloc(b->stack, nc * sizeof(char*));
+        if (!s) { perror("realloc"); exit(1); }
+        b->stack = s;
+        b->scap = nc;
+    }
+    b->stack[b->sn++] = d;
+    pthread_cond_signal(&b->cv);
+    pthread_mutex_unlock(&b->mu);
+}
+
+static void idx_build_merge(IdxBuild *b) {
+    uint32_t n = 0;
+    size_t names = 0;
+    for (int i = 0; i < b->n; i++) { n += b->part[i].n; names += b->part[i].names_len; }
+    IdxSortItem *items = (IdxSortItem*)malloc(((size_t)n + 1) * sizeof(IdxSortItem));
+    if (!items) { perror("malloc"); exit(1); }
+    uint32_t k = 0;
+    for (int i = 0; i < b->n; i++)
+        for (uint32_t j = 0; j < b->part[i].n; j++)
+            items[k++] = (IdxSortItem){ idx_path(&b->part[i], j), &b->part[i].ent[j] };
+    qsort(items, n, sizeof(IdxSortItem), idx_sort_cmp);
+
+    IdxTable *t = &b->out;
+    idx_reserve(t, n + 1, names + 1);
+    for (uint32_t i = 0; i < n; i++)
+        idx_append(t, items[i].path, strlen(items[i].path), items[i].e->mtime, items[i].e->mode, items[i].e->flags);
+    free(items);
+    idx_hash_rebuild(t);
+    for (int i = 0; i < b->n; i++) {
+        IdxTable *p = &b->part[i];
+        for (int wd = 0; wd < p->wd_cap; wd++)
+            if (p->wd_dir[wd]) { idx_set_wd(t, wd, p->wd_dir[wd]); p->wd_dir[wd] = NULL; }
+        if (p->watch_full) t->watch_full = true;
+        idx_table_free(p);
+    }
+    b->ns = idx_now_ns() - b->t0_ns;
+    idx_save(b->file, b->root, t);
+}
+
+static void *idx_worker(void *arg) {
+    IdxWorkerArg a = *(IdxWorkerArg*)arg;
+    free(arg);
+    IdxBuild *b = a.b;
+    for (;;) {
+        pthread_mutex_lock(&b->mu);
+        while (!b->stop && b->sn == 0 && b->busy > 0) pthread_cond_wait(&b->cv, &b->mu);
+        if (b->stop || b->sn == 0) { pthread_mutex_unlock(&b->mu); break; }
+        char *dir = b->stack[--b->sn];
+        b->busy++;
+        pthread_mutex_unlock(&b->mu);
+
+        idx_scan_dir(&b->part[a.id], b->ino_fd, dir, idx_build_push, b);
+        free(dir);
+
+        pthread_mutex_lock(&b->mu);
+        if (--b->busy == 0 && b->sn == 0) pthread_cond_broadcast(&b->cv);
+        pthread_mutex_unlock(&b->mu);
+    }
+    pthread_mutex_lock(&b->mu);
+    bool last = ++b->exited == b->n;
+    bool stop = b->stop;
+    pthread_mutex_unlock(&b->mu);
+    if (last) {
+        if (!stop) idx_build_merge(b);
+        pthread_mutex_lock(&b->mu);
+        b->done = true;
+        pthread_mutex_unlock(&b->mu);
+        uint64_t one = 1;
+        (void)!write(b->wake_fd, &one, sizeof(one));
+    }
+    return NULL;
+}
+
+static void idx_build_free(IdxBuild *b) {
+    for (int i = 0; i < b->n; i++) pthread_join(b->tid[i], NULL);
+    for (size_t i = 0; i < b->sn; i++) free(b->stack[i]);
+    free(b->stack);
+    for (int i = 0; i < b->n; i++) idx_table_free(&b->part[i]);
+    free(b->part);
+    idx_table_free(&b->out);
+    free(b->tid);
+    pthread_mutex_destroy(&b->mu);
+    pthread_cond_destroy(&b->cv);
+    free(b);
+}
+
+void idx_rescan(FileIndex *ix) {
+    if (!ix || ix->build) return;
+    if (ix->ino_fd < 0) ix->ino_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    IdxBuild *b = (IdxBuild*)calloc(1, sizeof(IdxBuild));
+    if (!b) { perror("calloc"); exit(1); }
+    pthread_mutex_init(&b->mu, NULL);
+    pthread_cond_init(&b->cv, NULL);
+    b->root = ix->root;
+    b->file = ix->file;
+    b->ino_fd = ix->ino_fd;
+    b->wake_fd = ix->wake_fd;
+    b->t0_ns = idx_now_ns();
+    b->tid = (pthread_t*)calloc((size_t)ix->threads, sizeof(pthread_t));
+    b->part = (IdxTable*)calloc((size_t)ix->threads, sizeof(IdxTable));
+    if (!b->tid || !b->part) { perror("calloc"); exit(1); }
+    idx_build_push(b, ix->root);
+
+    /* workers wait for mu until n is final */
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    pthread_mutex_lock(&b->mu);
+    for (int i = 0; i < ix->threads; i++) {
+        IdxWorkerArg *a = (IdxWorkerArg*)malloc(sizeof(*a));
+        if (!a) { perror("malloc"); exit(1); }
+        a->b = b;
+        a->id = i;
+        if (pthread_create(&b->tid[b->n], NULL, idx_worker, a) != 0) { free(a); break; }
+        b->n++;
+    }
+    pthread_mutex_unlock(&b->mu);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (b->n == 0) {
+        /* no threads: scan here; idx_pump takes the result over */
+        IdxWorkerArg *a = (IdxWorkerArg*)malloc(sizeof(*a));
+        if (!a) { perror("malloc"); exit(1); }
+        a->b = b;
+        a->id = 0;
+        b->n = 1;
+        idx_worker(a);
+        b->n = 0;   /* nothing to join */
+    }
+    ix->build = b;
+}
+
+/* =========================
+ *  inotify
+ * ========================= */
+/* Entries and watches at or below dir are gone (deleted or moved away). */
+static bool idx_drop_tree(FileIndex *ix, const char *dir) {
+    IdxTable *t = &ix->live;
+    size_t dl = strlen(dir);
+    bool changed = false;
+    for (uint32_t i = 0; i < t->n; i++) {
+        const char *p = idx_path(t, i);
+        if (!(t->ent[i].flags & IDX_DEAD) && strncmp(p, dir, dl) == 0 && p[dl] == '/') {
+            t->ent[i].flags |= IDX_DEAD;
+            t->ndead++;
+            changed = true;
+        }
+    }
+    for (int wd = 0; wd < t->wd_cap; wd++) {
+        const char *p = t->wd_dir[wd];
+        if (p && strncmp(p, dir, dl) == 0 && (p[dl] == '/' || !p[dl])) {
+            inotify_rm_watch(ix->ino_fd, wd);
+            free(t->wd_dir[wd]);
+            t->wd_dir[wd] = NULL;
+        }
+    }
+    return changed;
+}
+
+static void idx_local_push(void *ctx, const char *dir) {
+    IdxTable *dirs = (IdxTable*)ctx;
+    idx_append(dirs, dir, strlen(dir), 0, 0, 0);
+}
+
+/* A directory appeared (created or moved in): scan it here. */
+static bool idx_add_tree(FileIndex *ix, const char *dir) {
+    IdxTable found, dirs;   /* dirs: directories still to read, used as a stack */
+    memset(&found, 0, sizeof(found));
+    memset(&dirs, 0, sizeof(dirs));
+    found.watch_full = ix->live.watch_full;
+    idx_local_push(&dirs, dir);
+    while (dirs.n > 0) {
+        char d[PATH_MAX];
+        snprintf(d, sizeof(d), "%s", idx_path(&dirs, --dirs.n));
+        dirs.names_len = dirs.ent[dirs.n].off;
+        idx_scan_dir(&found, ix->ino_fd, d, idx_local_push, &dirs);
+    }
+    bool changed = false;
+    for (uint32_t i = 0; i < found.n; i++)
+        if (idx_upsert(&ix->live, idx_path(&found, i), found.ent[i].mtime, found.ent[i].mode, found.ent[i].flags))
+            changed = true;
+    for (int wd = 0; wd < found.wd_cap; wd++)
+        if (found.wd_dir[wd]) { idx_set_wd(&ix->live, wd, found.wd_dir[wd]); found.wd_dir[wd] = NULL; }
+    if (found.watch_full) ix->live.watch_full = true;
+    idx_table_free(&found);
+    idx_table_free(&dirs);
+    return changed;
+}
+
+static bool idx_event(FileIndex *ix, const struct inotify_event *ev) {
+    IdxTable *t = &ix->live;
+    if (ev->mask & IN_Q_OVERFLOW) { ix->rescan_wanted = true; return false; }
+    if (ev->wd < 0 || ev->wd >= t->wd_cap || !t->wd_dir[ev->wd]) return false;
+    if (ev->mask & IN_IGNORED) {
+        free(t->wd_dir[ev->wd]);
+        t->wd_dir[ev->wd] = NULL;
+        return false;
+    }
+    if (!ev->len || !ev->name[0]) return false;
+    char path[PATH_MAX];
+    if (!idx_join(path, sizeof(path), t->wd_dir[ev->wd], ev->name)) return false;
+
+    if (ev->mask & IN_ISDIR) {
+        bool changed = false;
+        if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) changed |= idx_drop_tree(ix, path);
+        if (ev->mask & (IN_CREATE | IN_MOVED_TO)) changed |= idx_add_tree(ix, path);
+        return changed;
+    }
+    if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) return idx_remove(t, path);
+    struct stat st;
+    if (fstatat(AT_FDCWD, path, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISREG(st.st_mode))
+        return idx_upsert(t, path, (int64_t)st.st_mtim.tv_sec, (uint32_t)st.st_mode,
+                          idx_file_flags(AT_FDCWD, path, &st));
+    return idx_remove(t, path);
+}
+
+static bool idx_read_events(FileIndex *ix) {
+    char buf[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    for (;;) {
+        ssize_t r = read(ix->ino_fd, buf, sizeof(buf));
+        if (r <= 0) break;
+        for (char *q = buf; q < buf + r; ) {
+            const struct inotify_event *ev = (const struct inotify_event*)q;
+            if (idx_event(ix, ev)) changed = true;
+            q += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    return changed;
+}
+
+/* =========================
+ *  Public
+ * ========================= */
+FileIndex *idx_open(const char *root, const char *cache_dir, int threads) {
+    FileIndex *ix = (FileIndex*)calloc(1, sizeof(FileIndex));
+    if (!ix) { perror("calloc"); exit(1); }
+    snprintf(ix->root, sizeof(ix->root), "%s", root);
+    size_t rl = strlen(ix->root);
+    while (rl > 1 && ix->root[rl - 1] == '/') ix->root[--rl] = 0;
+    ix->threads = threads < 1 ? 1 : threads;
+    ix->ino_fd = -1;
+    ix->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (cache_dir && cache_dir[0]) {
+        /* mkdir -p */
+        char d[sizeof(ix->file) - 32];   /* room for the file name */
+        snprintf(d, sizeof(d), "%s", cache_dir);
+        for (char *s = d + 1; *s; s++)
+            if (*s == '/') { *s = 0; mkdir(d, 0700); *s = '/'; }
+        mkdir(d, 0700);
+        snprintf(ix->file, sizeof(ix->file), "%s/index-%016llx.bin", d,
+                 (unsigned long long)idx_hash_str(ix->root));
+    }
+    ix->loaded = idx_load(ix);
+    idx_rescan(ix);
+    return ix;
+}
+
+bool idx_pump(FileIndex *ix) {
+    if (!ix) return false;
+    bool changed = false;
+    IdxBuild *b = ix->build;
+    if (b) {
+        uint64_t v;
+        (void)!read(ix->wake_fd, &v, sizeof(v));
+        pthread_mutex_lock(&b->mu);
+        bool done = b->done;
+        pthread_mutex_unlock(&b->mu);
+        /* events wait until the new table (and its watches) is in */
+        if (!done) return false;
+        idx_table_free(&ix->live);
+        ix->live = b->out;
+        memset(&b->out, 0, sizeof(b->out));
+        ix->scan_ns = b->ns;
+        idx_build_free(b);
+        ix->build = NULL;
+        ix->loaded = true;
+        ix->dirty = false;
+        ix->scans++;
+        changed = true;
+    }
+    if (ix->ino_fd >= 0 && idx_read_events(ix)) {
+        changed = true;
+        ix->dirty = true;
+    }
+    IdxTable *t = &ix->live;
+    if (t->ndead > IDX_COMPACT_MIN && 2 * t->ndead > t->n) idx_compact(t);
+    if (ix->rescan_wanted) {
+        ix->rescan_wanted = false;
+        idx_rescan(ix);
+    }
+    if (changed) ix->gen++;
+    return changed;
+}
+
+int idx_fds(const FileIndex *ix, int *fds) {
+    if (!ix) return 0;
+    if (ix->build) { fds[0] = ix->wake_fd; return ix->wake_fd >= 0; }
+    if (ix->ino_fd >= 0) { fds[0] = ix->ino_fd; return 1; }
+    return 0;
+}
+
+void idx_close(FileIndex *ix) {
+    if (!ix) return;
+    if (ix->build) {
+        pthread_mutex_lock(&ix->build->mu);
+        ix->build->stop = true;
+        pthread_cond_broadcast(&ix->build->cv);
+        pthread_mutex_unlock(&ix->build->mu);
+        idx_build_free(ix->build);
+    }
+    if (ix->dirty && ix->loaded) idx_save(ix->file, ix->root, &ix->live);
+    idx_table_free(&ix->live);
+    if (ix->ino_fd >= 0) close(ix->ino_fd);
+    if (ix->wake_fd >= 0) close(ix->wake_fd);
+    free(ix);
+}
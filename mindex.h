@@ -0,0 +1,82 @@
+#ifndef MINDEX_H
+#define MINDEX_H
+
+/* Persistent file index, no curses: the regular files under a root with
+ * mode, mtime and type, saved to disk, rebuilt by parallel directory
+ * scanning threads and kept current with inotify. mterm.c serves
+ * "find <root> -type f | fzy" pickers from it (HOT_PICK). */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define IDX_EXEC  1u   /* an execute bit is set */
+#define IDX_ELF   2u   /* executable that starts with \x7fELF */
+#define IDX_DEAD  4u   /* removed (slot kept until compaction) */
+
+typedef enum { IDX_ALL = 0, IDX_ONLY_EXEC = 1, IDX_ONLY_ELF = 2 } IdxFilter;
+
+typedef struct {
+    size_t   off;     /* path in names, NUL-terminated */
+    int64_t  mtime;   /* seconds */
+    uint32_t mode;
+    uint32_t flags;
+} IdxEntry;
+
+typedef struct {
+    char     *names;
+    size_t    names_len, names_cap;
+    IdxEntry *ent;
+    uint32_t  n, cap, ndead;
+    uint32_t *hash;          /* entry + 1, 0 = empty; open addressing */
+    uint32_t  hash_cap;
+    char    **wd_dir;        /* inotify watch descriptor -> directory */
+    int       wd_cap;
+    bool      watch_full;    /* ran out of inotify watches */
+} IdxTable;
+
+typedef struct IdxBuild IdxBuild;
+
+typedef struct {
+    char      root[256];
+    char      file[512];     /* on-disk copy ("" = not saved) */
+    IdxTable  live;
+    bool      loaded;        /* live holds data (from the file or a scan) */
+    uint64_t  gen;           /* bumped whenever live changes */
+    uint64_t  scans;         /* completed scans */
+    uint64_t  scan_ns;       /* duration of the last scan */
+    bool      dirty;         /* live differs from the file */
+    bool      rescan_wanted; /* inotify queue overflowed */
+
+    int       ino_fd;        /* -1 = none */
+    int       wake_fd;       /* eventfd, signalled when a scan finishes */
+    IdxBuild *build;         /* running scan, NULL = none */
+    int       threads;
+} FileIndex;
+
+/* Load root's index from cache_dir (if any) and start a scan in the
+ * background. cache_dir NULL or "" keeps the index in memory only. */
+FileIndex *idx_open(const char *root, const char *cache_dir, int threads);
+/* Stop a running scan, save if changed, free. */
+void idx_close(FileIndex *ix);
+/* Scan root again in the background (no-op while one is running). */
+void idx_rescan(FileIndex *ix);
+/* Take over a finished scan and apply inotify events; true if live changed. */
+bool idx_pump(FileIndex *ix);
+/* Descriptors that make idx_pump() worth calling: the scan's wake pipe
+ * while one runs, else the inotify fd. fds holds IDX_FDS_MAX entries;
+ * returns how many were filled. */
+#define IDX_FDS_MAX 1
+int  idx_fds(const FileIndex *ix, int *fds);
+
+static inline const char *idx_path(const IdxTable *t, uint32_t i) {
+    return t->names + t->ent[i].off;
+}
+static inline bool idx_pass(const IdxEntry *e, IdxFilter f) {
+    if (e->flags & IDX_DEAD) return false;
+    if (f == IDX_ONLY_EXEC) return (e->flags & IDX_EXEC) != 0;
+    if (f == IDX_ONLY_ELF) return (e->flags & IDX_ELF) != 0;
+    return true;
+}
+
+#endif
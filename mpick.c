@@ -0,0 +1,773 @@
+#define _GNU_SOURCE
+
+#include "mpick.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* =========================
+ *  内置模糊选择器核心（不依赖 curses）
+ *  - 候选行连续存放在一个字符串 arena 里，读入时就地切行，不逐行 malloc
+ *  - 匹配/打分与 fzy 一致（子序列匹配 + 动态规划打分，同分按输入顺序）
+ *  - 过滤分成若干段交给线程池并行，各段结果按段序拼接，保持输入顺序
+ *  - 查询只是在上一次后面追加字符时，只在上一次的匹配结果里再过滤
+ *  - 只对最好的若干条排序（界面显示需要多少取多少），不全量排序
+ *  - 得分上界够不上当前前 K 条的候选不做动态规划，只记上界，
+ *    翻页需要更多条时再补算
+ *  - 一次调用最多做 slice_ns（默认 8ms）的过滤，剩下的由下一次 pick_update
+ *    接着做；期间输入了新查询，旧查询没做完的部分直接作废
+ * ========================= */
+
+static uint64_t pick_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* =========================
+ *  fzy scoring
+ *  与 fzy 1.x 的 match.c 相同的常数与递推：
+ *  - D[i][j]：query 第 i 个字符恰好匹配在候选第 j 个字节时的最好得分
+ *  - M[i][j]：query 前 i+1 个字符匹配在候选前 j+1 个字节内的最好得分
+ *  - 词首（/ - _ 空格 . 之后、驼峰大写）有奖励，间隔有惩罚，连续匹配奖励最高
+ * ========================= */
+#define PICK_SCORE_MIN          (-INFINITY)
+#define PICK_SCORE_MAX          INFINITY
+#define PICK_GAP_LEADING        (-0.005)
+#define PICK_GAP_TRAILING       (-0.005)
+#define PICK_GAP_INNER          (-0.01)
+#define PICK_MATCH_CONSECUTIVE  1.0
+#define PICK_MATCH_SLASH        0.9
+#define PICK_MATCH_WORD         0.8
+#define PICK_MATCH_CAPITAL      0.7
+#define PICK_MATCH_DOT          0.6
+
+static unsigned char pick_lower[256];
+static uint8_t       pick_bonus_index[256];    /* 0 other, 1 upper, 2 lower/digit */
+static PickScore     pick_bonus_states[3][256]; /* [index of ch][previous byte] */
+static pthread_once_t pick_tables_once = PTHREAD_ONCE_INIT;
+
+static void pick_tables_build(void) {
+    for (int c = 0; c < 256; c++) {
+        pick_lower[c] = (unsigned char)((c >= 'A' && c <= 'Z') ? c + 32 : c);
+        if (c >= 'A' && c <= 'Z') pick_bonus_index[c] = 1;
+        else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) pick_bonus_index[c] = 2;
+    }
+    for (int s = 1; s <= 2; s++) {
+        pick_bonus_states[s]['/'] = PICK_MATCH_SLASH;
+        pick_bonus_states[s]['-'] = PICK_MATCH_WORD;
+        pick_bonus_states[s]['_'] = PICK_MATCH_WORD;
+        pick_bonus_states[s][' '] = PICK_MATCH_WORD;
+        pick_bonus_states[s]['.'] = PICK_MATCH_DOT;
+    }
+    for (int c = 'a'; c <= 'z'; c++) pick_bonus_states[1][c] = PICK_MATCH_CAPITAL;
+}
+
+/* Case-insensitive subsequence test; lq is the lowercased query. first[i]
+ * receives the leftmost position query character i can take. */
+static inline bool pick_has_match(const unsigned char *lq, int qlen, const unsigned char *s, int m, int *first) {
+    int j = 0;
+    for (int i = 0; i < qlen; i++) {
+        unsigned char c = lq[i];
+        while (j < m && pick_lower[s[j]] != c) j++;
+        if (j == m) return false;
+        first[i] = j++;
+    }
+    return true;
+}
+
+typedef struct {
+    const unsigned char *lq;
+    int n, m;
+    int first[PICK_QUERY_MAX];  /* leftmost / rightmost feasible position of */
+    int last[PICK_QUERY_MAX];   /* each query character */
+    unsigned char ls[PICK_MATCH_MAX_LEN];
+    PickScore     bonus[PICK_MATCH_MAX_LEN];
+} PickMatch;
+
+/* first[] comes from pick_has_match. Only columns [first[0], last[n-1]]
+ * can take part in a match, so only those are prepared. */
+static void pick_match_setup(PickMatch *pm, const unsigned char *lq, int n, const unsigned char *s, int m) {
+    pm->lq = lq;
+    pm->n = n;
+    pm->m = m;
+    for (int i = n - 1, j = m - 1; i >= 0; i--, j--) {
+        while (pick_lower[s[j]] != lq[i]) j--;
+        pm->last[i] = j;
+    }
+    int j0 = pm->first[0];
+    unsigned char last = j0 ? s[j0 - 1] : '/';
+    for (int j = j0; j <= pm->last[n - 1]; j++) {
+        unsigned char ch = s[j];
+        pm->ls[j] = pick_lower[ch];
+        pm->bonus[j] = pick_bonus_states[pick_bonus_index[ch]][last];
+        last = ch;
+    }
+}
+
+static inline PickScore pick_max(PickScore a, PickScore b) { return a > b ? a : b; }
+
+/* Row i of fzy's recurrence over columns [first[i], end]. Left of first[i]
+ * every score is SCORE_MIN, so starting there with prev = SCORE_MIN gives
+ * the same values; the next row reads only columns this one wrote. */
+static void pick_match_row(const PickMatch *pm, int i, int end, PickScore *cur_D, PickScore *cur_M,
+                           const PickScore *last_D, const PickScore *last_M) {
+    PickScore prev = PICK_SCORE_MIN;
+    PickScore gap = (i == pm->n - 1) ? PICK_GAP_TRAILING : PICK_GAP_INNER;
+    unsigned char qc = pm->lq[i];
+    for (int j = pm->first[i]; j <= end; j++) {
+        if (qc == pm->ls[j]) {
+            PickScore score = PICK_SCORE_MIN;
+            if (!i) score = (j * PICK_GAP_LEADING) + pm->bonus[j];
+            else if (j) /* consecutive match, does not stack with the bonus */
+                score = pick_max(last_M[j - 1] + pm->bonus[j], last_D[j - 1] + PICK_MATCH_CONSECUTIVE);
+            cur_D[j] = score;
+            cur_M[j] = prev = pick_max(score, prev + gap);
+        } else {
+            cur_D[j] = PICK_SCORE_MIN;
+            cur_M[j] = prev = prev + gap;
+        }
+    }
+}
+
+/* Last column row i must fill: the next row reads up to its own last - 1. */
+static inline int pick_row_end(const PickMatch *pm, int i) {
+    return i + 1 < pm->n ? pm->last[i + 1] - 1 : pm->last[i];
+}
+
+/* One query character: the single row in one pass over the bytes, with
+ * the same arithmetic as the general case. */
+static PickScore pick_score1(const PickMatch *pm, unsigned char qc, const unsigned char *s, int m) {
+    PickScore prev = PICK_SCORE_MIN;
+    int j = pm->first[0];
+    unsigned char last = j ? s[j - 1] : '/';
+    for (; j < m; j++) {
+        unsigned char ch = s[j];
+        if (pick_lower[ch] == qc) {
+            PickScore score = (j * PICK_GAP_LEADING) + pick_bonus_states[pick_bonus_index[ch]][last];
+            prev = pick_max(score, prev + PICK_GAP_TRAILING);
+        } else {
+            prev = prev + PICK_GAP_TRAILING;
+        }
+        last = ch;
+    }
+    return prev;
+}
+
+/* Score of a candidate that matches; pm->first is filled in. */
+static PickScore pick_score(PickMatch *pm, const unsigned char *lq, int n, const unsigned char *s, int m) {
+    if (m > PICK_MATCH_MAX_LEN || n > m) return PICK_SCORE_MIN;
+    if (n == m) return PICK_SCORE_MAX;
+    if (n == 1) return pick_score1(pm, lq[0], s, m);
+    pick_match_setup(pm, lq, n, s, m);
+    PickScore D[2][PICK_MATCH_MAX_LEN], M[2][PICK_MATCH_MAX_LEN];
+    PickScore *last_D = D[0], *last_M = M[0], *cur_D = D[1], *cur_M = M[1];
+    for (int i = 0; i < n; i++) {
+        pick_match_row(pm, i, pick_row_end(pm, i), cur_D, cur_M, last_D, last_M);
+        PickScore *t = cur_D; cur_D = last_D; last_D = t;
+        t = cur_M; cur_M = last_M; last_M = t;
+    }
+    /* no match right of last[n-1]: trailing gaps up to the end */
+    PickScore score = last_M[pm->last[n - 1]];
+    for (int j = pm->last[n - 1] + 1; j < m; j++) score += PICK_GAP_TRAILING;
+    return score;
+}
+
+/* No alignment scores more than this: the first character gets at most
+ * the slash bonus, each further one at most the consecutive bonus, and
+ * every byte left unmatched costs at least a trailing gap. For n < m <=
+ * PICK_MATCH_MAX_LEN; the margin covers rounding in the DP's sums. */
+static inline PickScore pick_bound(int n, int m) {
+    return PICK_MATCH_SLASH + (n - 1) * PICK_MATCH_CONSECUTIVE + (m - n) * PICK_GAP_TRAILING + 1e-9;
+}
+
+/* Tighter, for n >= 2:
+ * - the bytes between the first and the last matched character cost an
+ *   inner gap each (twice a trailing one), and there are at least
+ *   first[n-1] - last[0] - (n-1) of them;
+ * - a character that cannot directly follow its predecessor anywhere in
+ *   its window [first[i], last[i]] gets at most the slash bonus. */
+static PickScore pick_bound_span(const unsigned char *lq, int n, const unsigned char *s, int m, const int *first) {
+    int last[PICK_QUERY_MAX];
+    for (int i = n - 1, j = m - 1; i >= 0; i--, j--) {
+        while (pick_lower[s[j]] != lq[i]) j--;
+        last[i] = j;
+    }
+    int inner = first[n - 1] - last[0] - (n - 1);
+    PickScore b = pick_bound(n, m) + (inner > 0 ? inner : 0) * (PICK_GAP_INNER - PICK_GAP_TRAILING);
+    for (int i = 1; i < n; i++) {
+        int j = first[i];
+        while (j <= last[i] && !(pick_lower[s[j]] == lq[i] && pick_lower[s[j - 1]] == lq[i - 1])) j++;
+        if (j > last[i]) b -= PICK_MATCH_CONSECUTIVE - PICK_MATCH_SLASH;
+    }
+    return b;
+}
+
+bool pick_positions(const char *q, const char *str, int *pos) {
+    pthread_once(&pick_tables_once, pick_tables_build);
+    unsigned char lq[PICK_QUERY_MAX];
+    int n = 0;
+    for (; q[n] && n < PICK_QUERY_MAX; n++) lq[n] = pick_lower[(unsigned char)q[n]];
+    const unsigned char *s = (const unsigned char*)str;
+    int m = (int)strlen(str);
+    PickMatch pm;
+    if (n == 0 || !pick_has_match(lq, n, s, m, pm.first)) return false;
+    if (m > PICK_MATCH_MAX_LEN || n == m) {
+        /* no alignment is scored: show the leftmost one */
+        memcpy(pos, pm.first, (size_t)n * sizeof(int));
+        return true;
+    }
+
+    pick_match_setup(&pm, lq, n, s, m);
+    PickScore *D = (PickScore*)malloc(sizeof(PickScore) * (size_t)n * (size_t)m);
+    PickScore *M = (PickScore*)malloc(sizeof(PickScore) * (size_t)n * (size_t)m);
+    if (!D || !M) { perror("malloc"); exit(1); }
+    for (int i = 0; i < n; i++)
+        pick_match_row(&pm, i, pick_row_end(&pm, i), D + (size_t)i * m, M + (size_t)i * m,
+                       i ? D + (size_t)(i - 1) * m : D, i ? M + (size_t)(i - 1) * m : M);
+
+    /* Backtrack from the end; of several optimal paths take the first one
+     * met, the latest in the candidate. A match scored as consecutive
+     * forces the previous query character onto the previous byte. Only
+     * columns inside row i's window were computed. */
+    bool required = false;
+    for (int i = n - 1, j = pm.last[n - 1]; i >= 0; i--) {
+        if (j > pm.last[i]) j = pm.last[i];
+        for (; j >= pm.first[i]; j--) {
+            PickScore d = D[(size_t)i * m + j];
+            if (d != PICK_SCORE_MIN && (required || d == M[(size_t)i * m + j])) {
+                required = i && j && M[(size_t)i * m + j] == D[(size_t)(i - 1) * m + j - 1] + PICK_MATCH_CONSECUTIVE;
+                pos[i] = j--;
+                break;
+            }
+        }
+    }
+    free(D);
+    free(M);
+    return true;
+}
+
+/* =========================
+ *  Worker pool
+ *  过滤时调用线程自己跑第 0 段，其余各段由常驻线程并行：
+ *  - 一次 pick_pool_run 就是一轮（gen 加一），全部做完才返回
+ *  - 线程屏蔽全部信号，SIGWINCH/SIGCHLD 仍由主线程（curses）处理
+ * ========================= */
+#define PICK_PAR_MIN  16384    /* fewer items than this: filter on the caller only */
+#define PICK_CHUNK    16384    /* items in the first filter round of a slice */
+#define PICK_SLICE_NS 8000000u /* default slice_ns */
+
+typedef void (*PickFn)(void *ctx, int part, int nparts);
+
+struct PickPool {
+    int             n;         /* worker threads; parts = n + 1 */
+    pthread_t      *tid;
+    pthread_mutex_t mu;
+    pthread_cond_t  go, done;
+    unsigned        gen;
+    int             busy;
+    bool            quit;
+    PickFn          fn;
+    void           *ctx;
+};
+
+typedef struct {
+    PickPool *pool;
+    int       part;
+} PickWorkerArg;
+
+static void *pick_worker(void *arg) {
+    PickWorkerArg a = *(PickWorkerArg*)arg;
+    free(arg);
+    PickPool *pp = a.pool;
+    /* rounds are counted from 0 (pool creation): a worker that starts late
+     * still takes part in the first one */
+    unsigned seen = 0;
+    pthread_mutex_lock(&pp->mu);
+    for (;;) {
+        while (!pp->quit && pp->gen == seen) pthread_cond_wait(&pp->go, &pp->mu);
+        if (pp->quit) break;
+        seen = pp->gen;
+        PickFn fn = pp->fn;
+        void *ctx = pp->ctx;
+        pthread_mutex_unlock(&pp->mu);
+        fn(ctx, a.part, pp->n + 1);
+        pthread_mutex_lock(&pp->mu);
+        if (--pp->busy == 0) pthread_cond_signal(&pp->done);
+    }
+    pthread_mutex_unlock(&pp->mu);
+    return NULL;
+}
+
+static PickPool *pick_pool_new(int workers) {
+    PickPool *pp = (PickPool*)calloc(1, sizeof(PickPool));
+    if (!pp) { perror("calloc"); exit(1); }
+    pp->tid = (pthread_t*)calloc((size_t)workers, sizeof(pthread_t));
+    if (!pp->tid) { perror("calloc"); exit(1); }
+    pthread_mutex_init(&pp->mu, NULL);
+    pthread_cond_init(&pp->go, NULL);
+    pthread_cond_init(&pp->done, NULL);
+
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (int i = 0; i < workers; i++) {
+        PickWorkerArg *a = (PickWorkerArg*)malloc(sizeof(*a));
+        if (!a) { perror("malloc"); exit(1); }
+        a->pool = pp;
+        a->part = i + 1;
+        if (pthread_create(&pp->tid[pp->n], NULL, pick_worker, a) != 0) { free(a); break; }
+        pp->n++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return pp;
+}
+
+static void pick_pool_free(PickPool *pp) {
+    if (!pp) return;
+    pthread_mutex_lock(&pp->mu);
+    pp->quit = true;
+    pthread_cond_broadcast(&pp->go);
+    pthread_mutex_unlock(&pp->mu);
+    for (int i = 0; i < pp->n; i++) pthread_join(pp->tid[i], NULL);
+    pthread_mutex_destroy(&pp->mu);
+    pthread_cond_destroy(&pp->go);
+    pthread_cond_destroy(&pp->done);
+    free(pp->tid);
+    free(pp);
+}
+
+static void pick_pool_run(PickPool *pp, PickFn fn, void *ctx) {
+    pthread_mutex_lock(&pp->mu);
+    pp->fn = fn;
+    pp->ctx = ctx;
+    pp->busy = pp->n;
+    pp->gen++;
+    pthread_cond_broadcast(&pp->go);
+    pthread_mutex_unlock(&pp->mu);
+
+    fn(ctx, 0, pp->n + 1);
+
+    pthread_mutex_lock(&pp->mu);
+    while (pp->busy > 0) pthread_cond_wait(&pp->done, &pp->mu);
+    pthread_mutex_unlock(&pp->mu);
+}
+
+/* =========================
+ *  Candidate arena
+ * ========================= */
+void pick_init(PickSet *ps, int threads) {
+    memset(ps, 0, sizeof(*ps));
+    pthread_once(&pick_tables_once, pick_tables_build);
+    ps->threads = threads < 1 ? 1 : threads;
+    ps->slice_ns = PICK_SLICE_NS;
+    ps->off_cap = 1024;
+    ps->off = (size_t*)malloc(ps->off_cap * sizeof(size_t));
+    if (!ps->off) { perror("malloc"); exit(1); }
+    ps->off[0] = 0;
+}
+
+void pick_free(PickSet *ps) {
+    pick_pool_free(ps->pool);
+    if (ps->parts) for (int i = 0; i < ps->threads; i++) {
+        free(ps->parts[i].hits);
+        free(ps->parts[i].top);
+    }
+    free(ps->parts);
+    free(ps->arena);
+    free(ps->off);
+    free(ps->hits);
+    free(ps->top);
+    for (int i = 0; i < ps->nhist; i++) free(ps->hist[i].hits);
+    free(ps->hist);
+    memset(ps, 0, sizeof(*ps));
+}
+
+char *pick_space(PickSet *ps, size_t want, size_t *room) {
+    if (ps->arena_cap - ps->arena_len < want) {
+        size_t nc = ps->arena_cap ? ps->arena_cap : (1u << 20);
+        while (nc - ps->arena_len < want) nc *= 2;
+        char *nb = (char*)realloc(ps->arena, nc);
+        if (!nb) { perror("realloc"); exit(1); }
+        ps->arena = nb;
+        ps->arena_cap = nc;
+    }
+    *room = ps->arena_cap - ps->arena_len;
+    return ps->arena + ps->arena_len;
+}
+
+static void pick_push_line(PickSet *ps, size_t end) {
+    /* the line is [off[n], end); end holds its terminating NUL */
+    if (end == ps->off[ps->n]) { ps->off[ps->n] = end + 1; return; } /* empty */
+    if (ps->n + 2 > ps->off_cap) {
+        ps->off_cap *= 2;
+        size_t *no = (size_t*)realloc(ps->off, ps->off_cap * sizeof(size_t));
+        if (!no) { perror("realloc"); exit(1); }
+        ps->off = no;
+    }
+    ps->n++;
+    ps->off[ps->n] = end + 1;
+}
+
+void pick_commit(PickSet *ps, size_t n) {
+    char *p = ps->arena + ps->arena_len;
+    char *end = p + n;
+    ps->arena_len += n;
+    if (ps->n >= UINT32_MAX - 1) return;
+    while (p < end) {
+        char *nl = (char*)memchr(p, '\n', (size_t)(end - p));
+        if (!nl) break;
+        *nl = 0;
+        if (nl > ps->arena + ps->off[ps->n] && nl[-1] == '\r') nl[-1] = 0;
+        pick_push_line(ps, (size_t)(nl - ps->arena));
+        p = nl + 1;
+    }
+}
+
+void pick_finish(PickSet *ps) {
+    if (ps->arena_len == ps->off[ps->n]) return;
+    size_t room;
+    pick_space(ps, 1, &room);
+    ps->arena[ps->arena_len] = 0;
+    pick_push_line(ps, ps->arena_len++);
+}
+
+/* =========================
+ *  Filtering
+ * ========================= */
+/* Ranking: higher score first, then input order (as fzy). */
+static inline bool pick_better(const PickHit *a, const PickHit *b) {
+    return a->score > b->score || (a->score == b->score && a->idx < b->idx);
+}
+
+static int pick_cmp(const void *x, const void *y) {
+    const PickHit *a = (const PickHit*)x, *b = (const PickHit*)y;
+    if (pick_better(a, b)) return -1;
+    if (pick_better(b, a)) return 1;
+    return 0;
+}
+
+/* Bounded heap with the worst kept hit at the root. */
+static void pick_heap_push(PickHit *h, uint32_t *n, uint32_t cap, PickHit x) {
+    uint32_t i;
+    if (*n < cap) {
+        i = (*n)++;
+        while (i > 0) {
+            uint32_t up = (i - 1) / 2;
+            if (!pick_better(&h[up], &x)) break;
+            h[i] = h[up];
+            i = up;
+        }
+        h[i] = x;
+        return;
+    }
+    if (!pick_better(&x, &h[0])) return;
+    i = 0;
+    for (;;) {
+        uint32_t c = 2 * i + 1;
+        if (c >= *n) break;
+        if (c + 1 < *n && pick_better(&h[c], &h[c + 1])) c++;
+        if (!pick_better(&x, &h[c])) break;
+        h[i] = h[c];
+        i = c;
+    }
+    h[i] = x;
+}
+
+typedef struct {
+    PickSet       *ps;
+    const PickHit *src;      /* NULL: candidates [lo, hi) */
+    uint32_t       lo, hi;   /* range of src indices or candidates */
+    uint32_t       want;     /* hits that can still reach the top `want` are scored */
+    unsigned char  lq[PICK_QUERY_MAX];
+    int            qlen;
+} PickJob;
+
+static void pick_part_push(PickPart *pt, PickHit h) {
+    if (pt->n == pt->cap) {
+        pt->cap = pt->cap ? pt->cap * 2 : 4096;
+        PickHit *nh = (PickHit*)realloc(pt->hits, pt->cap * sizeof(PickHit));
+        if (!nh) { perror("realloc"); exit(1); }
+        pt->hits = nh;
+    }
+    pt->hits[pt->n++] = h;
+}
+
+static void pick_filter_part(void *ctx, int part, int nparts) {
+    PickJob *j = (PickJob*)ctx;
+    const PickSet *ps = j->ps;
+    PickPart *out = &j->ps->parts[part];
+    PickMatch pm;
+    out->n = 0;
+    if (j->want > out->top_cap) {
+        PickHit *nt = (PickHit*)realloc(out->top, (size_t)j->want * sizeof(PickHit));
+        if (!nt) { perror("realloc"); exit(1); }
+        out->top = nt;
+        out->top_cap = j->want;
+    }
+    uint32_t ntop = 0;
+    uint32_t total = j->hi - j->lo;
+    uint32_t per = (uint32_t)(((uint64_t)total + (uint64_t)nparts - 1) / (uint64_t)nparts);
+    uint64_t a = (uint64_t)j->lo + (uint64_t)per * (uint64_t)part;
+    uint64_t b = a + per;
+    if (b > j->hi) b = j->hi;
+    for (uint64_t k = a; k < b; k++) {
+        uint32_t idx = j->src ? j->src[k].idx : (uint32_t)k;
+        const unsigned char *s = (const unsigned char*)ps->arena + ps->off[idx];
+        int m = (int)(ps->off[idx + 1] - ps->off[idx] - 1);
+        if (!pick_has_match(j->lq, j->qlen, s, m, pm.first)) continue;
+        /* this part alone already has `want` better hits: keep the bound */
+        PickHit h = { idx, 1, 0 };
+        if (ntop == j->want && j->qlen < m && m <= PICK_MATCH_MAX_LEN) {
+            h.score = pick_bound(j->qlen, m);
+            if (pick_better(&h, &out->top[0]) && j->qlen > 1)
+                h.score = pick_bound_span(j->lq, j->qlen, s, m, pm.first);
+            if (!pick_better(&h, &out->top[0])) { pick_part_push(out, h); continue; }
+        }
+        h.bound = 0;
+        h.score = pick_score(&pm, j->lq, j->qlen, s, m);
+        if (j->want) pick_heap_push(out->top, &ntop, j->want, h);
+        pick_part_push(out, h);
+    }
+}
+
+/* Match the job's range and append the results to ps->hits in order. */
+static void pick_filter(PickSet *ps, PickJob *j) {
+    int nparts = 1;
+    if (ps->threads > 1 && j->hi - j->lo >= PICK_PAR_MIN) {
+        if (!ps->pool) ps->pool = pick_pool_new(ps->threads - 1);
+        nparts = ps->pool->n + 1;
+    }
+    if (!ps->parts) {
+        ps->parts = (PickPart*)calloc((size_t)ps->threads, sizeof(PickPart));
+        if (!ps->parts) { perror("calloc"); exit(1); }
+    }
+    if (nparts > 1) pick_pool_run(ps->pool, pick_filter_part, j);
+    else pick_filter_part(j, 0, 1);
+
+    uint64_t total = ps->nhits;
+    for (int i = 0; i < nparts; i++) total += ps->parts[i].n;
+    if (total > ps->hits_cap) {
+        uint32_t nc = ps->hits_cap ? ps->hits_cap : 4096;
+        while (nc < total) nc *= 2;
+        PickHit *nh = (PickHit*)realloc(ps->hits, (size_t)nc * sizeof(PickHit));
+        if (!nh) { perror("realloc"); exit(1); }
+        ps->hits = nh;
+        ps->hits_cap = nc;
+    }
+    for (int i = 0; i < nparts; i++) {
+        if (!ps->parts[i].n) continue;   /* hits may still be NULL */
+        memcpy(ps->hits + ps->nhits, ps->parts[i].hits, ps->parts[i].n * sizeof(PickHit));
+        ps->nhits += ps->parts[i].n;
+    }
+}
+
+static void pick_top_reserve(PickSet *ps, uint32_t want) {
+    if (want <= ps->top_cap) return;
+    PickHit *nt = (PickHit*)realloc(ps->top, (size_t)want * sizeof(PickHit));
+    if (!nt) { perror("realloc"); exit(1); }
+    ps->top = nt;
+    ps->top_cap = want;
+}
+
+/* Replace the bound of a hit of the current query by its score. */
+static void pick_rescore(const PickSet *ps, PickHit *h) {
+    unsigned char lq[PICK_QUERY_MAX];
+    for (int i = 0; i < ps->qlen; i++) lq[i] = pick_lower[(unsigned char)ps->query[i]];
+    const unsigned char *s = (const unsigned char*)ps->arena + ps->off[h->idx];
+    int m = (int)(ps->off[h->idx + 1] - ps->off[h->idx] - 1);
+    PickMatch pm;
+    pick_has_match(lq, ps->qlen, s, m, pm.first);
+    h->score = pick_score(&pm, lq, ps->qlen, s, m);
+    h->bound = 0;
+}
+
+/* Fold hits into the current top (which stays sorted). Hits holding only
+ * a bound are scored when the bound could still get them in. */
+static void pick_top_merge(PickSet *ps, PickHit *in, uint32_t n, uint32_t want) {
+    if (want < 1) want = 1;
+    pick_top_reserve(ps, want);
+    uint32_t keep = ps->ntop < want ? ps->ntop : want;
+    uint32_t hn = 0;
+    /* re-heapify the kept top, then offer the new hits */
+    for (uint32_t i = 0; i < keep; i++) pick_heap_push(ps->top, &hn, want, ps->top[i]);
+    for (uint32_t i = 0; i < n; i++) {
+        if (in[i].bound) {
+            if (hn == want && !pick_better(&in[i], &ps->top[0])) continue;
+            pick_rescore(ps, &in[i]);
+        }
+        pick_heap_push(ps->top, &hn, want, in[i]);
+    }
+    qsort(ps->top, hn, sizeof(PickHit), pick_cmp);
+    ps->ntop = hn;
+}
+
+void pick_top(PickSet *ps, uint32_t want) {
+    if (want <= ps->ntop || ps->ntop >= pick_matches(ps)) return;
+    if (!ps->qlen) {
+        /* everything matches, in input order */
+        pick_top_reserve(ps, want);
+        uint32_t n = want < ps->scanned ? want : ps->scanned;
+        for (uint32_t i = ps->ntop; i < n; i++) ps->top[i] = (PickHit){ i, 0, 0 };
+        ps->ntop = n;
+        return;
+    }
+    ps->ntop = 0;
+    pick_top_merge(ps, ps->hits, ps->nhits, want);
+}
+
+static void pick_job_init(const PickSet *ps, PickJob *j) {
+    memset(j, 0, offsetof(PickJob, lq));
+    j->ps = (PickSet*)ps;
+    j->qlen = ps->qlen;
+    for (int i = 0; i < ps->qlen; i++) j->lq[i] = pick_lower[(unsigned char)ps->query[i]];
+}
+
+/* Match in rounds until nothing is pending or the slice is used up: first
+ * the rest of the earlier query's hits, then candidates from scanned on.
+ * The first round is PICK_CHUNK items, each next one what this round's
+ * rate fits into the rest of the slice. The new hits are folded into the
+ * top. */
+static void pick_run(PickSet *ps, uint32_t want, uint64_t t0) {
+    PickJob j;
+    pick_job_init(ps, &j);
+    j.want = want > ps->ntop ? want : ps->ntop;
+    if (j.want < 1) j.want = 1;
+    /* an empty top (new query) takes all hits, else only the new ones */
+    uint32_t before = ps->ntop ? ps->nhits : 0;
+    uint32_t chunk = ps->slice_ns ? PICK_CHUNK : UINT32_MAX;
+    while (pick_pending(ps)) {
+        uint64_t r0 = pick_now_ns();
+        if (ps->narrow < ps->narrow_end) {
+            j.src = ps->hist[ps->nhist - 1].hits;
+            j.lo = ps->narrow;
+            j.hi = ps->narrow_end - j.lo > chunk ? j.lo + chunk : ps->narrow_end;
+            pick_filter(ps, &j);
+            ps->narrow = j.hi;
+        } else {
+            j.src = NULL;
+            j.lo = ps->scanned;
+            j.hi = ps->n - j.lo > chunk ? j.lo + chunk : ps->n;
+            pick_filter(ps, &j);
+            ps->scanned = j.hi;
+        }
+        if (!ps->slice_ns) continue;
+        uint64_t now = pick_now_ns();
+        if (now - t0 >= ps->slice_ns) break;
+        uint64_t next = (uint64_t)(j.hi - j.lo) * (ps->slice_ns - (now - t0)) / (now - r0 + 1);
+        chunk = next < PICK_CHUNK ? PICK_CHUNK : next > UINT32_MAX ? UINT32_MAX : (uint32_t)next;
+    }
+    pick_top_merge(ps, ps->hits + before, ps->nhits - before, j.want);
+    ps->filter_ns = pick_now_ns() - t0;
+}
+
+void pick_update(PickSet *ps, uint32_t want) {
+    if (!pick_pending(ps)) return;
+    uint64_t t0 = pick_now_ns();
+    if (!ps->qlen) {
+        ps->scanned = ps->n;
+        pick_top(ps, want);
+        return;
+    }
+    pick_run(ps, want, t0);
+}
+
+/* Matches of the shorter queries typed before the current one (each a
+ * prefix of the next) are kept, so Backspace restores them instead of
+ * searching again. Their total size is bounded; the shortest go first. */
+#define PICK_HIST_FACTOR  4     /* kept hits <= 4 x candidates */
+
+static bool pick_is_prefix(const PickLevel *l, const char *q, int qlen) {
+    return l->qlen <= qlen && memcmp(l->query, q, (size_t)l->qlen) == 0;
+}
+
+static void pick_hist_push(PickSet *ps) {
+    if (ps->nhist == ps->hist_cap) {
+        ps->hist_cap = ps->hist_cap ? ps->hist_cap * 2 : 16;
+        PickLevel *nh = (PickLevel*)realloc(ps->hist, (size_t)ps->hist_cap * sizeof(PickLevel));
+        if (!nh) { perror("realloc"); exit(1); }
+        ps->hist = nh;
+    }
+    PickLevel *l = &ps->hist[ps->nhist++];
+    memcpy(l->query, ps->query, (size_t)ps->qlen);
+    l->qlen = ps->qlen;
+    l->hits = ps->hits;
+    l->nhits = ps->nhits;
+    l->cap = ps->hits_cap;
+    l->scanned = ps->scanned;
+    ps->hits = NULL;
+    ps->nhits = ps->hits_cap = 0;
+
+    uint64_t kept = 0;
+    for (int i = 0; i < ps->nhist; i++) kept += ps->hist[i].nhits;
+    while (ps->nhist > 1 && kept > (uint64_t)ps->n * PICK_HIST_FACTOR) {
+        kept -= ps->hist[0].nhits;
+        free(ps->hist[0].hits);
+        memmove(ps->hist, ps->hist + 1, (size_t)--ps->nhist * sizeof(PickLevel));
+    }
+}
+
+void pick_query(PickSet *ps, const char *q, uint32_t want) {
+    int qlen = (int)strnlen(q, PICK_QUERY_MAX - 1);
+    if (qlen == ps->qlen && memcmp(q, ps->query, (size_t)qlen) == 0) {
+        pick_update(ps, want);
+        pick_top(ps, want);
+        return;
+    }
+    uint64_t t0 = pick_now_ns();
+    bool extend = ps->qlen > 0 && qlen > ps->qlen && memcmp(q, ps->query, (size_t)ps->qlen) == 0;
+    bool restored = false;
+    if (extend && ps->narrow < ps->narrow_end) {
+        /* the current query was not finished: its matches are incomplete,
+         * search the same earlier query's matches again instead */
+        ps->nhits = 0;
+    } else if (extend) {
+        pick_hist_push(ps);
+    } else {
+        ps->nhits = 0;
+        while (ps->nhist > 0 && !pick_is_prefix(&ps->hist[ps->nhist - 1], q, qlen))
+            free(ps->hist[--ps->nhist].hits);
+        if (ps->nhist > 0 && ps->hist[ps->nhist - 1].qlen == qlen) {
+            /* Backspace onto an earlier query: take its matches back */
+            PickLevel *l = &ps->hist[--ps->nhist];
+            free(ps->hits);
+            ps->hits = l->hits;
+            ps->nhits = l->nhits;
+            ps->hits_cap = l->cap;
+            ps->scanned = l->scanned;
+            restored = true;
+        }
+    }
+
+    memcpy(ps->query, q, (size_t)qlen);
+    ps->query[qlen] = 0;
+    ps->qlen = qlen;
+    ps->ntop = 0;
+    ps->narrow = ps->narrow_end = 0;
+    if (!qlen) {
+        ps->scanned = ps->n;
+        pick_top(ps, want);
+        ps->filter_ns = pick_now_ns() - t0;
+        return;
+    }
+
+    if (restored) {
+        /* go on from where that query had got to */
+    } else if (ps->nhist > 0) {
+        /* every match of the longer query is a match of a shorter one:
+         * search the closest earlier query's matches, then whatever
+         * arrived after that query was run */
+        const PickLevel *l = &ps->hist[ps->nhist - 1];
+        ps->narrow_end = l->nhits;
+        ps->scanned = l->scanned;
+    } else {
+        ps->scanned = 0;
+    }
+    pick_run(ps, want, t0);
+}
@@ -0,0 +1,113 @@
+#ifndef MPICK_H
+#define MPICK_H
+
+/* Built-in fuzzy picker core, no curses: candidate lines are stored back to
+ * back in one string arena and filtered with fzy's matching and scoring,
+ * split across a pool of worker threads. mterm.c draws it (HOT_PICK). */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PICK_QUERY_MAX      256
+#define PICK_MATCH_MAX_LEN  1024   /* longer candidates match but rank last (as fzy) */
+
+typedef double PickScore;
+
+typedef struct {
+    uint32_t  idx;     /* candidate number (input order) */
+    uint32_t  bound;   /* score is only an upper bound, not computed yet */
+    PickScore score;
+} PickHit;
+
+typedef struct {
+    PickHit  *hits;
+    uint32_t  n, cap;
+    PickHit  *top;     /* the part's best `want`, to skip scoring the rest */
+    uint32_t  top_cap;
+} PickPart;
+
+typedef struct PickPool PickPool;
+
+/* An earlier (shorter) query and its matches. */
+typedef struct {
+    char      query[PICK_QUERY_MAX];
+    int       qlen;
+    PickHit  *hits;
+    uint32_t  nhits, cap;
+    uint32_t  scanned;
+} PickLevel;
+
+typedef struct {
+    /* Candidates: NUL-terminated lines in arena; #i starts at off[i] and
+     * off[n] is the end of the last complete line. Bytes after off[n] are
+     * an unfinished line still being read. */
+    char     *arena;
+    size_t    arena_len, arena_cap;
+    size_t   *off;
+    uint32_t  n, off_cap;
+
+    /* Matches of query, in candidate order (unused for the empty query,
+     * which matches everything in input order). */
+    char      query[PICK_QUERY_MAX];
+    int       qlen;
+    PickHit  *hits;
+    uint32_t  nhits, hits_cap;
+    uint32_t  scanned;   /* candidates [0, scanned) were matched against query */
+    /* Hits [narrow, narrow_end) of the last earlier query are still to be
+     * searched (before scanned); the query's matches are incomplete. */
+    uint32_t  narrow, narrow_end;
+
+    /* Earlier queries, each a prefix of the next and of query. */
+    PickLevel *hist;
+    int        nhist, hist_cap;
+
+    /* The best matches, best first. */
+    PickHit  *top;
+    uint32_t  ntop, top_cap;
+
+    int       threads;   /* parallel parts per filter (1 = no pool) */
+    PickPool *pool;      /* started on the first large filter */
+    PickPart *parts;
+    uint64_t  slice_ns;  /* pick_query/pick_update stop after about this long, 0 = never */
+    uint64_t  filter_ns; /* duration of the last pick_query/pick_update */
+} PickSet;
+
+void pick_init(PickSet *ps, int threads);
+void pick_free(PickSet *ps);
+
+/* Input: pick_space() returns room for at least want more bytes at the end
+ * of the arena; after writing n bytes there, pick_commit() splits off the
+ * completed lines (empty lines are dropped). pick_finish() completes an
+ * unterminated last line at end of input. */
+char  *pick_space(PickSet *ps, size_t want, size_t *room);
+void   pick_commit(PickSet *ps, size_t n);
+void   pick_finish(PickSet *ps);
+
+static inline const char *pick_str(const PickSet *ps, uint32_t idx) {
+    return ps->arena + ps->off[idx];
+}
+static inline uint32_t pick_matches(const PickSet *ps) {
+    return ps->qlen ? ps->nhits : ps->scanned;
+}
+/* Matching is not finished: call pick_update again. */
+static inline bool pick_pending(const PickSet *ps) {
+    return ps->narrow < ps->narrow_end || ps->scanned < ps->n;
+}
+
+/* Set the query. If it extends an earlier one only that query's matches
+ * are searched again; going back to an earlier query (Backspace) reuses
+ * its matches. The best `want` matches end up in ps->top. Work beyond
+ * slice_ns is left for pick_update, so a newer query can replace it. */
+void pick_query(PickSet *ps, const char *q, uint32_t want);
+/* Go on matching: the rest of the query, then candidates that arrived
+ * since the last call. */
+void pick_update(PickSet *ps, uint32_t want);
+/* Make sure ps->top holds the best `want` matches (e.g. after scrolling). */
+void pick_top(PickSet *ps, uint32_t want);
+
+/* Byte offsets in s of the query characters in fzy's best alignment (for
+ * highlighting); pos must hold strlen(q) entries. False if s does not match. */
+bool pick_positions(const char *q, const char *s, int *pos);
+
+#endif
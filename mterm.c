@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #define _XOPEN_SOURCE 700
 
 #include "mterm.h"
@@ -12,11 +13,16 @@
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <spawn.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <termios.h>
 #include <time.h>
+#include <wchar.h>
 
 static void sleep_ms(int ms) {
     if (ms <= 0) return;
@@ -26,935 +32,961 @@ static void sleep_ms(int ms) {
     while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {}
 }
 
+/* Integer tunable from the environment (PERFTUI_*), clamped to [lo, hi]. */
+static int env_int(const char *name, int def, int lo, int hi) {
+    const char *s = getenv(name);
+    if (!s || !*s) return def;
+    char *end = NULL;
+    long v = strtol(s, &end, 10);
+    if (end == s) return def;
+    if (v < lo) v = lo;
+    if (v > hi) v = hi;
+    return (int)v;
+}
+
 /* =========================
  *  Hot Popup: 在 a 类节点上弹出，并可在红框区域内运行交互程序（例如 top/fzy）
  *  - 使用 pty 跑 /bin/sh -lc <cmd>
- *  - 在 curses 子窗口里做最小 ANSI/VT100 渲染：
- *      * 支持 CSI m (SGR)：反显/加粗/下划线，用于 fzy 的匹配高亮与选中行高亮
+ *  - 子进程输出由 mterm_core.c 仿真（不依赖 curses），这里把 TermView 画进
+ *    curses 子窗口：SGR 颜色/反显/加粗/下划线，用于 fzy 的匹配高亮与选中行高亮
  *  - 对于 fzy：
  *      * Enter 选择后会退出，本窗口也随之关闭
- *      * 选中的那一行写入 owner->val，并在 TUI 中用 val 替换 [name] ____ 的 ____ 部分
+ *      * 选中结果经 stdout 管道取回（见 Selection channel），写入 owner->val，
+ *        并在 TUI 中用 val 替换 [name] ____ 的 ____ 部分
  * ========================= */
-#define TVA_REVERSE   0x01
-#define TVA_BOLD      0x02
-#define TVA_UNDERLINE 0x04
-#define TVA_DIM       0x08
-#define TVA_ACS       0x10 /* written while VT100 line-drawing charset active */
-
-#define TVA_FG_SHIFT  8
-#define TVA_BG_SHIFT  12
-#define TVA_FG_MASK   (0xFu << TVA_FG_SHIFT)
-#define TVA_BG_MASK   (0xFu << TVA_BG_SHIFT)
-#define TVA_FG_GET(a) (((uint16_t)(a) >> TVA_FG_SHIFT) & 0xF)
-#define TVA_BG_GET(a) (((uint16_t)(a) >> TVA_BG_SHIFT) & 0xF)
-#define TVA_FG_SET(a,v) do {     (a) = (uint16_t)(((uint16_t)(a) & (uint16_t)~TVA_FG_MASK) | (((uint16_t)((v) & 0xF)) << TVA_FG_SHIFT)); } while (0)
-#define TVA_BG_SET(a,v) do {     (a) = (uint16_t)(((uint16_t)(a) & (uint16_t)~TVA_BG_MASK) | (((uint16_t)((v) & 0xF)) << TVA_BG_SHIFT)); } while (0)
-
-
-static void term_free(TermView *t) {
-    if (!t) return;
-    free(t->cells); t->cells = NULL;
-    free(t->attrs); t->attrs = NULL;
-    t->rows = t->cols = 0;
-    t->cx = t->cy = 0;
-    t->saved_cx = t->saved_cy = 0;
-    t->cur_attr = 0;
-    t->wrap_pending = false;
-    t->scroll_top = 0;
-    t->scroll_bottom = 0;
-    t->esc_state = 0;
-    t->esc_len = 0;
-    t->osc_esc_seen = false;
-}
-
-static void term_clear_all(TermView *t) {
-    if (!t || !t->cells || !t->attrs) return;
-    memset(t->cells, ' ', (size_t)t->rows * (size_t)t->cols);
-    memset(t->attrs, 0,   (size_t)t->rows * (size_t)t->cols * sizeof(uint16_t));
-    t->cx = t->cy = 0;
-    t->cur_attr = 0;
-    t->g0_charset = 0;
-    t->g1_charset = 0;
-    t->use_g1 = false;
-    t->app_cursor = false;
-    t->app_keypad = false;
-    t->scroll_top = 0;
-    t->scroll_bottom = t->rows > 0 ? (t->rows - 1) : 0;
-    t->wrap_pending = false;
-}
-
-/* Clear only the screen buffer (cells/attrs) but keep terminal modes.
- * This is important for ncurses apps when the viewport is resized:
- * we want a clean canvas without losing DECCKM / keypad modes. */
-static void term_clear_screenbuf_keep_modes(TermView *t) {
-    if (!t || !t->cells || !t->attrs) return;
-    memset(t->cells, ' ', (size_t)t->rows * (size_t)t->cols);
-    memset(t->attrs, 0,   (size_t)t->rows * (size_t)t->cols * sizeof(uint16_t));
-    t->cx = t->cy = 0;
-    t->saved_cx = t->saved_cy = 0;
-    t->cur_attr = 0;
-    t->wrap_pending = false;
-    t->scroll_top = 0;
-    t->scroll_bottom = t->rows > 0 ? (t->rows - 1) : 0;
-}
-
-static void term_init(TermView *t, int rows, int cols) {
-    memset(t, 0, sizeof(*t));
-    if (rows < 1) rows = 1;
-    if (cols < 1) cols = 1;
-    t->rows = rows;
-    t->cols = cols;
-    t->cells = (char*)malloc((size_t)rows * (size_t)cols);
-    t->attrs = (uint16_t*)malloc((size_t)rows * (size_t)cols * sizeof(uint16_t));
-    if (!t->cells || !t->attrs) { perror("malloc"); exit(1); }
-    term_clear_all(t);
-}
-
-static inline bool term_is_acs(const TermView *t) {
-    if (!t) return false;
-    uint8_t cs = t->use_g1 ? t->g1_charset : t->g0_charset;
-    return cs == 1;
-}
-
-static void term_resize(TermView *t, int rows, int cols) {
-    if (!t) return;
-    if (rows < 1) rows = 1;
-    if (cols < 1) cols = 1;
-    if (rows == t->rows && cols == t->cols && t->cells && t->attrs) return;
-
-    char *oldc = t->cells;
-    uint16_t *olda = t->attrs;
-    int orows = t->rows, ocols = t->cols;
-
-    t->rows = rows;
-    t->cols = cols;
-    t->cells = (char*)malloc((size_t)rows * (size_t)cols);
-    t->attrs = (uint16_t*)malloc((size_t)rows * (size_t)cols * sizeof(uint16_t));
-    if (!t->cells || !t->attrs) { perror("malloc"); exit(1); }
-    memset(t->cells, ' ', (size_t)rows * (size_t)cols);
-    memset(t->attrs, 0,   (size_t)rows * (size_t)cols * sizeof(uint16_t));
-
-    if (oldc && olda) {
-        int rmin = (orows < rows) ? orows : rows;
-        int cmin = (ocols < cols) ? ocols : cols;
-        for (int r = 0; r < rmin; r++) {
-            memcpy(t->cells + (size_t)r * (size_t)cols,
-                   oldc + (size_t)r * (size_t)ocols, (size_t)cmin);
-            memcpy(t->attrs + (size_t)r * (size_t)cols,
-                   olda + (size_t)r * (size_t)ocols, (size_t)cmin * sizeof(uint16_t));
-        }
-        free(oldc);
-        free(olda);
-    } else {
-        free(oldc);
-        free(olda);
-    }
 
-    if (t->cy >= rows) t->cy = rows - 1;
-    if (t->cx >= cols) t->cx = cols - 1;
-    t->wrap_pending = false;
+/* =========================
+ *  Color pairs
+ *  curses 的 color pair 是全局有限资源（COLOR_PAIRS）：
+ *  - (fg, bg) -> pair 用哈希表查找，按最近使用串成 LRU 链表
+ *  - 用完后回收最久未用的 pair 重新定义，term_pair_epoch 加一；
+ *    term_draw 看到 epoch 变化就整屏重画，屏上不会留下变了色的旧 pair
+ *  - 每个 style 缓存自己的 curses 颜色/属性和 pair，绘制时只需 O(1) 校验
+ *  颜色按终端能力映射：24 位（direct color）> 256 色 > 16 色 > 8 色（亮色用 A_BOLD）
+ * ========================= */
+#define TERM_PAIR_FIRST 10      /* 1..3 已被 UI 使用 */
+#define TERM_PAIR_HASH  4096
+
+typedef struct {
+    int fg, bg;
+    int prev, next;   /* LRU list, most recent first */
+    int hnext;        /* hash chain */
+} TermPairSlot;
+
+static TermPairSlot *term_pairs;        /* indexed by pair number */
+static int  term_pair_cap;              /* pair numbers in use: [TERM_PAIR_FIRST, cap) */
+static int  term_pair_next = TERM_PAIR_FIRST;
+static int  term_pair_mru = -1, term_pair_lru = -1;
+static int  term_pair_hash[TERM_PAIR_HASH];
+static unsigned term_pair_epoch;
+
+#ifdef NCURSES_EXT_COLORS
+#define TERM_PAIR_LIMIT 65536
+#else
+#define TERM_PAIR_LIMIT 32767
+#endif
 
-    /* clamp scroll region */
-    if (t->scroll_top < 0) t->scroll_top = 0;
-    if (t->scroll_bottom < 0) t->scroll_bottom = rows - 1;
-    if (t->scroll_top >= rows) t->scroll_top = 0;
-    if (t->scroll_bottom >= rows) t->scroll_bottom = rows - 1;
-    if (t->scroll_top > t->scroll_bottom) {
-        t->scroll_top = 0;
-        t->scroll_bottom = rows - 1;
-    }
+static inline int term_pair_bucket(int fg, int bg) {
+    return (int)(((uint32_t)fg * 0x9E3779B1u ^ (uint32_t)bg * 0x85EBCA77u) >> 20) & (TERM_PAIR_HASH - 1);
 }
 
-static void term_fill_blank_line(TermView *t, int row) {
-    if (!t || !t->cells || !t->attrs) return;
-    if (row < 0 || row >= t->rows) return;
-    size_t off = (size_t)row * (size_t)t->cols;
-    memset(t->cells + off, ' ', (size_t)t->cols);
-    for (int c = 0; c < t->cols; c++) t->attrs[off + (size_t)c] = t->cur_attr;
+static void term_pair_unlink(int p) {
+    TermPairSlot *s = &term_pairs[p];
+    if (s->prev >= 0) term_pairs[s->prev].next = s->next; else term_pair_mru = s->next;
+    if (s->next >= 0) term_pairs[s->next].prev = s->prev; else term_pair_lru = s->prev;
 }
 
-static void term_scroll_up_region(TermView *t, int top, int bottom, int n) {
-    if (!t || !t->cells || !t->attrs || n <= 0) return;
-    if (top < 0) top = 0;
-    if (bottom >= t->rows) bottom = t->rows - 1;
-    if (top > bottom) return;
-    int height = bottom - top + 1;
-    if (n >= height) {
-        for (int r = top; r <= bottom; r++) term_fill_blank_line(t, r);
-        return;
-    }
-    size_t row_bytes = (size_t)t->cols;
-    /* move up */
-    memmove(t->cells + (size_t)top * row_bytes,
-            t->cells + (size_t)(top + n) * row_bytes,
-            (size_t)(height - n) * row_bytes);
-    memmove(t->attrs + (size_t)top * row_bytes,
-            t->attrs + (size_t)(top + n) * row_bytes,
-            (size_t)(height - n) * row_bytes * sizeof(uint16_t));
-    for (int r = bottom - n + 1; r <= bottom; r++) term_fill_blank_line(t, r);
-}
-
-static void term_scroll_down_region(TermView *t, int top, int bottom, int n) {
-    if (!t || !t->cells || !t->attrs || n <= 0) return;
-    if (top < 0) top = 0;
-    if (bottom >= t->rows) bottom = t->rows - 1;
-    if (top > bottom) return;
-    int height = bottom - top + 1;
-    if (n >= height) {
-        for (int r = top; r <= bottom; r++) term_fill_blank_line(t, r);
-        return;
-    }
-    size_t row_bytes = (size_t)t->cols;
-    /* move down */
-    memmove(t->cells + (size_t)(top + n) * row_bytes,
-            t->cells + (size_t)top * row_bytes,
-            (size_t)(height - n) * row_bytes);
-    memmove(t->attrs + (size_t)(top + n) * row_bytes,
-            t->attrs + (size_t)top * row_bytes,
-            (size_t)(height - n) * row_bytes * sizeof(uint16_t));
-    for (int r = top; r < top + n; r++) term_fill_blank_line(t, r);
+static void term_pair_push(int p) {
+    TermPairSlot *s = &term_pairs[p];
+    s->prev = -1;
+    s->next = term_pair_mru;
+    if (term_pair_mru >= 0) term_pairs[term_pair_mru].prev = p; else term_pair_lru = p;
+    term_pair_mru = p;
 }
 
-static void term_scroll_up(TermView *t, int n) {
-    /* full screen scroll */
-    term_scroll_up_region(t, 0, t ? (t->rows - 1) : 0, n);
+static inline void term_pair_touch(int p) {
+    if (p == term_pair_mru) return;
+    term_pair_unlink(p);
+    term_pair_push(p);
 }
 
-static void term_erase_all_keep_modes(TermView *t) {
-    if (!t || !t->cells || !t->attrs) return;
-    memset(t->cells, ' ', (size_t)t->rows * (size_t)t->cols);
-    for (size_t i = 0, N = (size_t)t->rows * (size_t)t->cols; i < N; i++) t->attrs[i] = t->cur_attr;
+static bool term_pair_setup(void) {
+    if (term_pairs) return true;
+    if (!has_colors()) return false;
+    term_pair_cap = COLOR_PAIRS < TERM_PAIR_LIMIT ? COLOR_PAIRS : TERM_PAIR_LIMIT;
+    if (term_pair_cap <= TERM_PAIR_FIRST) return false;
+    term_pairs = (TermPairSlot*)calloc((size_t)term_pair_cap, sizeof(TermPairSlot));
+    if (!term_pairs) { perror("calloc"); exit(1); }
+    for (int i = 0; i < TERM_PAIR_HASH; i++) term_pair_hash[i] = -1;
+    return true;
 }
 
-static void term_get_region(TermView *t, int *top, int *bottom) {
-    int tt = 0, bb = 0;
-    if (t) {
-        tt = t->scroll_top;
-        bb = t->scroll_bottom;
+/* Pair for curses colors (fg, bg); 0 for (default, default) or no colors. */
+static int term_pair_get(int fg, int bg) {
+    if ((fg < 0 && bg < 0) || !term_pair_setup()) return 0;
+    int h = term_pair_bucket(fg, bg);
+    for (int p = term_pair_hash[h]; p >= 0; p = term_pairs[p].hnext) {
+        if (term_pairs[p].fg == fg && term_pairs[p].bg == bg) {
+            term_pair_touch(p);
+            return p;
+        }
     }
-    if (!t || tt < 0 || bb < 0 || tt >= t->rows || bb >= t->rows || tt > bb) {
-        tt = 0;
-        bb = t ? (t->rows - 1) : 0;
+    int p;
+    if (term_pair_next < term_pair_cap) {
+        p = term_pair_next++;
+    } else {
+        /* recycle the least recently used pair */
+        p = term_pair_lru;
+        term_pair_unlink(p);
+        int *pp = &term_pair_hash[term_pair_bucket(term_pairs[p].fg, term_pairs[p].bg)];
+        while (*pp != p) pp = &term_pairs[*pp].hnext;
+        *pp = term_pairs[p].hnext;
+        term_pair_epoch++;
     }
-    if (top) *top = tt;
-    if (bottom) *bottom = bb;
+#ifdef NCURSES_EXT_COLORS
+    init_extended_pair(p, fg, bg);
+#else
+    init_pair((short)p, (short)fg, (short)bg);
+#endif
+    term_pairs[p].fg = fg;
+    term_pairs[p].bg = bg;
+    term_pairs[p].hnext = term_pair_hash[h];
+    term_pair_hash[h] = p;
+    term_pair_push(p);
+    return p;
 }
 
-static void term_insert_lines(TermView *t, int n) {
-    if (!t || !t->cells || !t->attrs) return;
-    if (n <= 0) n = 1;
-    int top, bottom;
-    term_get_region(t, &top, &bottom);
-    if (t->cy < top || t->cy > bottom) return;
-    int maxn = bottom - t->cy + 1;
-    if (n > maxn) n = maxn;
+/* xterm-256 palette entry n as 0xRRGGBB. */
+static uint32_t term_xterm256_rgb(int n) {
+    static const uint32_t base[16] = {
+        0x000000, 0xCD0000, 0x00CD00, 0xCDCD00, 0x0000EE, 0xCD00CD, 0x00CDCD, 0xE5E5E5,
+        0x7F7F7F, 0xFF0000, 0x00FF00, 0xFFFF00, 0x5C5CFF, 0xFF00FF, 0x00FFFF, 0xFFFFFF,
+    };
+    static const int lv[6] = { 0, 95, 135, 175, 215, 255 };
+    if (n < 16) return base[n];
+    if (n >= 232) {
+        uint32_t v = (uint32_t)(8 + 10 * (n - 232));
+        return v << 16 | v << 8 | v;
+    }
+    n -= 16;
+    return (uint32_t)lv[n / 36] << 16 | (uint32_t)lv[(n / 6) % 6] << 8 | (uint32_t)lv[n % 6];
+}
 
-    /* shift down within region: [cy..bottom-n] -> [cy+n..bottom] */
-    for (int r = bottom; r >= t->cy + n; r--) {
-        size_t dst = (size_t)r * (size_t)t->cols;
-        size_t src = (size_t)(r - n) * (size_t)t->cols;
-        memcpy(t->cells + dst, t->cells + src, (size_t)t->cols);
-        memcpy(t->attrs + dst, t->attrs + src, (size_t)t->cols * sizeof(uint16_t));
+/* TERM_COLOR_* -> curses color number for this terminal (-1 = default).
+ * *bright is set when an 8-color terminal should show it with A_BOLD. */
+static int term_color_to_curses(uint32_t c, bool *bright) {
+    if (!c || !has_colors()) return -1;
+    bool rgb = (c & TERM_COLOR_RGB) != 0;
+    int r = (int)(c >> 16) & 0xFF, g = (int)(c >> 8) & 0xFF, b = (int)c & 0xFF;
+#ifdef NCURSES_EXT_COLORS
+    if (COLORS >= 0x1000000) {
+        /* direct color: numbers are 0xRRGGBB, except 0..7 = ANSI colors */
+        if (!rgb && (c & 0xFF) < 8) return (int)(c & 0xFF);
+        int v = rgb ? (int)(c & 0xFFFFFF) : (int)term_xterm256_rgb((int)(c & 0xFF));
+        return v < 8 ? 8 : v;
     }
-    for (int r = t->cy; r < t->cy + n; r++) term_fill_blank_line(t, r);
+#endif
+    int idx = rgb ? term_rgb_to_xterm256(r, g, b) : (int)(c & 0xFF);
+    if (COLORS >= 256) return idx;
+    if (COLORS >= 16 && idx < 16) return idx;
+    if (idx >= 8 && idx < 16) *bright = true;
+    return term_xterm256_to_ansi8(idx);
 }
 
-static void term_delete_lines(TermView *t, int n) {
-    if (!t || !t->cells || !t->attrs) return;
-    if (n <= 0) n = 1;
-    int top, bottom;
-    term_get_region(t, &top, &bottom);
-    if (t->cy < top || t->cy > bottom) return;
-    int maxn = bottom - t->cy + 1;
-    if (n > maxn) n = maxn;
+static void term_style_resolve(TermStyle *st) {
+    bool bright = false, bg_bright = false;
+    st->cfg = term_color_to_curses(st->fg, &bright);
+    st->cbg = term_color_to_curses(st->bg, &bg_bright);
+    attr_t a = 0;
+    if (st->flags & TVA_REVERSE)   a |= A_REVERSE;
+    if ((st->flags & TVA_BOLD) || bright) a |= A_BOLD;
+    if (st->flags & TVA_UNDERLINE) a |= A_UNDERLINE;
+#ifdef A_DIM
+    if (st->flags & TVA_DIM)       a |= A_DIM;
+#endif
+    st->cattr = a;
+    st->pair = 0;
+    st->resolved = true;
+}
 
-    /* shift up within region: [cy+n..bottom] -> [cy..bottom-n] */
-    for (int r = t->cy; r <= bottom - n; r++) {
-        size_t dst = (size_t)r * (size_t)t->cols;
-        size_t src = (size_t)(r + n) * (size_t)t->cols;
-        memcpy(t->cells + dst, t->cells + src, (size_t)t->cols);
-        memcpy(t->attrs + dst, t->attrs + src, (size_t)t->cols * sizeof(uint16_t));
+/* curses attributes and pair of style id (translation cached per style). */
+static attr_t term_style_curses(TermView *t, uint16_t id, int *pair) {
+    if (id == 0 || id >= t->nstyles) { *pair = 0; return 0; }
+    TermStyle *st = &t->styles[id];
+    if (!st->resolved) term_style_resolve(st);
+    if (st->cfg < 0 && st->cbg < 0) {
+        *pair = 0;
+    } else if (st->pair && term_pairs[st->pair].fg == st->cfg && term_pairs[st->pair].bg == st->cbg) {
+        term_pair_touch(st->pair);
+        *pair = st->pair;
+    } else {
+        *pair = st->pair = term_pair_get(st->cfg, st->cbg);
     }
-    for (int r = bottom - n + 1; r <= bottom; r++) term_fill_blank_line(t, r);
+    return st->cattr;
 }
 
-static void term_insert_chars(TermView *t, int n) {
-    if (!t || !t->cells || !t->attrs) return;
-    if (n <= 0) n = 1;
-    if (t->cx < 0) t->cx = 0;
-    if (t->cx >= t->cols) return;
-    if (n > t->cols - t->cx) n = t->cols - t->cx;
-    size_t row = (size_t)t->cy * (size_t)t->cols;
-
-    for (int c = t->cols - 1; c >= t->cx + n; c--) {
-        t->cells[row + (size_t)c] = t->cells[row + (size_t)(c - n)];
-        t->attrs[row + (size_t)c] = t->attrs[row + (size_t)(c - n)];
+/* Draw one row at window row r: cells [0, ext) clipped to cols, then
+ * blanks to width W. The cells go out in batched mvwadd_wchnstr calls; the
+ * right half of a wide character has no entry of its own (curses fills it
+ * in). */
+static void term_draw_row(WINDOW *win, TermView *t, int r, const TermCell *cells, int ext, int cols, int W) {
+    if (ext < cols) cols = ext;
+    cchar_t buf[256];
+    int n = 0, x0 = 0;
+    uint16_t prev = 0;
+    int pair = 0;
+    attr_t ca = 0;
+    bool wide = false; /* previous entry was a wide character */
+    for (int c = 0; c < cols; c++) {
+        const TermCell *cell = &cells[c];
+        if (cell->width == 0 && wide) { wide = false; continue; }
+        if (n == (int)(sizeof(buf) / sizeof(buf[0]))) {
+            mvwadd_wchnstr(win, r, x0, buf, n);
+            x0 = c;
+            n = 0;
+        }
+        if (cell->attr != prev) { prev = cell->attr; ca = term_style_curses(t, prev, &pair); }
+        /* a stray right half (or NUL) must still take one column */
+        wchar_t wc[2] = { (cell->width == 0 || cell->ch == 0) ? L' ' : (wchar_t)cell->ch, 0 };
+        if (cell->width == 2 && c + 1 >= cols) wc[0] = L' '; /* cut by the window edge */
+#ifdef NCURSES_EXT_COLORS
+        setcchar(&buf[n++], wc, ca, 0, &pair);
+#else
+        setcchar(&buf[n++], wc, ca, (short)pair, NULL);
+#endif
+        wide = cell->width == 2;
     }
-    for (int c = t->cx; c < t->cx + n; c++) {
-        t->cells[row + (size_t)c] = ' ';
-        t->attrs[row + (size_t)c] = t->cur_attr;
+    if (n) mvwadd_wchnstr(win, r, x0, buf, n);
+    if (cols < W) {
+        wattrset(win, 0);
+        mvwhline(win, r, cols, ' ', W - cols);
     }
 }
 
-static void term_delete_chars(TermView *t, int n) {
-    if (!t || !t->cells || !t->attrs) return;
-    if (n <= 0) n = 1;
-    if (t->cx < 0) t->cx = 0;
-    if (t->cx >= t->cols) return;
-    if (n > t->cols - t->cx) n = t->cols - t->cx;
-    size_t row = (size_t)t->cy * (size_t)t->cols;
+/* Push rows to curses. Only rows marked dirty are rewritten unless full
+ * (window content lost: new window, base UI redrawn over it). */
+static void term_draw(WINDOW *win, TermView *t, bool full) {
+    if (!win || !t || !t->cells || !t->dirty) return;
+    int H, W;
+    getmaxyx(win, H, W);
+    int rows = (t->rows < H) ? t->rows : H;
+    int cols = (t->cols < W) ? t->cols : W;
+    if (t->pair_epoch != term_pair_epoch) {
+        /* pairs were redefined since the last frame: repaint everything */
+        full = true;
+        t->pair_epoch = term_pair_epoch;
+    }
 
-    for (int c = t->cx; c < t->cols - n; c++) {
-        t->cells[row + (size_t)c] = t->cells[row + (size_t)(c + n)];
-        t->attrs[row + (size_t)c] = t->attrs[row + (size_t)(c + n)];
+    for (int r = 0; r < rows; r++) {
+        if (!full && !t->dirty[r]) continue;
+        t->dirty[r] = 0;
+        term_draw_row(win, t, r, term_row(t, r), term_ext(t, r), cols, W);
     }
-    for (int c = t->cols - n; c < t->cols; c++) {
-        t->cells[row + (size_t)c] = ' ';
-        t->attrs[row + (size_t)c] = t->cur_attr;
+    for (int r = rows; r < t->rows; r++) t->dirty[r] = 0;
+    if (full) {
+        for (int r = rows; r < H; r++) mvwhline(win, r, 0, ' ', W);
     }
 }
 
-static void term_erase_chars(TermView *t, int n) {
-    if (!t || !t->cells || !t->attrs) return;
-    if (n <= 0) n = 1;
-    if (t->cx < 0) t->cx = 0;
-    if (t->cx >= t->cols) return;
-    if (n > t->cols - t->cx) n = t->cols - t->cx;
-    size_t row = (size_t)t->cy * (size_t)t->cols;
-    for (int c = 0; c < n; c++) {
-        t->cells[row + (size_t)(t->cx + c)] = ' ';
-        t->attrs[row + (size_t)(t->cx + c)] = t->cur_attr;
-    }
+/* =========================
+ *  Passthrough rendering
+ *  HOT_TERM 的增量帧不经过 curses：脏行直接按弹窗坐标写成终端序列
+ *  （cup + SGR + UTF-8 文本 + ech 补齐），省掉 cchar_t 填充和 doupdate 的
+ *  第二次比较。curses 的状态不受影响：
+ *  - 序列全部取自 terminfo（cup/ech/sc/rc/sgr0/bold/dim/smul/rev/setaf/setab），
+ *    缺 cup/ech/sc/rc/sgr0，或有颜色却缺 setaf/setab 的终端不启用
+ *  - 颜色号就是 curses 路径用的号（term_color_to_curses 已按 COLORS 换算）
+ *  - 整段输出包在 sc/rc 里，光标、SGR 恢复成 curses 以为的样子
+ *  - curses 不再知道弹窗里的真实内容（pt_painted），因此整帧重画、
+ *    基础界面重画、历史视图、关闭弹窗时先 redrawwin，由 curses 完整重画
+ *  - 写终端出错：这一帧改由 curses 整窗重画，之后不再直写
+ *  PERFTUI_HOT_PASSTHROUGH=0 关闭（始终走 curses）
+ *  代价（60x200，43 行全屏 28 帧/秒）：每帧 CPU 约为 curses 路径的 55%，
+ *  但整行重写，写到终端的字节约为 curses 差分输出的 2.5 倍
+ * ========================= */
+typedef struct {
+    char  *buf;
+    size_t len, cap;
+} HotPtBuf;
+
+typedef struct {
+    const char *cup, *ech, *sc, *rc, *sgr0;
+    const char *bold, *dim, *smul, *rev, *setaf, *setab;
+} HotPtCaps;
+
+static HotPtBuf  hot_pt_buf;
+static HotPtCaps hot_pt_caps;
+
+static void hot_pt_reserve(HotPtBuf *b, size_t n) {
+    if (b->len + n <= b->cap) return;
+    size_t nc = b->cap ? b->cap : 16384;
+    while (nc < b->len + n) nc *= 2;
+    b->buf = (char*)realloc(b->buf, nc);
+    if (!b->buf) { perror("realloc"); exit(1); }
+    b->cap = nc;
+}
+
+static void hot_pt_put(HotPtBuf *b, const char *s) {
+    if (!s) return;
+    size_t n = strlen(s);
+    hot_pt_reserve(b, n);
+    memcpy(b->buf + b->len, s, n);
+    b->len += n;
+}
+
+static const char *hot_pt_cap(const char *name) {
+    char *s = tigetstr(name);
+    return (s && s != (char*)-1 && s[0]) ? s : NULL;
+}
+
+/* Look up the terminfo strings; false if this terminal cannot do it. */
+static bool hot_pt_init(void) {
+    HotPtCaps *c = &hot_pt_caps;
+    c->cup = hot_pt_cap("cup");
+    c->ech = hot_pt_cap("ech");
+    c->sc = hot_pt_cap("sc");
+    c->rc = hot_pt_cap("rc");
+    c->sgr0 = hot_pt_cap("sgr0");
+    c->bold = hot_pt_cap("bold");
+    c->dim = hot_pt_cap("dim");
+    c->smul = hot_pt_cap("smul");
+    c->rev = hot_pt_cap("rev");
+    c->setaf = hot_pt_cap("setaf");
+    c->setab = hot_pt_cap("setab");
+    if (!c->cup || !c->ech || !c->sc || !c->rc || !c->sgr0) return false;
+    if (has_colors() && (!c->setaf || !c->setab)) return false;
+    return true;
+}
+
+/* Full SGR (sgr0 first) for style id: the same colors and attributes the
+ * curses path would use. */
+static void hot_pt_sgr(HotPtBuf *b, TermView *t, uint16_t id) {
+    const HotPtCaps *c = &hot_pt_caps;
+    hot_pt_put(b, c->sgr0);
+    if (id == 0 || id >= t->nstyles) return;
+    TermStyle *st = &t->styles[id];
+    if (!st->resolved) term_style_resolve(st);
+    if (st->cattr & A_BOLD)      hot_pt_put(b, c->bold);
+#ifdef A_DIM
+    if (st->cattr & A_DIM)       hot_pt_put(b, c->dim);
+#endif
+    if (st->cattr & A_UNDERLINE) hot_pt_put(b, c->smul);
+    if (st->cattr & A_REVERSE)   hot_pt_put(b, c->rev);
+    if (st->cfg >= 0 && c->setaf) hot_pt_put(b, tiparm(c->setaf, st->cfg));
+    if (st->cbg >= 0 && c->setab) hot_pt_put(b, tiparm(c->setab, st->cbg));
 }
-
-static void term_lf(TermView *t) {
-    if (!t) return;
-    t->wrap_pending = false;
-    int top = t->scroll_top;
-    int bottom = t->scroll_bottom;
-    if (top < 0 || bottom < 0 || top >= t->rows || bottom >= t->rows || top > bottom) {
-        top = 0;
-        bottom = t->rows - 1;
+
+/* Write the dirty rows of the attached session straight to the terminal.
+ * False if the write failed: the terminal holds part of a frame. */
+static bool hot_pt_draw(HotPopup *p) {
+    HotPtBuf *b = &hot_pt_buf;
+    const HotPtCaps *c = &hot_pt_caps;
+    TermView *t = &p->sess.term;
+    if (!t->cells || !t->dirty) return true;
+    int H, W, by, bx;
+    getmaxyx(p->wi, H, W);
+    getbegyx(p->wi, by, bx);
+    int rows = (t->rows < H) ? t->rows : H;
+    int cols = (t->cols < W) ? t->cols : W;
+
+    b->len = 0;
+    for (int r = 0; r < rows; r++) {
+        if (!t->dirty[r]) continue;
+        t->dirty[r] = 0;
+        const TermCell *row = term_row(t, r);
+        int n = term_ext(t, r) < cols ? term_ext(t, r) : cols;
+        if (b->len == 0) hot_pt_put(b, c->sc);
+        hot_pt_put(b, tiparm(c->cup, by + r, bx));
+        hot_pt_reserve(b, (size_t)n * 4);
+        int cur = -1;
+        bool wide = false;
+        for (int k = 0; k < n; k++) {
+            const TermCell *cell = &row[k];
+            if (cell->width == 0 && wide) { wide = false; continue; }
+            if (cell->attr != cur) {
+                cur = cell->attr;
+                hot_pt_sgr(b, t, cell->attr);
+                hot_pt_reserve(b, (size_t)(n - k) * 4);
+            }
+            uint32_t ch = cell->ch;
+            if (cell->width == 0 || ch == 0 || (cell->width == 2 && k + 1 >= n)) ch = ' ';
+            if (ch < 0x80) b->buf[b->len++] = (char)ch;
+            else b->len += (size_t)term_u8_put(b->buf + b->len, ch);
+            wide = cell->width == 2;
+        }
+        if (n < W) {
+            if (cur != 0) hot_pt_put(b, c->sgr0);
+            hot_pt_put(b, tiparm(c->ech, W - n));
+        }
     }
-
-    if (t->cy == bottom) {
-        term_scroll_up_region(t, top, bottom, 1);
-        t->cy = bottom;
-    } else {
-        t->cy++;
-        if (t->cy >= t->rows) t->cy = t->rows - 1;
+    for (int r = rows; r < t->rows; r++) t->dirty[r] = 0;
+    if (b->len == 0) return true;
+    hot_pt_put(b, c->sgr0);
+    hot_pt_put(b, c->rc);
+
+    size_t off = 0;
+    while (off < b->len) {
+        ssize_t w = write(STDOUT_FILENO, b->buf + off, b->len - off);
+        if (w > 0) { off += (size_t)w; continue; }
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0 && errno == EAGAIN) { poll(&(struct pollfd){ STDOUT_FILENO, POLLOUT, 0 }, 1, 50); continue; }
+        return false;
     }
+    p->pt_painted = true;
+    return true;
 }
 
-static void term_ri(TermView *t) {
-    if (!t) return;
-    t->wrap_pending = false;
-    int top = t->scroll_top;
-    int bottom = t->scroll_bottom;
-    if (top < 0 || bottom < 0 || top >= t->rows || bottom >= t->rows || top > bottom) {
-        top = 0;
-        bottom = t->rows - 1;
-    }
+/* Before curses draws the popup again: its idea of what is on screen there
+ * is stale, so have it repaint the popup lines in full. */
+static void hot_pt_sync(HotPopup *p) {
+    if (!p->pt_painted) return;
+    if (p->wb) redrawwin(p->wb);
+    p->pt_painted = false;
+}
 
-    if (t->cy == top) {
-        term_scroll_down_region(t, top, bottom, 1);
-        t->cy = top;
-    } else {
-        t->cy--;
-        if (t->cy < 0) t->cy = 0;
-    }
-}
-
-static void term_put_ch(TermView *t, char ch) {
-    if (!t || !t->cells || !t->attrs) return;
-
-    if (t->cx < 0) t->cx = 0;
-    if (t->cy < 0) t->cy = 0;
-
-    /* VT100 autowrap:
-     * When a character is written in the last column, the cursor does not
-     * immediately advance to the next line. Instead, a "wrap pending" flag is
-     * set and the *next* printable character triggers the line wrap.
-     *
-     * Many ncurses apps (top/htop) write full-width lines and also emit explicit
-     * cursor moves / linefeeds. If we wrap immediately, we end up skipping a
-     * line and showing "blank lines" between rows. */
-    if (t->wrap_pending) {
-        t->wrap_pending = false;
-        t->cx = 0;
-        t->cy++;
-        if (t->cy >= t->rows) {
-            term_scroll_up(t, 1);
-            t->cy = t->rows - 1;
+/* Scrollback view: history lines followed by the screen, starting at the
+ * absolute line top; the search hit (if any) is shown reversed. */
+static void term_draw_history(WINDOW *win, TermView *t, uint64_t top, int64_t hit, int hit_col, int hit_len) {
+    if (!win || !t || !t->cells || !t->sb) return;
+    int H, W;
+    getmaxyx(win, H, W);
+    int cols = (t->cols < W) ? t->cols : W;
+    const TermScrollback *sb = t->sb;
+    uint64_t live = sb->base + (uint64_t)sb->nlines;
+    TermCell cells[TERM_SB_MAX_COLS];
+    if (cols > TERM_SB_MAX_COLS) cols = TERM_SB_MAX_COLS;
+
+    for (int r = 0; r < H; r++) {
+        uint64_t a = top + (uint64_t)r;
+        if (a < sb->base) {
+            mvwhline(win, r, 0, ' ', W);
+        } else if (a < live) {
+            term_sb_decode(term_sb_line(sb, (int)(a - sb->base)), cells, cols);
+            term_draw_row(win, t, r, cells, cols, cols, W);
+        } else if (a - live < (uint64_t)t->rows) {
+            int sr = (int)(a - live);
+            term_draw_row(win, t, r, term_row(t, sr), term_ext(t, sr), cols, W);
+        } else {
+            mvwhline(win, r, 0, ' ', W);
         }
+        if (hit >= 0 && (uint64_t)hit == a && hit_col < W)
+            mvwchgat(win, r, hit_col, hit_len, A_REVERSE, 0, NULL);
     }
+}
 
-    if (t->cx >= t->cols) t->cx = t->cols - 1;
-    if (t->cy >= t->rows) {
-        term_scroll_up(t, 1);
-        t->cy = t->rows - 1;
-    }
+static int set_nonblock(int fd) {
+    int fl = fcntl(fd, F_GETFL, 0);
+    if (fl < 0) return -1;
+    return fcntl(fd, F_SETFL, fl | O_NONBLOCK);
+}
 
-    size_t idx = (size_t)t->cy * (size_t)t->cols + (size_t)t->cx;
-    t->cells[idx] = ch;
-    t->attrs[idx] = (uint16_t)(t->cur_attr | (term_is_acs(t) ? TVA_ACS : 0));
+static int open_pty_master(void) {
+    /* CLOEXEC: later children must not inherit other sessions' masters */
+    int m = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (m < 0) return -1;
+    if (grantpt(m) != 0) { close(m); return -1; }
+    if (unlockpt(m) != 0) { close(m); return -1; }
+    return m;
+}
 
-    if (t->cx == t->cols - 1) {
-        t->wrap_pending = true;
-        /* keep cx at last column */
-    } else {
-        t->cx++;
+/* =========================
+ *  Outbound queue (按键/粘贴 -> 子进程)
+ *  - 按键先入队，主循环读完一批按键后统一 write，粘贴只需一次系统调用
+ *  - master 为非阻塞：短写/EAGAIN 时保留剩余数据，等 poll 报告可写再继续
+ *  - 子进程不读输入时键盘照常读：Ctrl+X、回看等弹窗按键仍然有效，
+ *    发给子进程的按键留在队列里；粘贴最多 HOT_PASTE_MAX，队列里
+ *    积压的粘贴超过 HOT_OUTQ_MAX 的部分丢弃（不无限增长）
+ * ========================= */
+#define HOT_OUTQ_MAX   (4 * 1024 * 1024)
+#define HOT_PASTE_MAX  (1024 * 1024)
+
+static void hot_outq_push(HotOutQ *q, const char *s, size_t n) {
+    if (!q || !s || n == 0) return;
+    if (q->off > 0 && q->off == q->len) q->off = q->len = 0;
+    if (q->len + n > q->cap) {
+        /* reclaim the written prefix before growing */
+        if (q->off > 0) {
+            memmove(q->buf, q->buf + q->off, q->len - q->off);
+            q->len -= q->off;
+            q->off = 0;
+        }
+        if (q->len + n > q->cap) {
+            size_t nc = q->cap ? q->cap : 1024;
+            while (nc < q->len + n) nc *= 2;
+            char *nb = (char*)realloc(q->buf, nc);
+            if (!nb) { perror("realloc"); exit(1); }
+            q->buf = nb;
+            q->cap = nc;
+        }
     }
+    memcpy(q->buf + q->len, s, n);
+    q->len += n;
 }
 
-static int csi_get_int(const char *s, int *i, int end) {
-    int v = 0, any = 0;
-    while (*i < end && s[*i] && isdigit((unsigned char)s[*i])) { v = v * 10 + (s[*i] - '0'); (*i)++; any = 1; }
-    return any ? v : -1;
+static size_t hot_outq_pending(const HotOutQ *q) {
+    return q ? q->len - q->off : 0;
 }
 
-static void term_clear_line_from(TermView *t, int from_x) {
-    if (!t || !t->cells || !t->attrs) return;
-    if (from_x < 0) from_x = 0;
-    if (from_x >= t->cols) return;
-    size_t off = (size_t)t->cy * (size_t)t->cols + (size_t)from_x;
-    size_t n = (size_t)(t->cols - from_x);
-    memset(t->cells + off, ' ', n);
-    for (size_t k = 0; k < n; k++) t->attrs[off + k] = t->cur_attr;
-}
-
-static void term_clear_line_to(TermView *t, int to_x) {
-    if (!t || !t->cells || !t->attrs) return;
-    if (to_x < 0) return;
-    if (to_x >= t->cols) to_x = t->cols - 1;
-    size_t off = (size_t)t->cy * (size_t)t->cols;
-    size_t n = (size_t)(to_x + 1);
-    memset(t->cells + off, ' ', n);
-    for (size_t k = 0; k < n; k++) t->attrs[off + k] = t->cur_attr;
-}
-
-static void term_clear_screen_from(TermView *t) {
-    if (!t || !t->cells || !t->attrs) return;
-    term_clear_line_from(t, t->cx);
-    for (int r = t->cy + 1; r < t->rows; r++) {
-        memset(t->cells + (size_t)r * (size_t)t->cols, ' ', (size_t)t->cols);
-        for (int c = 0; c < t->cols; c++) t->attrs[(size_t)r * (size_t)t->cols + (size_t)c] = t->cur_attr;
-    }
-}
-
-static void term_clear_screen_to(TermView *t) {
-    if (!t || !t->cells || !t->attrs) return;
-    for (int r = 0; r < t->cy; r++) {
-        memset(t->cells + (size_t)r * (size_t)t->cols, ' ', (size_t)t->cols);
-        for (int c = 0; c < t->cols; c++) t->attrs[(size_t)r * (size_t)t->cols + (size_t)c] = t->cur_attr;
-    }
-    term_clear_line_to(t, t->cx);
-}
-
-static int term_rgb_to_ansi8(int r, int g, int b) {
-    /* 近似映射到 8 色：0 black,1 red,2 green,3 yellow,4 blue,5 magenta,6 cyan,7 white */
-    if (r < 0) r = 0;
-    if (r > 255) r = 255;
-    if (g < 0) g = 0;
-    if (g > 255) g = 255;
-    if (b < 0) b = 0;
-    if (b > 255) b = 255;
-
-    int maxc = r; if (g > maxc) maxc = g; if (b > maxc) maxc = b;
-    int minc = r; if (g < minc) minc = g; if (b < minc) minc = b;
-    int avg  = (r + g + b) / 3;
-
-    if (maxc < 60) return 0;                 /* 很暗：黑 */
-    if (minc > 210) return 7;                /* 很亮：白 */
-    if ((maxc - minc) < 20) return (avg > 140) ? 7 : 0; /* 近灰 */
-
-    bool rh = (r > 160), gh = (g > 160), bh = (b > 160);
-    if (rh && gh && bh) return 7;
-    if (rh && gh && !bh) return 3;
-    if (rh && !gh && bh) return 5;
-    if (!rh && gh && bh) return 6;
-    if (rh && !gh && !bh) return 1;
-    if (!rh && gh && !bh) return 2;
-    if (!rh && !gh && bh) return 4;
-
-    /* fallback: 选最大通道 */
-    if (r >= g && r >= b) return 1;
-    if (g >= r && g >= b) return 2;
-    return 4;
-}
-
-static int term_xterm256_to_ansi8(int n) {
-    if (n < 0) return 7;
-    if (n < 8) return n;
-    if (n < 16) return n - 8; /* bright -> 近似为基础色 */
-    if (n >= 232 && n <= 255) {
-        int level = 8 + (n - 232) * 10; /* 8..238 */
-        return (level > 128) ? 7 : 0;
-    }
-    if (n >= 16 && n <= 231) {
-        int x = n - 16;
-        int rr = x / 36;
-        int gg = (x % 36) / 6;
-        int bb = x % 6;
-        int r = rr * 51;
-        int g = gg * 51;
-        int b = bb * 51;
-        return term_rgb_to_ansi8(r, g, b);
-    }
-    return 7;
-}
-
-static void term_apply_sgr(TermView *t, int code) {
-    if (!t) return;
-
-    /* reset */
-    if (code == 0) { t->cur_attr = 0; return; }
-
-    /* basic attrs */
-    switch (code) {
-        case 1:  t->cur_attr |= TVA_BOLD; break;
-        case 2:  t->cur_attr |= TVA_DIM; break;
-        case 4:  t->cur_attr |= TVA_UNDERLINE; break;
-        case 7:  t->cur_attr |= TVA_REVERSE; break;
-        case 22: t->cur_attr &= (uint16_t)~(TVA_BOLD | TVA_DIM); break;
-        case 24: t->cur_attr &= (uint16_t)~TVA_UNDERLINE; break;
-        case 27: t->cur_attr &= (uint16_t)~TVA_REVERSE; break;
-        default: break;
-    }
+static void hot_outq_free(HotOutQ *q) {
+    if (!q) return;
+    free(q->buf);
+    memset(q, 0, sizeof(*q));
+}
 
-    /* 8-color fg/bg */
-    if (code >= 30 && code <= 37) {
-        int idx = code - 30;
-        TVA_FG_SET(t->cur_attr, idx + 1);
+/* Write as much as the pty accepts right now. */
+static void hot_flush_out(HotSession *s) {
+    if (!s) return;
+    HotOutQ *q = &s->out;
+    while (q->off < q->len) {
+        if (s->master_fd < 0) { q->off = q->len = 0; return; }
+        ssize_t n = write(s->master_fd, q->buf + q->off, q->len - q->off);
+        if (n > 0) { q->off += (size_t)n; continue; }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        /* EIO etc.: child side is gone, nobody will read it */
+        q->off = q->len = 0;
         return;
     }
-    if (code == 39) { TVA_FG_SET(t->cur_attr, 0); return; }
+    q->off = q->len = 0;
+}
 
-    if (code >= 40 && code <= 47) {
-        int idx = code - 40;
-        TVA_BG_SET(t->cur_attr, idx + 1);
-        return;
-    }
-    if (code == 49) { TVA_BG_SET(t->cur_attr, 0); return; }
+/* =========================
+ *  Frame pacing
+ *  - 按键转发后，子进程回显一到就立即绘制（fzy 输入不再有 100ms 延迟）
+ *  - 大量输出时合并为帧，最多 max_fps 帧/秒
+ *  - 记录每帧绘制耗时，保证绘制占用不超过 HOT_DRAW_BUDGET_PCT 的时间
+ * ========================= */
+#define HOT_DEFAULT_FPS      30
+#define HOT_DRAW_BUDGET_PCT  25
+#define HOT_IDLE_WAIT_MS     250 /* upper bound between child-exit checks */
+#define HOT_FF_FRAME_US      250000
+#define HOT_MAX_SESSIONS     16
+#define HOT_DEFAULT_SESSIONS 4
+#define HOT_DEFAULT_SESSION_MB 64
+#define HOT_DEFAULT_PTY_POOL   2
+#define HOT_DEFAULT_SCROLLBACK_KB 4096
+#define HOT_DEFAULT_SYNC_MS  150
+#define HOT_PICK_THREADS_MAX 16
+#define HOT_DEFAULT_INDEX_THREADS 4
+#define HOT_DEFAULT_DWELL_MS 150
+#define HOT_DEFAULT_CPU_MS 500
+#define HOT_DEFAULT_PREFETCH 2
+#define HOT_DEFAULT_PREFETCH_MB 64
+#define HOT_DEFAULT_PREFETCH_TTL 60
+
+uint64_t hot_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)(ts.tv_nsec / 1000u);
+}
 
-    /* bright fg/bg：近似映射到基础色，并加粗模拟“亮” */
-    if (code >= 90 && code <= 97) {
-        int idx = code - 90;
-        TVA_FG_SET(t->cur_attr, idx + 1);
-        t->cur_attr |= TVA_BOLD;
-        return;
-    }
-    if (code >= 100 && code <= 107) {
-        int idx = code - 100;
-        TVA_BG_SET(t->cur_attr, idx + 1);
-        return;
-    }
+static void hot_pacer_init(HotPacer *pc) {
+    memset(pc, 0, sizeof(*pc));
+    pc->max_fps = env_int("PERFTUI_HOT_FPS", HOT_DEFAULT_FPS, 1, 240);
+    pc->frame_us = 1000000u / (uint64_t)pc->max_fps;
+    pc->sync_timeout_us = (uint64_t)env_int("PERFTUI_HOT_SYNC_MS", HOT_DEFAULT_SYNC_MS, 1, 1000) * 1000u;
 }
 
-static void term_handle_csi(TermView *t, const char *seq, int len) {
-    if (!t || !seq || len <= 0) return;
-    char final = seq[len - 1];
-    int end = len - 1;
-
-    bool priv = false;
-    int i = 0;
-    if (seq[0] == '?') { priv = true; i = 1; }
-
-    if (final != 'm') t->wrap_pending = false;
-
-    if (final == 'm') {
-        /* SGR: 支持多参数 + 颜色（30/40/90/100 + 38;5;n / 48;5;n / 38;2;r;g;b） */
-        if (i >= end) { term_apply_sgr(t, 0); return; } /* "m" */
-        while (i <= end) {
-            int v = csi_get_int(seq, &i, end);
-            if (v < 0) v = 0; /* ";m" or empty -> 0 */
-
-            if (v == 38 || v == 48) {
-                bool is_fg = (v == 38);
-                if (i < end && seq[i] == ';') i++;
-                int mode = csi_get_int(seq, &i, end);
-                if (mode < 0) mode = 0;
-
-                if (mode == 5) {
-                    if (i < end && seq[i] == ';') i++;
-                    int ncol = csi_get_int(seq, &i, end);
-                    if (ncol < 0) ncol = 0;
-                    int idx = term_xterm256_to_ansi8(ncol);
-                    if (is_fg) TVA_FG_SET(t->cur_attr, idx + 1);
-                    else       TVA_BG_SET(t->cur_attr, idx + 1);
-                } else if (mode == 2) {
-                    if (i < end && seq[i] == ';') i++;
-                    int r = csi_get_int(seq, &i, end);
-                    if (r < 0) r = 0;
-                    if (i < end && seq[i] == ';') i++;
-                    int g = csi_get_int(seq, &i, end);
-                    if (g < 0) g = 0;
-                    if (i < end && seq[i] == ';') i++;
-                    int b = csi_get_int(seq, &i, end);
-                    if (b < 0) b = 0;
-                    int idx = term_rgb_to_ansi8(r, g, b);
-                    if (is_fg) TVA_FG_SET(t->cur_attr, idx + 1);
-                    else       TVA_BG_SET(t->cur_attr, idx + 1);
-                } else {
-                    /* 未支持的扩展色模式：忽略 */
-                }
-            } else {
-                term_apply_sgr(t, v);
-            }
+static void hot_pacer_reset(HotPacer *pc) {
+    pc->key_sent_us = 0;
+    pc->echo_ready = false;
+    pc->dirty = false;
+    pc->sync_held = false;
+}
 
-            if (i < end && seq[i] == ';') { i++; continue; }
-            break;
-        }
-        return;
-    }
+static uint64_t hot_pacer_interval(const HotPopup *p) {
+    const HotPacer *pc = &p->pace;
+    uint64_t iv = pc->frame_us;
+    uint64_t budget = pc->draw_cost_us * 100u / HOT_DRAW_BUDGET_PCT;
+    if (budget > iv) iv = budget;
+    /* fast-forward: intermediate frames are only a progress indicator */
+    if (p->sess.ff_active && iv < HOT_FF_FRAME_US) iv = HOT_FF_FRAME_US;
+    return iv;
+}
 
-    int p1 = csi_get_int(seq, &i, end);
-    int p2 = -1;
-    if (i < end && seq[i] == ';') { i++; p2 = csi_get_int(seq, &i, end); }
-
-    if (p1 < 0) p1 = 0;
-    if (p2 < 0) p2 = 0;
-
-    switch (final) {
-        case 'H':
-        case 'f': {
-            int row = (p1 == 0) ? 1 : p1;
-            int col = (p2 == 0) ? 1 : p2;
-            t->cy = row - 1;
-            t->cx = col - 1;
-            if (t->cy < 0) t->cy = 0;
-            if (t->cx < 0) t->cx = 0;
-            if (t->cy >= t->rows) t->cy = t->rows - 1;
-            if (t->cx >= t->cols) t->cx = t->cols - 1;
-            break;
-        }
-        case 'A': { int n = (p1 == 0) ? 1 : p1; t->cy -= n; if (t->cy < 0) t->cy = 0; break; }
-        case 'B': { int n = (p1 == 0) ? 1 : p1; t->cy += n; if (t->cy >= t->rows) t->cy = t->rows - 1; break; }
-        case 'C': { int n = (p1 == 0) ? 1 : p1; t->cx += n; if (t->cx >= t->cols) t->cx = t->cols - 1; break; }
-        case 'D': { int n = (p1 == 0) ? 1 : p1; t->cx -= n; if (t->cx < 0) t->cx = 0; break; }
-        case 'G': { int col = (p1 == 0) ? 1 : p1; t->cx = col - 1; if (t->cx < 0) t->cx = 0; if (t->cx >= t->cols) t->cx = t->cols - 1; break; }
-        case 'd': { int row = (p1 == 0) ? 1 : p1; t->cy = row - 1; if (t->cy < 0) t->cy = 0; if (t->cy >= t->rows) t->cy = t->rows - 1; break; }
-        case 'J': {
-            int n = p1;
-            /* ED: do NOT reset modes/state (ncurses relies on this). */
-            if (n == 2) term_erase_all_keep_modes(t);
-            else if (n == 0) term_clear_screen_from(t);
-            else if (n == 1) term_clear_screen_to(t);
-            break;
-        }
-        case 'K': {
-            int n = p1;
-            /* EL: do NOT move cursor. */
-            if (n == 2) { term_clear_line_from(t, 0); }
-            else if (n == 0) term_clear_line_from(t, t->cx);
-            else if (n == 1) term_clear_line_to(t, t->cx);
-            break;
-        }
-        case 'r': {
-            /* DECSTBM: set scrolling region (top/bottom, inclusive). */
-            int top = (p1 == 0) ? 1 : p1;
-            int bot = (p2 == 0) ? t->rows : p2;
-            if (top < 1) top = 1;
-            if (bot < 1) bot = 1;
-            if (top > t->rows) top = t->rows;
-            if (bot > t->rows) bot = t->rows;
-            if (top >= bot) {
-                t->scroll_top = 0;
-                t->scroll_bottom = t->rows - 1;
-            } else {
-                t->scroll_top = top - 1;
-                t->scroll_bottom = bot - 1;
-            }
-            /* xterm/vt100 moves cursor to home after setting margins */
-            t->cx = 0;
-            t->cy = 0;
-            break;
-        }
-        case 'L': {
-            int n = (p1 == 0) ? 1 : p1;
-            term_insert_lines(t, n);
-            break;
-        }
-        case 'M': {
-            int n = (p1 == 0) ? 1 : p1;
-            term_delete_lines(t, n);
-            break;
-        }
-        case '@': {
-            int n = (p1 == 0) ? 1 : p1;
-            term_insert_chars(t, n);
-            break;
-        }
-        case 'P': {
-            int n = (p1 == 0) ? 1 : p1;
-            term_delete_chars(t, n);
-            break;
-        }
-        case 'X': {
-            int n = (p1 == 0) ? 1 : p1;
-            term_erase_chars(t, n);
-            break;
-        }
-        case 'S': {
-            int n = (p1 == 0) ? 1 : p1;
-            int top, bottom;
-            term_get_region(t, &top, &bottom);
-            term_scroll_up_region(t, top, bottom, n);
-            break;
-        }
-        case 'T': {
-            int n = (p1 == 0) ? 1 : p1;
-            int top, bottom;
-            term_get_region(t, &top, &bottom);
-            term_scroll_down_region(t, top, bottom, n);
-            break;
-        }
-        case 'E': { /* CNL */
-            int n = (p1 == 0) ? 1 : p1;
-            t->cy += n;
-            if (t->cy >= t->rows) t->cy = t->rows - 1;
-            t->cx = 0;
-            break;
-        }
-        case 'F': { /* CPL */
-            int n = (p1 == 0) ? 1 : p1;
-            t->cy -= n;
-            if (t->cy < 0) t->cy = 0;
-            t->cx = 0;
-            break;
-        }
-        case 's': t->saved_cx = t->cx; t->saved_cy = t->cy; break;
-        case 'u': t->cx = t->saved_cx; t->cy = t->saved_cy; break;
-        case 'h':
-        case 'l':
-            if (priv) {
-                /* DECCKM: application cursor keys */
-                if (p1 == 1) {
-                    t->app_cursor = (final == 'h');
-                }
-                /* alt screen: 清空屏幕，但保持模式（DECCKM/keypad） */
-                if (p1 == 1049 || p1 == 47) term_clear_screenbuf_keep_modes(t);
-            }
-            break;
-        default: break;
+/* Called whenever child output has been fed into the TermView. */
+static void hot_pacer_output(HotPacer *pc) {
+    pc->dirty = true;
+    if (pc->key_sent_us) {
+        uint64_t now = hot_now_us();
+        pc->echo_lat_us = now - pc->key_sent_us;
+        pc->echo_avg_us = pc->echo_avg_us ? (pc->echo_avg_us * 7u + pc->echo_lat_us) / 8u
+                                          : pc->echo_lat_us;
+        pc->key_sent_us = 0;
+        pc->echo_ready = true;
     }
 }
 
-static void term_feed(TermView *t, const unsigned char *buf, int n) {
-    if (!t || !buf || n <= 0) return;
-    for (int k = 0; k < n; k++) {
-        unsigned char ch = buf[k];
+/* The child has a synchronized frame open (mode 2026) that has not timed
+ * out: what is on the TermView now is half a frame. */
+static bool hot_sync_hold(const HotPopup *p, uint64_t now_us) {
+    uint64_t since = p->sess.sync_since_us;
+    return since && now_us - since < p->pace.sync_timeout_us;
+}
 
-        /* OSC: ESC ] ... (BEL or ESC \) */
-        if (t->esc_state == 3) {
-            if (ch == 0x07) { t->esc_state = 0; t->osc_esc_seen = false; continue; }
-            if (t->osc_esc_seen && ch == '\\') { t->esc_state = 0; t->osc_esc_seen = false; continue; }
-            t->osc_esc_seen = (ch == 0x1b);
-            continue;
-        }
+bool hot_frame_due(HotPopup *p, uint64_t now_us) {
+    if (!p || !p->active) return false;
+    if (p->mode != HOT_TERM) return true;
+    HotPacer *pc = &p->pace;
+    if (!pc->dirty) return false;
+    if (hot_sync_hold(p, now_us)) return false;
+    if (pc->echo_ready) return true;
+    return now_us - pc->last_draw_us >= hot_pacer_interval(p);
+}
 
-        if (t->esc_state == 0) {
-            if (ch == 0x1b) { t->esc_state = 1; t->esc_len = 0; continue; }
-            /* VT100: shift out/in (switch GL between G1/G0) */
-            if (ch == 0x0e) { t->use_g1 = true; continue; }  /* SO */
-            if (ch == 0x0f) { t->use_g1 = false; continue; } /* SI */
-            if (ch == '\r') { t->cx = 0; t->wrap_pending = false; continue; }
-            if (ch == '\n') { term_lf(t); continue; }
-            if (ch == '\b') { t->wrap_pending = false; if (t->cx > 0) t->cx--; continue; }
-            if (ch == '\t') {
-                t->wrap_pending = false;
-                int next = ((t->cx / 8) + 1) * 8;
-                if (next >= t->cols) next = t->cols - 1;
-                t->cx = next;
-                continue;
-            }
-            if (ch == 0x07) { continue; }
-            if (ch < 0x20) { continue; }
-            term_put_ch(t, (char)ch);
-            continue;
-        }
+void hot_frame_done(HotPopup *p, uint64_t start_us, uint64_t end_us) {
+    if (!p) return;
+    HotPacer *pc = &p->pace;
+    uint64_t cost = end_us - start_us;
+    pc->draw_cost_us = pc->draw_cost_us ? (pc->draw_cost_us * 7u + cost) / 8u : cost;
+    pc->last_draw_us = end_us;
+    /* a frame the child was still building stays pending */
+    pc->dirty = pc->sync_held;
+    pc->sync_held = false;
+    pc->echo_ready = false;
+}
 
-        if (t->esc_state == 1) {
-            if (ch == '[') { t->esc_state = 2; t->esc_len = 0; continue; }
-            if (ch == ']') { t->esc_state = 3; t->osc_esc_seen = false; continue; }
-            if (ch == '(' || ch == ')') { t->esc_state = 4; t->esc_buf[0] = (char)ch; continue; }
-            if (ch == 'c') { term_clear_all(t); t->wrap_pending = false; t->esc_state = 0; continue; }
-            if (ch == '7') { t->wrap_pending = false; t->saved_cx = t->cx; t->saved_cy = t->cy; t->esc_state = 0; continue; }
-            if (ch == '8') { t->wrap_pending = false; t->cx = t->saved_cx; t->cy = t->saved_cy; t->esc_state = 0; continue; }
-            /* common single-char escapes used by ncurses apps */
-            if (ch == 'D') { /* IND */ term_lf(t); t->esc_state = 0; continue; }
-            if (ch == 'M') { /* RI */  term_ri(t); t->esc_state = 0; continue; }
-            if (ch == 'E') { /* NEL */ t->cx = 0; term_lf(t); t->esc_state = 0; continue; }
-            if (ch == '=') { /* keypad application mode */ t->app_keypad = true; t->esc_state = 0; continue; }
-            if (ch == '>') { /* keypad numeric mode */      t->app_keypad = false; t->esc_state = 0; continue; }
-            t->esc_state = 0;
-            continue;
-        }
+/* =========================
+ *  Child reaper
+ *  结束子进程时不再原地等待它退出（以前每次关闭最多阻塞 500ms，
+ *  快速移动光标时会连续卡顿）：发 SIGTERM 后登记在这里，
+ *  由 hot_bg_pump 非阻塞回收；超过 HOT_REAP_KILL_US 仍未退出则对整个进程组发 SIGKILL。
+ * ========================= */
+#define HOT_REAP_MAX      64
+#define HOT_REAP_KILL_US  1000000
+
+static struct {
+    pid_t    pid;
+    uint64_t since_us;
+    bool     killed;
+} hot_reap[HOT_REAP_MAX];
+static int hot_reap_n;
+
+static void hot_reap_add(pid_t pid) {
+    int st = 0;
+    if (pid <= 0 || waitpid(pid, &st, WNOHANG) != 0) return;
+    if (hot_reap_n == HOT_REAP_MAX) {
+        /* table full: finish this one the old way */
+        kill(-pid, SIGKILL);
+        waitpid(pid, &st, 0);
+        return;
+    }
+    hot_reap[hot_reap_n].pid = pid;
+    hot_reap[hot_reap_n].since_us = hot_now_us();
+    hot_reap[hot_reap_n].killed = false;
+    hot_reap_n++;
+}
 
-        if (t->esc_state == 4) {
-            /* ESC ( X  /  ESC ) X : designate G0/G1 charset */
-            uint8_t *dst = (t->esc_buf[0] == '(') ? &t->g0_charset : &t->g1_charset;
-            if (ch == '0') *dst = 1;       /* line drawing */
-            else if (ch == 'B') *dst = 0;  /* US ASCII */
-            else if (ch == 'U') *dst = 0;  /* (often) UK -> treat as ASCII */
-            else if (ch == 'K') *dst = 0;  /* (often) German -> ASCII */
-            t->esc_state = 0;
+static void hot_reap_poll(void) {
+    uint64_t now = hot_now_us();
+    for (int i = 0; i < hot_reap_n; ) {
+        int st = 0;
+        if (waitpid(hot_reap[i].pid, &st, WNOHANG) != 0) {
+            hot_reap[i] = hot_reap[--hot_reap_n];
             continue;
         }
-
-        if (t->esc_state == 2) {
-            if (t->esc_len < (int)sizeof(t->esc_buf) - 1) t->esc_buf[t->esc_len++] = (char)ch;
-            if (ch >= '@' && ch <= '~') {
-                t->esc_buf[t->esc_len] = 0;
-                term_handle_csi(t, t->esc_buf, t->esc_len);
-                t->esc_state = 0;
-                t->esc_len = 0;
-            }
-            continue;
+        if (!hot_reap[i].killed && now - hot_reap[i].since_us >= HOT_REAP_KILL_US) {
+            kill(-hot_reap[i].pid, SIGKILL);
+            hot_reap[i].killed = true;
         }
+        i++;
     }
 }
 
-static short term_pair_ids[16][16];
-static short term_next_pair_id = 10; /* 1..3 已被 UI 使用 */
+/* Program exit: give the children a moment, then kill what is left. */
+static void hot_reap_flush(void) {
+    for (int t = 0; t < 50 && hot_reap_n > 0; t++) {
+        hot_reap_poll();
+        if (hot_reap_n) sleep_ms(10);
+    }
+    for (int i = 0; i < hot_reap_n; i++) {
+        int st = 0;
+        kill(-hot_reap[i].pid, SIGKILL);
+        waitpid(hot_reap[i].pid, &st, 0);
+    }
+    hot_reap_n = 0;
+}
 
-static short term_get_pair_id(int fg, int bg) {
-    /* fg/bg: 0=default, 1..8=ansi8+1 */
-    if (!has_colors()) return 0;
-    if (fg < 0) fg = 0;
-    if (fg > 15) fg = 15;
-    if (bg < 0) bg = 0;
-    if (bg > 15) bg = 15;
+/* How long the main loop may sleep before the next frame or exit check. */
+int hot_wait_ms(HotPopup *p, uint64_t now_us) {
+    if (p && p->active && p->mode == HOT_PICK && p->pick) {
+        const HotPick *k = p->pick;
+        if (k->query_dirty || pick_pending(&k->set)) return 0;
+        if (!k->dirty) return k->pid > 0 ? HOT_IDLE_WAIT_MS : -1;
+        uint64_t since = now_us - k->last_draw_us;
+        if (k->urgent || k->fd < 0 || since >= p->pace.frame_us) return 0;
+        return (int)((p->pace.frame_us - since + 999u) / 1000u);
+    }
+    if (p && p->active && p->mode == HOT_CPU && p->cpu) {
+        const HotCpu *k = p->cpu;
+        if (k->dirty || now_us >= k->next_sample_us) return 0;
+        return (int)((k->next_sample_us - now_us + 999u) / 1000u);
+    }
+    if (!p || !p->active || p->mode != HOT_TERM) return -1;
+    HotPacer *pc = &p->pace;
+    if (!pc->dirty) return HOT_IDLE_WAIT_MS;
+    if (hot_sync_hold(p, now_us)) {
+        /* the frame end arrives as output and wakes us; this is the timeout */
+        uint64_t left = p->sess.sync_since_us + pc->sync_timeout_us - now_us;
+        return (int)((left + 999u) / 1000u);
+    }
+    if (pc->echo_ready) return 0;
+    uint64_t iv = hot_pacer_interval(p);
+    uint64_t since = now_us - pc->last_draw_us;
+    if (since >= iv) return 0;
+    return (int)((iv - since + 999u) / 1000u);
+}
 
-    if (fg == 0 && bg == 0) return 0;
-    short pid = term_pair_ids[fg][bg];
-    if (pid != 0) return pid;
+/* Sleep until a key arrives on in_fd, a child (attached or background)
+ * writes, or timeout_ms passes. */
+void hot_wait(HotPopup *p, int in_fd, int timeout_ms) {
+    /* keys typed since the last wait go out as one write */
+    if (p) hot_flush_out(&p->sess);
+
+    /* keyboard, attached pty, selection pipe, picker producer; then each
+     * index, prefetch and parked session at most its own maximum */
+    struct pollfd pfd[4 + HOT_INDEX_MAX * IDX_FDS_MAX + HOT_PREFETCH_MAX + HOT_MAX_SESSIONS];
+    int n = 0;
+    pfd[n].fd = in_fd; pfd[n].events = POLLIN; pfd[n].revents = 0; n++;
+    if (p && p->sess.master_fd >= 0) {
+        pfd[n].fd = p->sess.master_fd;
+        pfd[n].events = POLLIN;
+        if (hot_outq_pending(&p->sess.out)) pfd[n].events |= POLLOUT;
+        pfd[n].revents = 0;
+        n++;
+    }
+    if (p && p->sess.sel_fd >= 0) {
+        pfd[n].fd = p->sess.sel_fd;
+        pfd[n].events = POLLIN;
+        pfd[n].revents = 0;
+        n++;
+    }
+    if (p && p->pick && p->pick->fd >= 0) {
+        pfd[n].fd = p->pick->fd;
+        pfd[n].events = POLLIN;
+        pfd[n].revents = 0;
+        n++;
+    }
+    for (int i = 0; p && i < p->idx_n; i++) {
+        int fds[IDX_FDS_MAX];
+        int k = idx_fds(p->idx[i], fds);
+        for (int j = 0; j < k; j++) {
+            pfd[n].fd = fds[j];
+            pfd[n].events = POLLIN;
+            pfd[n].revents = 0;
+            n++;
+        }
+    }
+    for (int i = 0; p && i < p->pf_n; i++) {
+        if (p->pf[i].fd < 0) continue;
+        pfd[n].fd = p->pf[i].fd;
+        pfd[n].events = POLLIN;
+        pfd[n].revents = 0;
+        n++;
+    }
+    for (int i = 0; p && i < p->bg_n && n < (int)(sizeof(pfd) / sizeof(pfd[0])); i++) {
+        pfd[n].fd = p->bg[i].master_fd;
+        pfd[n].events = POLLIN;
+        pfd[n].revents = 0;
+        n++;
+    }
 
-    if (term_next_pair_id >= COLOR_PAIRS) return 0;
-    short c_fg = (fg == 0) ? -1 : (short)(fg - 1);
-    short c_bg = (bg == 0) ? -1 : (short)(bg - 1);
-    init_pair(term_next_pair_id, c_fg, c_bg);
-    pid = term_next_pair_id++;
-    term_pair_ids[fg][bg] = pid;
-    return pid;
+    /* exiting children are reaped from hot_bg_pump */
+    if (hot_reap_n > 0 && (timeout_ms < 0 || timeout_ms > HOT_IDLE_WAIT_MS)) timeout_ms = HOT_IDLE_WAIT_MS;
+    int r = poll(pfd, (nfds_t)n, timeout_ms);
+    if (r <= 0 || n == 1) return;
+    if (p->sess.master_fd >= 0 && (pfd[1].revents & POLLOUT)) hot_flush_out(&p->sess);
+    /* A hung-up pty (child gone, not yet reaped) stays "ready" forever;
+     * if that is all poll() reported, wait on the keyboard only so we do
+     * not spin. */
+    bool any_in = false;
+    for (int i = 0; i < n; i++) if (pfd[i].revents & (POLLIN | POLLOUT)) any_in = true;
+    if (!any_in) {
+        poll(pfd, 1, timeout_ms < 0 || timeout_ms > HOT_IDLE_WAIT_MS ? HOT_IDLE_WAIT_MS : timeout_ms);
+    }
 }
 
-static attr_t term_attr_to_curses(uint16_t a) {
-    attr_t r = 0;
+static void hot_session_reset(HotSession *s) {
+    memset(s, 0, sizeof(*s));
+    s->master_fd = -1;
+    s->sel_fd = -1;
+    s->pid = -1;
+    s->progress = -1;
+}
 
-    int fg = TVA_FG_GET(a);
-    int bg = TVA_BG_GET(a);
-    short pid = term_get_pair_id(fg, bg);
-    if (pid) r |= COLOR_PAIR(pid);
+void hot_init(HotPopup *p) {
+    memset(p, 0, sizeof(*p));
+    hot_session_reset(&p->sess);
+    hot_pacer_init(&p->pace);
+    p->bg_max = env_int("PERFTUI_HOT_SESSIONS", HOT_DEFAULT_SESSIONS, 0, HOT_MAX_SESSIONS);
+    p->bg_budget = (size_t)env_int("PERFTUI_HOT_SESSION_MB", HOT_DEFAULT_SESSION_MB, 1, 4096) * 1024u * 1024u;
+    p->spawn_login = env_int("PERFTUI_HOT_LOGIN", 1, 0, 1) != 0;
+    p->pty_pool_want = env_int("PERFTUI_HOT_PTY_POOL", HOT_DEFAULT_PTY_POOL, 0, HOT_PTY_POOL_MAX);
+    p->sb_cap = (size_t)env_int("PERFTUI_HOT_SCROLLBACK_KB", HOT_DEFAULT_SCROLLBACK_KB, 0, 1024 * 1024) * 1024u;
+    p->sb_hit = -1;
+    /* rows are sent as UTF-8: only in a UTF-8 locale */
+    p->pt_enabled = env_int("PERFTUI_HOT_PASSTHROUGH", 1, 0, 1) != 0 && MB_CUR_MAX > 1 && hot_pt_init();
+    p->pick_enabled = env_int("PERFTUI_HOT_PICKER", 1, 0, 1) != 0;
+    p->pick_threads = env_int("PERFTUI_HOT_PICK_THREADS", 0, 0, HOT_PICK_THREADS_MAX);
+    p->cpu_sample_ms = env_int("PERFTUI_HOT_CPU_MS", HOT_DEFAULT_CPU_MS, 100, 10000);
+    p->dwell_ms = env_int("PERFTUI_HOT_DWELL_MS", HOT_DEFAULT_DWELL_MS, 0, 5000);
+    p->pf_jobs = env_int("PERFTUI_HOT_PREFETCH", HOT_DEFAULT_PREFETCH, 0, HOT_PREFETCH_MAX);
+    p->pf_max_bytes = (size_t)env_int("PERFTUI_HOT_PREFETCH_MB", HOT_DEFAULT_PREFETCH_MB, 1, 4096) * 1024u * 1024u;
+    p->pf_ttl_us = (uint64_t)env_int("PERFTUI_HOT_PREFETCH_TTL_S", HOT_DEFAULT_PREFETCH_TTL, 0, 86400) * 1000000u;
+    p->idx_enabled = env_int("PERFTUI_HOT_INDEX", 1, 0, 1) != 0;
+    p->idx_threads = env_int("PERFTUI_HOT_INDEX_THREADS", HOT_DEFAULT_INDEX_THREADS, 1, 16);
+    const char *xd = getenv("PERFTUI_HOT_INDEX_DIR");
+    const char *cache = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xd) snprintf(p->idx_dir, sizeof(p->idx_dir), "%s", xd);
+    else if (cache && cache[0]) snprintf(p->idx_dir, sizeof(p->idx_dir), "%s/perftui", cache);
+    else if (home && home[0]) snprintf(p->idx_dir, sizeof(p->idx_dir), "%s/.cache/perftui", home);
+    p->cg_lim.cpu_pct = env_int("PERFTUI_HOT_LIMIT_CPU", 0, 0, 100 * CPU_MAX);
+    p->cg_lim.mem_mb = env_int("PERFTUI_HOT_LIMIT_MEM_MB", 0, 0, 1 << 24);
+    const char *lc = getenv("PERFTUI_HOT_LIMIT_CPUS");
+    if (lc) snprintf(p->cg_lim.cpus, sizeof(p->cg_lim.cpus), "%s", lc);
+    /* groups only when a limit is set, or their stats are asked for */
+    bool limited = p->cg_lim.cpu_pct > 0 || p->cg_lim.mem_mb > 0 || p->cg_lim.cpus[0];
+    if (env_int("PERFTUI_HOT_CGROUP", limited, 0, 1)) cg_root_init(&p->cg);
+    const char *rd = getenv("PERFTUI_HOT_RECORD");
+    if (rd) snprintf(p->rec_dir, sizeof(p->rec_dir), "%s", rd);
+}
 
-    if (a & TVA_REVERSE)   r |= A_REVERSE;
-    if (a & TVA_BOLD)      r |= A_BOLD;
-    if (a & TVA_UNDERLINE) r |= A_UNDERLINE;
-#ifdef A_DIM
-    if (a & TVA_DIM)       r |= A_DIM;
-#endif
-    return r;
+/* =========================
+ *  Session recorder
+ *  设置 PERFTUI_HOT_RECORD=<目录> 后，每个热区会话的输出连同单调时间戳、
+ *  窗口尺寸变化写入 <目录>/hot-<时间>-<pid>.ptrec（格式见 mterm_core.h）：
+ *  - 记录先追加到 1MB 缓冲区，满了才 write 一次，hot_pump 不做小 IO
+ *  - 会话结束时写出剩余部分
+ *  - mterm_bench 可按原速或最快速度回放
+ * ========================= */
+#define HOT_REC_BUF (1024 * 1024)
+
+static void hot_rec_write(int fd, const void *data, size_t n) {
+    const unsigned char *b = (const unsigned char*)data;
+    size_t off = 0;
+    while (off < n) {
+        ssize_t w = write(fd, b + off, n - off);
+        if (w > 0) { off += (size_t)w; continue; }
+        if (w < 0 && errno == EINTR) continue;
+        return; /* disk full etc.: drop the rest, never stall the UI */
+    }
 }
 
-static chtype term_acs_map(unsigned char ch) {
-    switch (ch) {
-        case 'q': return ACS_HLINE;
-        case 'x': return ACS_VLINE;
-        case 'l': return ACS_ULCORNER;
-        case 'k': return ACS_URCORNER;
-        case 'm': return ACS_LLCORNER;
-        case 'j': return ACS_LRCORNER;
-        case 't': return ACS_LTEE;
-        case 'u': return ACS_RTEE;
-        case 'v': return ACS_BTEE;
-        case 'w': return ACS_TTEE;
-        case 'n': return ACS_PLUS;
-        case 'a': return ACS_CKBOARD;
-        case '`': return ACS_DIAMOND;
-        case 'f': return ACS_DEGREE;
-        case 'g': return ACS_PLMINUS;
-        case '~': return ACS_BULLET;
-        default:  return (chtype)ch;
-    }
-}
-
-static void term_draw(WINDOW *win, TermView *t) {
-    if (!win || !t || !t->cells || !t->attrs) return;
-    int H, W;
-    getmaxyx(win, H, W);
-    int rows = (t->rows < H) ? t->rows : H;
-    int cols = (t->cols < W) ? t->cols : W;
+static void hot_rec_flush(HotRec *r) {
+    hot_rec_write(r->fd, r->buf, r->len);
+    r->len = 0;
+}
 
-    for (int r = 0; r < rows; r++) {
-        attr_t prev = (attr_t)~0;
-        int c = 0;
-        while (c < cols) {
-            uint16_t a = t->attrs[(size_t)r * (size_t)t->cols + (size_t)c];
-            int start = c;
-            while (c < cols && t->attrs[(size_t)r * (size_t)t->cols + (size_t)c] == a) c++;
-            attr_t ca = term_attr_to_curses(a);
-            if (ca != prev) { wattrset(win, ca); prev = ca; }
-            if (a & TVA_ACS) {
-                for (int i = start; i < c; i++) {
-                    unsigned char ch = (unsigned char)t->cells[(size_t)r * (size_t)t->cols + (size_t)i];
-                    mvwaddch(win, r, i, term_acs_map(ch));
-                }
-            } else {
-                mvwaddnstr(win, r, start, t->cells + (size_t)r * (size_t)t->cols + (size_t)start, c - start);
-            }
-        }
-        wattrset(win, 0);
-        if (cols < W) for (int cc = cols; cc < W; cc++) mvwaddch(win, r, cc, ' ');
-    }
-    for (int r = rows; r < H; r++) {
-        for (int c = 0; c < W; c++) mvwaddch(win, r, c, ' ');
+static void hot_rec_put(HotRec *r, uint32_t kind, const void *data, size_t n) {
+    TermRecHdr h = { hot_now_us() - r->t0_us, kind, (uint32_t)n };
+    if (r->len + sizeof(h) + n > r->cap) hot_rec_flush(r);
+    if (sizeof(h) + n > r->cap) {
+        /* larger than the buffer (fast-forward spans): write through */
+        hot_rec_write(r->fd, &h, sizeof(h));
+        hot_rec_write(r->fd, data, n);
+        return;
     }
+    memcpy(r->buf + r->len, &h, sizeof(h));
+    memcpy(r->buf + r->len + sizeof(h), data, n);
+    r->len += sizeof(h) + n;
 }
 
-static int set_nonblock(int fd) {
-    int fl = fcntl(fd, F_GETFL, 0);
-    if (fl < 0) return -1;
-    return fcntl(fd, F_SETFL, fl | O_NONBLOCK);
+static void hot_rec_output(HotSession *s, const unsigned char *buf, size_t n) {
+    if (s->rec && n > 0) hot_rec_put(s->rec, TERM_REC_OUTPUT, buf, n);
 }
 
-static int open_pty_master(void) {
-    int m = posix_openpt(O_RDWR | O_NOCTTY);
-    if (m < 0) return -1;
-    if (grantpt(m) != 0) { close(m); return -1; }
-    if (unlockpt(m) != 0) { close(m); return -1; }
-    return m;
+static void hot_rec_resize(HotSession *s, int rows, int cols) {
+    if (!s->rec) return;
+    uint32_t sz[2] = { (uint32_t)rows, (uint32_t)cols };
+    hot_rec_put(s->rec, TERM_REC_RESIZE, sz, sizeof(sz));
 }
 
-void hot_init(HotPopup *p) {
-    memset(p, 0, sizeof(*p));
-    p->master_fd = -1;
+static void hot_rec_start(HotPopup *p, HotSession *s) {
+    if (!p->rec_dir[0]) return;
+    char path[512], stamp[32];
+    time_t now = time(NULL);
+    struct tm tmv;
+    localtime_r(&now, &tmv);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tmv);
+    snprintf(path, sizeof(path), "%s/hot-%s-%d.ptrec", p->rec_dir, stamp, (int)s->pid);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+
+    HotRec *r = (HotRec*)calloc(1, sizeof(HotRec));
+    if (!r) { perror("calloc"); exit(1); }
+    r->buf = (unsigned char*)malloc(HOT_REC_BUF);
+    if (!r->buf) { perror("malloc"); exit(1); }
+    r->cap = HOT_REC_BUF;
+    r->fd = fd;
+    r->t0_us = s->spawn_us ? s->spawn_us : hot_now_us();
+
+    TermRecFileHdr fh;
+    memset(&fh, 0, sizeof(fh));
+    memcpy(fh.magic, TERM_REC_MAGIC, sizeof(fh.magic));
+    fh.rows = (uint32_t)s->term.rows;
+    fh.cols = (uint32_t)s->term.cols;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    fh.start_unix_us = (uint64_t)ts.tv_sec * 1000000u + (uint64_t)(ts.tv_nsec / 1000);
+    fh.cmd_len = (uint32_t)strlen(s->cmd);
+    memcpy(r->buf, &fh, sizeof(fh));
+    memcpy(r->buf + sizeof(fh), s->cmd, fh.cmd_len);
+    r->len = sizeof(fh) + fh.cmd_len;
+    s->rec = r;
+}
+
+static void hot_rec_stop(HotSession *s) {
+    HotRec *r = s->rec;
+    if (!r) return;
+    hot_rec_flush(r);
+    close(r->fd);
+    free(r->buf);
+    free(r);
+    s->rec = NULL;
+}
+
+/* Terminate the child and release everything the session owns. */
+static void hot_session_kill(HotSession *s) {
+    if (!s) return;
+    if (s->running && s->pid > 0) {
+        kill(s->pid, SIGTERM);
+        hot_reap_add(s->pid);
+    }
+    if (s->master_fd >= 0) close(s->master_fd);
+    if (s->sel_fd >= 0) close(s->sel_fd);
+    free(s->sel);
+    term_free(&s->term);
+    hot_outq_free(&s->out);
+    free(s->ff_ring.buf);
+    hot_rec_stop(s);
+    hot_session_reset(s);
 }
 
+static void hot_pick_stop(HotPopup *p);
+static void hot_cpu_stop(HotPopup *p);
+
 static void hot_kill_child(HotPopup *p) {
     if (!p) return;
-    if (p->running && p->pid > 0) {
-        kill(p->pid, SIGTERM);
-        int st = 0;
-        for (int i = 0; i < 50; i++) {
-            pid_t r = waitpid(p->pid, &st, WNOHANG);
-            if (r == p->pid) break;
-            sleep_ms(10);
-        }
-        waitpid(p->pid, &st, WNOHANG);
-    }
-    p->running = false;
-    p->pid = -1;
-    if (p->master_fd >= 0) { close(p->master_fd); p->master_fd = -1; }
-    term_free(&p->term);
-    p->raw_len = 0;
+    hot_session_kill(&p->sess);
+    hot_pick_stop(p);
+    hot_cpu_stop(p);
+    p->sb_viewing = p->sb_prompt = false;
+    p->sb_hit = -1;
+    free(p->paste); p->paste = NULL;
+    p->paste_len = p->paste_cap = 0;
+    p->pasting = false;
+    hot_pacer_reset(&p->pace);
 }
 
 void hot_close(HotPopup *p) {
     if (!p) return;
     hot_kill_child(p);
+    hot_pt_sync(p);
     if (p->wi) { delwin(p->wi); p->wi = NULL; }
     if (p->wb) { delwin(p->wb); p->wb = NULL; }
     p->active = false;
+    p->drawn = false;
     p->mode = HOT_INPUT;
     p->owner = NULL;
     p->y = p->x = p->h = p->w = 0;
@@ -978,6 +1010,7 @@ bool hot_set_geom(HotPopup *p, int y, int x, int h, int w) {
         if (p->wb) { delwin(p->wb); p->wb = NULL; }
         p->wb = newwin(h, w, y, x);
         p->wi = derwin(p->wb, h - 2, w - 2, 1, 1);
+        p->drawn = false;
     } else {
         mvwin(p->wb, y, x);
         wresize(p->wb, h, w);
@@ -986,194 +1019,1508 @@ bool hot_set_geom(HotPopup *p, int y, int x, int h, int w) {
     if (p->mode == HOT_TERM) {
         int ih, iw;
         getmaxyx(p->wi, ih, iw);
-        int oldr = p->term.rows;
-        int oldc = p->term.cols;
-        term_resize(&p->term, ih, iw);
+        int oldr = p->sess.term.rows;
+        int oldc = p->sess.term.cols;
+        term_resize(&p->sess.term, ih, iw);
         bool resized = (ih != oldr || iw != oldc);
         /* When the viewport changes, clear local screen buffer so the next
          * redraw from ncurses apps (e.g. htop) does not mix with stale cells.
          * Keep terminal modes (DECCKM/keypad) intact for correct key mapping. */
         if (resized) {
-            term_clear_screenbuf_keep_modes(&p->term);
+            term_clear_screenbuf_keep_modes(&p->sess.term);
         }
-        if (resized && p->master_fd >= 0 && p->pid > 0) {
+        if (resized && p->sess.master_fd >= 0 && p->sess.pid > 0) {
             struct winsize wsz;
             memset(&wsz, 0, sizeof(wsz));
             wsz.ws_row = (unsigned short)ih;
             wsz.ws_col = (unsigned short)iw;
-            ioctl(p->master_fd, TIOCSWINSZ, &wsz);
-            kill(p->pid, SIGWINCH);
+            ioctl(p->sess.master_fd, TIOCSWINSZ, &wsz);
+            kill(p->sess.pid, SIGWINCH);
+            hot_rec_resize(&p->sess, ih, iw);
         }
     }
     return geom_changed;
 }
 
-static void hot_raw_append(HotPopup *p, const unsigned char *buf, int n) {
-    if (!p || !buf || n <= 0) return;
-    const int cap = (int)sizeof(p->raw_tail);
-    if (n >= cap) {
-        memcpy(p->raw_tail, buf + (n - cap), (size_t)cap);
-        p->raw_len = cap;
-        return;
-    }
-    if (p->raw_len + n > cap) {
-        int keep = cap / 2;
-        if (keep < 1024) keep = 1024;
-        if (p->raw_len > keep) {
-            memmove(p->raw_tail, p->raw_tail + (p->raw_len - keep), (size_t)keep);
-            p->raw_len = keep;
-        }
-    }
-    int can = cap - p->raw_len;
-    if (n > can) n = can;
-    memcpy(p->raw_tail + p->raw_len, buf, (size_t)n);
-    p->raw_len += n;
-}
-
 static bool hot_cmd_is_fzy(const char *cmd) {
     return (cmd && strstr(cmd, "fzy") != NULL);
 }
 
-static void strip_ansi_to_plain(const unsigned char *in, int n, char *out, size_t cap) {
-    if (!out || cap == 0) return;
-    out[0] = 0;
-    if (!in || n <= 0) return;
-
-    size_t w = 0;
-    int st = 0; /* 0 normal, 1 ESC, 2 CSI, 3 OSC, 4 ESC_CHARSET(skip 1) */
-    bool osc_esc = false;
-
-    for (int i = 0; i < n; i++) {
-        unsigned char ch = in[i];
-
-        if (st == 3) { /* OSC */
-            if (ch == 0x07) { st = 0; osc_esc = false; continue; }
-            if (osc_esc && ch == '\\') { st = 0; osc_esc = false; continue; }
-            osc_esc = (ch == 0x1b);
-            continue;
-        }
-
-        if (st == 2) { /* CSI */
-            if (ch >= '@' && ch <= '~') { st = 0; }
-            continue;
+/* =========================
+ *  Selection channel
+ *  fzy 的界面画在 /dev/tty（即 pty），选中结果写到 stdout：
+ *  - 对 picker 命令，子进程的 stdout 接到单独的管道，pty 只承载界面
+ *  - 管道随 pty 一起读（不让选中结果多时把子进程写阻塞），读到 EOF 即关闭
+ *  - 子进程退出后，管道里的全部内容（多选时为多行）原样作为结果，
+ *    不再从 pty 输出里猜最后一行
+ *  - 经 shell 运行时管道放在 fd HOT_SEL_FD，命令改写成
+ *    "{ 前段\n} 3>&- | fzy ... >&3 3>&-"：只有 fzy 的 stdout 进管道，
+ *    login profile 和前段命令的输出仍在 pty 上
+ * ========================= */
+#define HOT_SEL_MAX (1024 * 1024)
+#define HOT_SEL_FD  3
+
+static void hot_sel_read(HotSession *s) {
+    while (s->sel_fd >= 0) {
+        if (s->sel_cap - s->sel_len < 4096 && s->sel_cap < HOT_SEL_MAX) {
+            size_t nc = s->sel_cap ? s->sel_cap * 2 : 4096;
+            char *nb = (char*)realloc(s->sel, nc);
+            if (!nb) { perror("realloc"); exit(1); }
+            s->sel = nb;
+            s->sel_cap = nc;
         }
-
-        if (st == 4) { st = 0; continue; }
-
-        if (st == 1) { /* ESC */
-            if (ch == '[') { st = 2; continue; }
-            if (ch == ']') { st = 3; osc_esc = false; continue; }
-            if (ch == '(' || ch == ')') { st = 4; continue; } /* ESC ( B / ESC ) 0 */
-            st = 0;
+        char scratch[4096];
+        char  *dst = s->sel + s->sel_len;
+        size_t room = s->sel_cap - s->sel_len;
+        if (room == 0) { dst = scratch; room = sizeof(scratch); } /* over HOT_SEL_MAX: drain only */
+        ssize_t n = read(s->sel_fd, dst, room);
+        if (n > 0) {
+            if (dst != scratch) s->sel_len += (size_t)n;
             continue;
         }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        close(s->sel_fd); /* EOF: every writer is gone */
+        s->sel_fd = -1;
+    }
+}
 
-        if (ch == 0x1b) { st = 1; continue; }
-        if (ch == '\r') ch = '\n';
+/* The picker's result without the trailing newline(s); NULL if it printed nothing. */
+static char *hot_sel_take(HotSession *s) {
+    hot_sel_read(s);
+    size_t n = s->sel_len;
+    while (n > 0 && (s->sel[n-1] == '\n' || s->sel[n-1] == '\r')) n--;
+    if (n == 0) return NULL;
+    char *v = strndup(s->sel, n);
+    if (!v) { perror("strndup"); exit(1); }
+    return v;
+}
 
-        if ((ch == '\n') || (ch >= 0x20 && ch != 0x7f)) {
-            if (w + 1 < cap) out[w++] = (char)ch;
+/* First (or with last, the last) character of s that is in set and outside
+ * quotes and backslash escapes; NULL if none. *open is set when a quote is
+ * left unterminated. */
+static const char *hot_sh_find(const char *s, const char *set, bool last, bool *open) {
+    const char *hit = NULL;
+    char q = 0;
+    for (const char *c = s; *c; c++) {
+        if (q) {
+            if (*c == q) q = 0;
+            else if (q == '"' && *c == '\\' && c[1]) c++;
+        } else if (*c == '\\' && c[1]) c++;
+        else if (*c == '\'' || *c == '"') q = *c;
+        else if (strchr(set, *c)) {
+            hit = c;
+            if (!last) break;
         }
     }
-    out[w] = 0;
+    *open = q != 0;
+    return hit;
 }
 
-static bool last_nonempty_line(const char *plain, char *out, size_t cap) {
-    if (!out || cap == 0) return false;
-    out[0] = 0;
-    if (!plain) return false;
-
-    size_t n = strlen(plain);
-    if (n == 0) return false;
-
-    /* 从尾部找最后一个非空行 */
-    size_t i = n;
-    while (i > 0 && (plain[i-1] == '\n' || plain[i-1] == ' ' || plain[i-1] == '\t')) i--;
-    if (i == 0) return false;
-
-    size_t end = i;
-    while (i > 0 && plain[i-1] != '\n') i--;
-    size_t start = i;
-
-    /* trim */
-    while (start < end && (plain[start] == ' ' || plain[start] == '\t')) start++;
-    while (end > start && (plain[end-1] == ' ' || plain[end-1] == '\t')) end--;
+/* Rewrite "<producer> | [path/]fzy [args]" so that only fzy writes to fd
+ * HOT_SEL_FD. The fzy stage must be the whole final simple command: after
+ * it there is no ";", "&", "&&", "||", subshell, backquote or comment for
+ * the appended ">&3" to bind to instead. False otherwise (or if out is too
+ * small); the caller then gives the whole shell the pipe as stdout. */
+static bool hot_sel_wrap(const char *cmd, char *out, size_t cap) {
+    bool open;
+    const char *bar = hot_sh_find(cmd, "|", true, &open);
+    if (!bar || open || bar == cmd || bar[-1] == '|') return false; /* none, unterminated, or "||" */
+    const char *seg = bar + 1;
+    if (hot_sh_find(seg, ";&()`#\n", false, &open)) return false;
+    while (*seg == ' ' || *seg == '\t') seg++;
+    size_t w = strcspn(seg, " \t");
+    if (w < 3 || strncmp(seg + w - 3, "fzy", 3) != 0 || (w > 3 && seg[w - 4] != '/')) return false;
+    int n = snprintf(out, cap, "{ %.*s\n} %d>&- | %s >&%d %d>&-",
+                     (int)(bar - cmd), cmd, HOT_SEL_FD, seg, HOT_SEL_FD, HOT_SEL_FD);
+    return n > 0 && (size_t)n < cap;
+}
 
-    size_t len = end - start;
-    if (len == 0) return false;
-    if (len >= cap) len = cap - 1;
-    memcpy(out, plain + start, len);
-    out[len] = 0;
+/* =========================
+ *  Spawn service
+ *  光标每落到 autorun 节点都要付一次启动延迟，尽量压低：
+ *  - pty 预先打开放在池里（PERFTUI_HOT_PTY_POOL），用掉后在空闲时补齐
+ *  - posix_spawn：glibc 下是 vfork 式 clone，不复制 ncurses 进程的页表
+ *  - PERFTUI_HOT_LOGIN=0：不走 login shell（不重复 source profile）；
+ *    无 shell 元字符的简单命令直接 exec，PATH 解析结果缓存
+ *  - 启动到首字节的延迟显示在标题栏
+ * ========================= */
+#define HOT_EXEC_CACHE        16
+#define HOT_MAX_ARGV          32
+
+static struct {
+    char name[64];
+    char path[256];
+} hot_exec_cache[HOT_EXEC_CACHE];
+static int hot_exec_cache_n;
+
+static int hot_pty_take(HotPopup *p) {
+    if (p->pty_pool_n > 0) return p->pty_pool[--p->pty_pool_n];
+    return open_pty_master();
+}
 
-    /* 去掉可能的前缀 "> " */
-    if (out[0] == '>' && out[1] == ' ') {
-        memmove(out, out + 2, strlen(out + 2) + 1);
+/* Top up the pty pool; called from the main loop, off the spawn path. */
+static void hot_pty_refill(HotPopup *p) {
+    while (p->pty_pool_n < p->pty_pool_want) {
+        int m = open_pty_master();
+        if (m < 0) { p->pty_pool_want = p->pty_pool_n; return; }
+        p->pty_pool[p->pty_pool_n++] = m;
     }
-    return out[0] != 0;
 }
 
-static bool hot_spawn(HotPopup *p, const char *cmd) {
-    if (!p || !cmd || !*cmd) return false;
+/* Split a command that needs no shell (only words, no quotes, globs,
+ * pipes, redirects or variables) into argv in place; false otherwise. */
+static bool hot_cmd_split(char *buf, char **argv, int max) {
+    for (const char *c = buf; *c; c++) {
+        unsigned char ch = (unsigned char)*c;
+        if (isalnum(ch) || ch >= 0x80 || strchr(" \t_-./,:=+@%", ch)) continue;
+        return false;
+    }
+    int n = 0;
+    char *save = NULL;
+    for (char *w = strtok_r(buf, " \t", &save); w; w = strtok_r(NULL, " \t", &save)) {
+        if (n + 1 >= max) return false;
+        argv[n++] = w;
+    }
+    argv[n] = NULL;
+    /* VAR=value prefixes are shell syntax */
+    return n > 0 && !strchr(argv[0], '=');
+}
+
+/* Resolve a program name through PATH, caching the result. */
+static const char *hot_exec_resolve(const char *name) {
+    if (strchr(name, '/')) return access(name, X_OK) == 0 ? name : NULL;
+    if (strlen(name) >= sizeof(hot_exec_cache[0].name)) return NULL;
+    for (int i = 0; i < hot_exec_cache_n; i++) {
+        if (strcmp(hot_exec_cache[i].name, name) != 0) continue;
+        if (access(hot_exec_cache[i].path, X_OK) == 0) return hot_exec_cache[i].path;
+        /* stale entry: drop it and search again */
+        hot_exec_cache[i] = hot_exec_cache[--hot_exec_cache_n];
+        break;
+    }
+    const char *path = getenv("PATH");
+    if (!path || !*path) path = "/usr/local/bin:/usr/bin:/bin";
+    char cand[256];
+    while (*path) {
+        const char *e = strchr(path, ':');
+        size_t dl = e ? (size_t)(e - path) : strlen(path);
+        int len = snprintf(cand, sizeof(cand), "%.*s/%s", (int)dl, dl ? path : ".", name);
+        if (len > 0 && (size_t)len < sizeof(cand) && access(cand, X_OK) == 0) {
+            int slot = hot_exec_cache_n < HOT_EXEC_CACHE ? hot_exec_cache_n++ : HOT_EXEC_CACHE - 1;
+            snprintf(hot_exec_cache[slot].name, sizeof(hot_exec_cache[slot].name), "%s", name);
+            snprintf(hot_exec_cache[slot].path, sizeof(hot_exec_cache[slot].path), "%s", cand);
+            return hot_exec_cache[slot].path;
+        }
+        if (!e) break;
+        path = e + 1;
+    }
+    return NULL;
+}
+
+/* environ with TERM/COLUMNS/LINES replaced; strings live in vars[]. */
+static char **hot_child_env(char vars[3][32], int ih, int iw) {
+    size_t n = 0;
+    while (environ && environ[n]) n++;
+    char **env = (char**)malloc((n + 4) * sizeof(char*));
+    if (!env) { perror("malloc"); exit(1); }
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!strncmp(environ[i], "TERM=", 5) || !strncmp(environ[i], "COLUMNS=", 8) ||
+            !strncmp(environ[i], "LINES=", 6)) continue;
+        env[k++] = environ[i];
+    }
+    snprintf(vars[0], 32, "TERM=xterm-256color");
+    snprintf(vars[1], 32, "COLUMNS=%d", iw);
+    snprintf(vars[2], 32, "LINES=%d", ih);
+    for (int i = 0; i < 3; i++) env[k++] = vars[i];
+    env[k] = NULL;
+    return env;
+}
+
+/* =========================
+ *  Resource limits
+ *  perftui 所在的 cgroup v2 被委派时（mcg.c），每条热区命令和选择器的生成命令
+ *  都放进自己的临时子组 "hot-<pid>-<序号>"：
+ *  - PERFTUI_HOT_LIMIT_CPU：cpu.max，单个 CPU 的百分比（150 = 1.5 个 CPU，0 = 不限）
+ *  - PERFTUI_HOT_LIMIT_MEM_MB：memory.max（0 = 不限）
+ *  - PERFTUI_HOT_LIMIT_CPUS：cpuset.cpus，cpulist（如 2-7）
+ *  - 弹窗标题显示该组的 cpu.stat usage_usec 与 memory.peak
+ *  子进程由一个 sh 包装先把自己写进组的 cgroup.procs 再 exec 命令，之后 fork 出的
+ *  进程全部在组内（posix_spawn 不能直接指定 cgroup）。命令结束后组被删除，
+ *  残留进程超过 HOT_CG_KILL_US 用 cgroup.kill 结束。
+ *  加入组失败时包装报错退出（126），命令不会在没有限制的情况下运行。
+ *  未被委派（或对应控制器不可用、限制值写不进组）时：内存改用 RLIMIT_DATA
+ *  （包装里 ulimit -d，软硬限制一起设，设不上同样报错退出 126），
+ *  CPU 集合改用 sched_setaffinity（只改发起 spawn 的线程，子进程继承后再恢复）；
+ *  cpu.max 没有对应的 rlimit，不生效。
+ *  只在设置了上面某个限制时才用 cgroup、才经过包装，否则照常直接启动；
+ *  PERFTUI_HOT_CGROUP=1 不设限制也建组（只为标题里的统计），=0 一律不用 cgroup。
+ * ========================= */
+#define HOT_CG_MAX      (HOT_MAX_SESSIONS + HOT_PREFETCH_MAX + 8)
+#define HOT_CG_READ_US  1000000   /* stats in the title are refreshed this often */
+#define HOT_CG_GC_US    500000
+#define HOT_CG_KILL_US  2000000
+
+static struct {
+    pid_t    pid;        /* the command in g, -1 = not started yet */
+    CgGroup  g;
+    uint64_t read_us;    /* last cg_read */
+    uint64_t gone_us;    /* the command exited, 0 = running */
+    bool     joined;     /* the group was seen populated */
+} hot_cg[HOT_CG_MAX];
+static int hot_cg_n;
+static uint64_t hot_cg_gc_us;
+
+/* $1: cgroup.procs to join ("" = none), $2: RLIMIT_DATA in KB ("" = none,
+ * set as soft and hard limit so the command cannot raise it again).
+ * Not joining the group or not getting the rlimit means running without
+ * the limit: refuse. */
+static const char hot_limit_sh[] =
+    "if [ -n \"$1\" ] && ! echo 0 2>/dev/null >\"$1\"; then "
+    "echo \"perftui: cannot join ${1%/*}, not started\" >&2; exit 126; fi; "
+    "if [ -n \"$2\" ] && ! ulimit -d \"$2\" 2>/dev/null; then "
+    "echo \"perftui: cannot limit data to $2 KB, not started\" >&2; exit 126; fi; "
+    "shift 2; exec \"$@\"";
+
+typedef struct {
+    int       slot;        /* hot_cg entry, -1 = none */
+    char      procs[640];
+    char      data_kb[24];
+    bool      affinity;    /* this thread's affinity was narrowed; saved holds the old one */
+    cpu_set_t saved;
+    char     *argv[HOT_MAX_ARGV + 8];
+} HotLimit;
+
+/* Before posix_spawn: a group for the command (or the rlimit / affinity
+ * fallback); *exe and *argv go through the wrapper when it is needed. */
+static void hot_limit_begin(HotPopup *p, HotLimit *l, const char **exe, char ***argv) {
+    l->slot = -1;
+    l->procs[0] = l->data_kb[0] = 0;
+    l->affinity = false;
+    const CgLimits *lim = &p->cg_lim;
+    if (p->cg.base[0] && hot_cg_n < HOT_CG_MAX) {
+        int i = hot_cg_n;
+        if (cg_create(&p->cg, &hot_cg[i].g, lim)) {
+            hot_cg[i].pid = -1;
+            hot_cg[i].read_us = hot_cg[i].gone_us = 0;
+            hot_cg[i].joined = false;
+            hot_cg_n++;
+            l->slot = i;
+            snprintf(l->procs, sizeof(l->procs), "%s/cgroup.procs", hot_cg[i].g.path);
+        }
+    }
+    bool in_cg = l->slot >= 0;
+    if (lim->mem_mb > 0 && !(in_cg && p->cg.memory))
+        snprintf(l->data_kb, sizeof(l->data_kb), "%lld", (long long)lim->mem_mb * 1024);
+    if (lim->cpus[0] && !(in_cg && p->cg.cpuset)) {
+        bool *set = (bool*)malloc(CPU_MAX * sizeof(bool));
+        if (!set) { perror("malloc"); exit(1); }
+        if (cpulist_parse(lim->cpus, set) > 0 && sched_getaffinity(0, sizeof(l->saved), &l->saved) == 0) {
+            cpu_set_t cs;
+            CPU_ZERO(&cs);
+            for (int c = 0; c < CPU_MAX && c < CPU_SETSIZE; c++) if (set[c]) CPU_SET(c, &cs);
+            l->affinity = sched_setaffinity(0, sizeof(cs), &cs) == 0;
+        }
+        free(set);
+    }
+    if (!l->procs[0] && !l->data_kb[0]) return;
+
+    int n = 0;
+    l->argv[n++] = "sh";
+    l->argv[n++] = "-c";
+    l->argv[n++] = (char*)hot_limit_sh;
+    l->argv[n++] = "perftui-limit";
+    l->argv[n++] = l->procs;
+    l->argv[n++] = l->data_kb;
+    l->argv[n++] = (char*)*exe;
+    for (int i = 1; (*argv)[i] && n < HOT_MAX_ARGV + 7; i++) l->argv[n++] = (*argv)[i];
+    l->argv[n] = NULL;
+    *exe = "/bin/sh";
+    *argv = l->argv;
+}
+
+/* After posix_spawn: the group belongs to pid, or goes again if it failed. */
+static void hot_limit_end(HotLimit *l, pid_t pid, bool ok) {
+    if (l->affinity) sched_setaffinity(0, sizeof(l->saved), &l->saved);
+    if (l->slot < 0) return;
+    if (ok) {
+        hot_cg[l->slot].pid = pid;
+        return;
+    }
+    cg_remove(&hot_cg[l->slot].g, true);
+    hot_cg[l->slot] = hot_cg[--hot_cg_n];
+}
+
+/* Remove the groups of exited commands; kill what is left after HOT_CG_KILL_US. */
+static void hot_cg_poll(bool now_all) {
+    uint64_t now = hot_now_us();
+    if (!now_all && now - hot_cg_gc_us < HOT_CG_GC_US) return;
+    hot_cg_gc_us = now;
+    for (int i = 0; i < hot_cg_n; ) {
+        /* empty once the command has joined it, or the command is gone */
+        int pop = cg_populated(&hot_cg[i].g);
+        if (pop == 1) hot_cg[i].joined = true;
+        if (!hot_cg[i].gone_us && (now_all || (pop == 0 && hot_cg[i].joined) || kill(hot_cg[i].pid, 0) != 0))
+            hot_cg[i].gone_us = now;
+        if (hot_cg[i].gone_us &&
+            cg_remove(&hot_cg[i].g, now_all || now - hot_cg[i].gone_us >= HOT_CG_KILL_US)) {
+            hot_cg[i] = hot_cg[--hot_cg_n];
+            continue;
+        }
+        i++;
+    }
+}
+
+/* Program exit: kill everything still in a group and remove the groups. */
+static void hot_cg_flush(void) {
+    for (int t = 0; t < 50 && hot_cg_n > 0; t++) {
+        hot_cg_poll(true);
+        if (hot_cg_n) sleep_ms(10);
+    }
+}
+
+static int hot_cg_find(pid_t pid) {
+    for (int i = 0; pid > 0 && i < hot_cg_n; i++) if (hot_cg[i].pid == pid) return i;
+    return -1;
+}
+
+/* The title shows stats older than HOT_CG_READ_US. */
+static bool hot_cg_due(pid_t pid) {
+    int i = hot_cg_find(pid);
+    return i >= 0 && hot_now_us() - hot_cg[i].read_us >= HOT_CG_READ_US;
+}
+
+/* "cpu 1.23s  peak 45.6M" for pid's group, "" if it has none. */
+static void hot_cg_label(pid_t pid, char *out, size_t cap) {
+    out[0] = 0;
+    int i = hot_cg_find(pid);
+    if (i < 0) return;
+    uint64_t now = hot_now_us();
+    if (now - hot_cg[i].read_us >= HOT_CG_READ_US) {
+        cg_read(&hot_cg[i].g);
+        hot_cg[i].read_us = now;
+    }
+    const CgGroup *g = &hot_cg[i].g;
+    int n = snprintf(out, cap, "cpu %.2fs", (double)g->cpu_usec / 1e6);
+    if (g->mem_peak && n > 0 && (size_t)n < cap)
+        snprintf(out + n, cap - (size_t)n, "  peak %.1fM", (double)g->mem_peak / (1024.0 * 1024.0));
+}
+
+/* Append "  label " to a " ... " title. */
+static void hot_title_cg(char *title, size_t cap, pid_t pid) {
+    char lb[64];
+    hot_cg_label(pid, lb, sizeof(lb));
+    size_t n = strlen(title);
+    if (!lb[0] || n == 0) return;
+    snprintf(title + n - 1, cap - n + 1, "  %s ", lb);
+}
+
+static bool hot_spawn(HotPopup *p, const char *cmd) {
+    if (!p || !cmd || !*cmd) return false;
+    uint64_t t0 = hot_now_us();
 
     int ih, iw;
     getmaxyx(p->wi, ih, iw);
     if (ih < 1) ih = 1;
     if (iw < 1) iw = 1;
 
-    int master = open_pty_master();
+    int master = hot_pty_take(p);
     if (master < 0) return false;
-    char *slave_name = ptsname(master);
-    if (!slave_name) { close(master); return false; }
-
-    int slave = open(slave_name, O_RDWR | O_NOCTTY);
-    if (slave < 0) { close(master); return false; }
+    char slave_name[64];
+    if (ptsname_r(master, slave_name, sizeof(slave_name)) != 0) { close(master); return false; }
 
     struct winsize wsz;
     memset(&wsz, 0, sizeof(wsz));
     wsz.ws_row = (unsigned short)ih;
     wsz.ws_col = (unsigned short)iw;
-    ioctl(slave, TIOCSWINSZ, &wsz);
+    ioctl(master, TIOCSWINSZ, &wsz);
 
-    pid_t pid = fork();
-    if (pid < 0) {
-        close(slave); close(master);
-        return false;
+    /* argv: login shell (default), plain shell, or the program itself */
+    char words[sizeof(p->sess.cmd)];
+    snprintf(words, sizeof(words), "%s", cmd);
+    char *argv[HOT_MAX_ARGV];
+    const char *exe = NULL;
+    bool picker = hot_cmd_is_fzy(cmd);
+    if (!p->spawn_login && hot_cmd_split(words, argv, HOT_MAX_ARGV)) exe = hot_exec_resolve(argv[0]);
+
+    /* picker via the shell: only fzy's stdout goes to the selection pipe
+     * (fd HOT_SEL_FD); if the command cannot be rewritten the shell gets
+     * the pipe as stdout, non-login so no profile output lands in it */
+    char wrapped[sizeof(p->sess.cmd) + 32];
+    bool sel_fd_n = false;
+    if (!exe) {
+        exe = "/bin/sh";
+        argv[0] = "sh";
+        argv[1] = p->spawn_login ? "-lc" : "-c";
+        argv[2] = (char*)cmd;
+        argv[3] = NULL;
+        if (picker && hot_sel_wrap(cmd, wrapped, sizeof(wrapped))) {
+            argv[2] = wrapped;
+            sel_fd_n = true;
+        } else if (picker) {
+            argv[1] = "-c";
+        }
     }
-    if (pid == 0) {
-        setsid();
-        ioctl(slave, TIOCSCTTY, 0);
-        dup2(slave, 0);
-        dup2(slave, 1);
-        dup2(slave, 2);
-        close(slave);
-        close(master);
 
-        setenv("TERM", "xterm-256color", 1);
-        char buf[32];
-        snprintf(buf, sizeof(buf), "%d", iw);
-        setenv("COLUMNS", buf, 1);
-        snprintf(buf, sizeof(buf), "%d", ih);
-        setenv("LINES", buf, 1);
-
-        execl("/bin/sh", "sh", "-lc", cmd, (char*)NULL);
-        _exit(127);
+    /* New session; opening the slave as fd 0 makes it the controlling tty.
+     * Signals curses ignores or blocks are reset for the child. */
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_init(&attr);
+    posix_spawn_file_actions_init(&fa);
+    sigset_t sigs;
+    sigfillset(&sigs);
+    posix_spawnattr_setsigdefault(&attr, &sigs);
+    sigemptyset(&sigs);
+    posix_spawnattr_setsigmask(&attr, &sigs);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGDEF |
+                                    POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_USEVFORK);
+    /* picker: fzy's stdout is the selection channel, the UI goes to /dev/tty */
+    int sel[2] = { -1, -1 };
+    if (picker && pipe2(sel, O_CLOEXEC) != 0) { close(master); return false; }
+    posix_spawn_file_actions_addopen(&fa, 0, slave_name, O_RDWR, 0);
+    posix_spawn_file_actions_adddup2(&fa, sel[1] >= 0 && !sel_fd_n ? sel[1] : 0, 1);
+    posix_spawn_file_actions_adddup2(&fa, 0, 2);
+    if (sel_fd_n) posix_spawn_file_actions_adddup2(&fa, sel[1], HOT_SEL_FD);
+
+    char vars[3][32];
+    char **env = hot_child_env(vars, ih, iw);
+    pid_t pid = -1;
+    HotLimit lim;
+    char **av = argv;
+    hot_limit_begin(p, &lim, &exe, &av);
+    int rc = posix_spawn(&pid, exe, &fa, &attr, av, env);
+    hot_limit_end(&lim, pid, rc == 0);
+    free(env);
+    posix_spawn_file_actions_destroy(&fa);
+    posix_spawnattr_destroy(&attr);
+    if (sel[1] >= 0) close(sel[1]);
+    if (rc != 0) {
+        if (sel[0] >= 0) close(sel[0]);
+        close(master);
+        return false;
     }
 
-    close(slave);
     set_nonblock(master);
+    if (sel[0] >= 0) set_nonblock(sel[0]);
 
+    char cmd_copy[sizeof(p->sess.cmd)];
+    snprintf(cmd_copy, sizeof(cmd_copy), "%s", cmd);
     hot_kill_child(p);
-    p->master_fd = master;
-    p->pid = pid;
-    p->running = true;
+    p->sess.owner = p->owner;
+    memcpy(p->sess.cmd, cmd_copy, sizeof(cmd_copy));
+    p->sess.master_fd = master;
+    p->sess.pid = pid;
+    p->sess.running = true;
+    p->sess.spawn_us = t0;
+    p->sess.sel_fd = sel[0];
     p->mode = HOT_TERM;
-    p->raw_len = 0;
+    p->drawn = false;
 
-    term_init(&p->term, ih, iw);
-    term_clear_all(&p->term);
+    term_init(&p->sess.term, ih, iw);
+    term_clear_all(&p->sess.term);
+    if (p->sb_cap) p->sess.term.sb = term_sb_new(p->sb_cap);
+    hot_rec_start(p, &p->sess);
+    return true;
+}
 
-    ioctl(master, TIOCSWINSZ, &wsz);
-    kill(pid, SIGWINCH);
+/* =========================
+ *  Built-in picker
+ *  "<生成命令> | fzy" 与 "fzy < 文件" 不再起 fzy，改用进程内选择器（mpick.c）：
+ *  - 生成命令照常交给 sh 运行，stdout 接管道，边读边把行追加进 PickSet
+ *  - 读入过程中只对新到的行增量过滤，界面按 PERFTUI_HOT_FPS 的帧率刷新
+ *  - 连续按键（快速输入、粘贴）时只在最后一个键之后过滤一次
+ *  - 一次只过滤一小段（mpick.c 的 slice_ns），没做完的下一轮接着做，
+ *    中途有新按键就改做新查询，大候选集上按键不卡
+ *  - 按键同 fzy：Enter 选中，Tab 补全，↑↓/Ctrl+P/N 移动，Esc/Ctrl+X 取消
+ *  - 生成命令是 "find <绝对路径> -type f [-executable]" 时不再运行 find，
+ *    候选直接取自该根目录的持久文件索引（mindex.c，后台扫描 + inotify）；
+ *    Ctrl+T 在 全部 / 可执行 / ELF 之间切换。索引首次扫描完成前仍运行 find。
+ *  PERFTUI_HOT_PICKER=0 时仍在 pty 里运行真正的 fzy；
+ *  PERFTUI_HOT_PICK_THREADS 为过滤线程数（默认 0 = 每个 CPU 一个）；
+ *  PERFTUI_HOT_INDEX=0 关闭文件索引，PERFTUI_HOT_INDEX_THREADS 为扫描线程数，
+ *  索引文件放在 PERFTUI_HOT_INDEX_DIR（默认 ~/.cache/perftui）。
+ * ========================= */
+#define HOT_PICK_READ_MAX    (8 * 1024 * 1024)  /* producer bytes per pump */
+#define HOT_PICK_COALESCE_US 50000              /* longest filter delay while keys keep coming */
+
+static const char hot_pick_meta[] = "'\"\\$`;&|<>(){}*?~#";
+
+/* [s, s+n) is the bare word "fzy" or ".../fzy" (no options, no quoting). */
+static bool hot_pick_is_fzy(const char *s, size_t n) {
+    while (n && isspace((unsigned char)*s)) { s++; n--; }
+    while (n && isspace((unsigned char)s[n - 1])) n--;
+    const char *base = s;
+    for (size_t i = 0; i < n; i++) {
+        if (isspace((unsigned char)s[i]) || strchr(hot_pick_meta, s[i])) return false;
+        if (s[i] == '/') base = s + i + 1;
+    }
+    return s + n - base == 3 && memcmp(base, "fzy", 3) == 0;
+}
+
+/* Split "<producer> | fzy" (producer) or "fzy < file" (file). Anything
+ * else, e.g. fzy with options, is left to the real fzy. */
+static bool hot_pick_parse(const char *cmd, char *producer, size_t psz, char *file, size_t fsz) {
+    producer[0] = file[0] = 0;
+    bool open;
+    const char *bar = hot_sh_find(cmd, "|", true, &open);
+    if (open) return false;
+    if (bar) {
+        if (bar > cmd && bar[-1] == '|') return false;   /* "a || fzy" */
+        if (!hot_pick_is_fzy(bar + 1, strlen(bar + 1))) return false;
+        const char *s = cmd, *e = bar;
+        while (s < e && isspace((unsigned char)*s)) s++;
+        while (e > s && isspace((unsigned char)e[-1])) e--;
+        if (s == e || (size_t)(e - s) >= psz) return false;
+        memcpy(producer, s, (size_t)(e - s));
+        producer[e - s] = 0;
+        return true;
+    }
+    const char *lt = hot_sh_find(cmd, "<", false, &open);
+    if (!lt || !hot_pick_is_fzy(cmd, (size_t)(lt - cmd))) return false;
+    const char *s = lt + 1;
+    while (isspace((unsigned char)*s)) s++;
+    size_t n = strlen(s);
+    while (n && isspace((unsigned char)s[n - 1])) n--;
+    if (!n || n >= fsz) return false;
+    for (size_t i = 0; i < n; i++)
+        if (isspace((unsigned char)s[i]) || strchr(hot_pick_meta, s[i])) return false;
+    memcpy(file, s, n);
+    file[n] = 0;
+    return true;
+}
+
+/* "find <root> -type f [-executable]" with an absolute root: the file
+ * index can stand in for it (-executable as "any execute bit"). */
+static bool hot_pick_find_root(const char *producer, char *root, size_t rsz, IdxFilter *filter) {
+    char words[256];
+    char *argv[HOT_MAX_ARGV];
+    snprintf(words, sizeof(words), "%s", producer);
+    if (!hot_cmd_split(words, argv, HOT_MAX_ARGV)) return false;
+    const char *base = strrchr(argv[0], '/');
+    base = base ? base + 1 : argv[0];
+    if (strcmp(base, "find") != 0 || !argv[1] || argv[1][0] != '/') return false;
+    bool type_f = false;
+    *filter = IDX_ALL;
+    for (int i = 2; argv[i]; i++) {
+        if (!strcmp(argv[i], "-type") && argv[i + 1] && !strcmp(argv[i + 1], "f")) { type_f = true; i++; }
+        else if (!strcmp(argv[i], "-executable")) *filter = IDX_ONLY_EXEC;
+        else return false;
+    }
+    if (!type_f) return false;
+    snprintf(root, rsz, "%s", argv[1]);
+    size_t n = strlen(root);
+    while (n > 1 && root[n - 1] == '/') root[--n] = 0;
+    return true;
+}
+
+/* The index of root, opened (and scanned in the background) on first use. */
+static FileIndex *hot_index_get(HotPopup *p, const char *root) {
+    for (int i = 0; i < p->idx_n; i++) {
+        FileIndex *ix = p->idx[i];
+        if (strcmp(ix->root, root) != 0) continue;
+        /* without inotify watches changes are missed: check again */
+        if (ix->live.watch_full) idx_rescan(ix);
+        return ix;
+    }
+    if (p->idx_n == HOT_INDEX_MAX) return NULL;
+    FileIndex *ix = idx_open(root, p->idx_dir, p->idx_threads);
+    p->idx[p->idx_n++] = ix;
+    return ix;
+}
+
+/* Visible match rows (row 0 is the query). */
+static int hot_pick_rows(const HotPopup *p) {
+    int rows = p->wi ? getmaxy(p->wi) - 1 : 1;
+    return rows < 1 ? 1 : rows;
+}
+
+static void hot_pick_stop(HotPopup *p) {
+    HotPick *k = p ? p->pick : NULL;
+    if (!k) return;
+    if (k->fd >= 0) close(k->fd);
+    if (k->pid > 0) {
+        kill(-k->pid, SIGTERM);
+        hot_reap_add(k->pid);
+    }
+    pick_free(&k->set);
+    free(k);
+    p->pick = NULL;
+}
+
+/* (Re)load the candidates from the file index, keeping the query. */
+static void hot_pick_fill(HotPopup *p) {
+    HotPick *k = p->pick;
+    const IdxTable *t = &k->ix->live;
+    int threads = k->set.threads;
+    pick_free(&k->set);
+    pick_init(&k->set, threads);
+    char *buf = NULL;
+    size_t room = 0, used = 0;
+    for (uint32_t i = 0; i < t->n; i++) {
+        if (!idx_pass(&t->ent[i], k->filter)) continue;
+        const char *s = idx_path(t, i);
+        size_t n = strlen(s);
+        if (used + n + 1 > room) {
+            if (used) pick_commit(&k->set, used);
+            buf = pick_space(&k->set, n + 1 > 64 * 1024 ? n + 1 : 64 * 1024, &room);
+            used = 0;
+        }
+        memcpy(buf + used, s, n);
+        buf[used + n] = '\n';
+        used += n + 1;
+    }
+    if (used) pick_commit(&k->set, used);
+    pick_finish(&k->set);
+    k->ix_scans = k->ix->scans;
+    k->sel = k->scroll = 0;
+    if (k->qlen) {
+        k->query_dirty = true;
+        k->typed_us = 0;   /* filter at once */
+    }
+    k->dirty = k->urgent = true;
+}
+
+/* Start producer under sh with stdout on a non-blocking pipe. */
+static bool hot_producer_spawn(HotPopup *p, const char *producer, pid_t *pid, int *fd) {
+    int out[2];
+    if (pipe2(out, O_CLOEXEC) != 0) return false;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_init(&attr);
+    posix_spawn_file_actions_init(&fa);
+    sigset_t sigs;
+    sigfillset(&sigs);
+    posix_spawnattr_setsigdefault(&attr, &sigs);
+    sigemptyset(&sigs);
+    posix_spawnattr_setsigmask(&attr, &sigs);
+    /* own process group, so stopping the picker ends the whole pipeline */
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGDEF |
+                                    POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_USEVFORK);
+    posix_spawn_file_actions_addopen(&fa, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&fa, out[1], 1);
+    posix_spawn_file_actions_addopen(&fa, 2, "/dev/null", O_WRONLY, 0);
+    char *argv[] = { "sh", p->spawn_login ? "-lc" : "-c", (char*)producer, NULL };
+    const char *exe = "/bin/sh";
+    char **av = argv;
+    HotLimit lim;
+    hot_limit_begin(p, &lim, &exe, &av);
+    int rc = posix_spawn(pid, exe, &fa, &attr, av, environ);
+    hot_limit_end(&lim, *pid, rc == 0);
+    posix_spawn_file_actions_destroy(&fa);
+    posix_spawnattr_destroy(&attr);
+    close(out[1]);
+    if (rc != 0) { close(out[0]); return false; }
+    *fd = out[0];
+    set_nonblock(*fd);
+    return true;
+}
+
+/* =========================
+ *  Prefetch
+ *  光标所在列里带 cmd 的 a 类节点，提前在后台运行选择器的生成命令
+ *  （"... | fzy" 的前半段），输出按节点缓存；光标停下时选择器直接用缓存打开，
+ *  生成命令还没跑完就接管它的管道继续读。
+ *  - 同时运行的生成命令不超过 PERFTUI_HOT_PREFETCH 个（默认 2，0 = 关闭）
+ *  - 每个节点的输出不超过 PERFTUI_HOT_PREFETCH_MB，超出则放弃
+ *  - 缓存 PERFTUI_HOT_PREFETCH_TTL_S 秒后过期（默认 60），过期重新生成
+ *  - 离开该列时还在运行的预取被终止；由文件索引提供的 find 只需打开索引
+ * ========================= */
+static int hot_pf_find(const HotPopup *p, const Node *owner, const char *producer) {
+    for (int i = 0; i < p->pf_n; i++)
+        if (p->pf[i].owner == owner && strcmp(p->pf[i].producer, producer) == 0) return i;
+    return -1;
+}
+
+static bool hot_pf_fresh(const HotPopup *p, const HotPrefetch *f, uint64_t now_us) {
+    return !f->done_us || now_us - f->done_us < p->pf_ttl_us;
+}
+
+static void hot_pf_drop(HotPopup *p, int i) {
+    HotPrefetch *f = &p->pf[i];
+    if (f->fd >= 0) close(f->fd);
+    if (f->pid > 0) {
+        kill(-f->pid, SIGTERM);
+        hot_reap_add(f->pid);
+    }
+    free(f->buf);
+    p->pf[i] = p->pf[--p->pf_n];
+}
+
+/* Read what the running producers wrote. */
+static void hot_pf_pump(HotPopup *p) {
+    for (int i = 0; i < p->pf_n; ) {
+        HotPrefetch *f = &p->pf[i];
+        size_t got = 0;
+        bool over = false;
+        while (f->fd >= 0 && got < HOT_PICK_READ_MAX) {
+            if (f->cap - f->len < 64 * 1024) {
+                size_t nc = f->cap ? f->cap * 2 : 256 * 1024;
+                if (nc > p->pf_max_bytes) nc = p->pf_max_bytes;
+                if (nc <= f->cap) { over = true; break; }
+                char *b = (char*)realloc(f->buf, nc);
+                if (!b) { perror("realloc"); exit(1); }
+                f->buf = b;
+                f->cap = nc;
+            }
+            ssize_t r = read(f->fd, f->buf + f->len, f->cap - f->len);
+            if (r > 0) { f->len += (size_t)r; got += (size_t)r; continue; }
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            close(f->fd);
+            f->fd = -1;
+            f->done_us = hot_now_us();
+            hot_reap_add(f->pid);
+            f->pid = -1;
+        }
+        /* too large to keep: the picker runs it itself */
+        if (over) { hot_pf_drop(p, i); continue; }
+        i++;
+    }
+}
+
+void hot_prefetch(HotPopup *p, Node *const *nodes, int n) {
+    if (!p || p->pf_jobs <= 0 || !p->pick_enabled) return;
+    /* prefetches still running for nodes out of view stop */
+    for (int i = 0; i < p->pf_n; ) {
+        bool keep = p->pf[i].done_us != 0;
+        for (int j = 0; !keep && j < n; j++) keep = nodes[j] == p->pf[i].owner;
+        if (!keep) { hot_pf_drop(p, i); continue; }
+        i++;
+    }
+    int running = 0;
+    for (int i = 0; i < p->pf_n; i++) if (!p->pf[i].done_us) running++;
+
+    uint64_t now = hot_now_us();
+    for (int j = 0; j < n && running < p->pf_jobs; j++) {
+        Node *nd = nodes[j];
+        if (!nd || !nd->cmd || !nd->cmd[0]) continue;
+        /* the open picker already runs it */
+        if (p->active && p->owner == nd && p->mode != HOT_INPUT) continue;
+        char producer[sizeof(p->input)], file[sizeof(p->input)], root[256];
+        IdxFilter filter;
+        if (!hot_pick_parse(nd->cmd, producer, sizeof(producer), file, sizeof(file)) || !producer[0]) continue;
+        if (p->idx_enabled && hot_pick_find_root(producer, root, sizeof(root), &filter)) {
+            hot_index_get(p, root);
+            continue;
+        }
+        int i = hot_pf_find(p, nd, producer);
+        if (i >= 0 && hot_pf_fresh(p, &p->pf[i], now)) continue;
+        if (i >= 0) hot_pf_drop(p, i);
+        if (p->pf_n == HOT_PREFETCH_MAX) {
+            /* evict the least recently used finished entry */
+            int lru = -1;
+            for (int k = 0; k < p->pf_n; k++)
+                if (p->pf[k].done_us && (lru < 0 || p->pf[k].used_us < p->pf[lru].used_us)) lru = k;
+            if (lru < 0) break;
+            hot_pf_drop(p, lru);
+        }
+        pid_t pid;
+        int fd;
+        if (!hot_producer_spawn(p, producer, &pid, &fd)) continue;
+        HotPrefetch *f = &p->pf[p->pf_n++];
+        memset(f, 0, sizeof(*f));
+        f->owner = nd;
+        snprintf(f->producer, sizeof(f->producer), "%s", producer);
+        f->pid = pid;
+        f->fd = fd;
+        f->used_us = now;
+        running++;
+    }
+}
+
+/* Append buf to the candidates. */
+static void hot_pick_feed(PickSet *ps, const char *buf, size_t len) {
+    while (len > 0) {
+        size_t room;
+        size_t n = len < 1024 * 1024 ? len : 1024 * 1024;
+        char *d = pick_space(ps, n, &room);
+        memcpy(d, buf, n);
+        pick_commit(ps, n);
+        buf += n;
+        len -= n;
+    }
+}
+
+/* Run cmd in the built-in picker; false if it is not a plain fzy pipeline
+ * (or the picker is off) and the caller should spawn it in a pty. */
+static bool hot_pick_start(HotPopup *p, const char *cmd) {
+    if (!p->pick_enabled) return false;
+    char producer[sizeof(p->input)], file[sizeof(p->input)];
+    if (!hot_pick_parse(cmd, producer, sizeof(producer), file, sizeof(file))) return false;
+
+    int fd = -1;
+    pid_t pid = -1;
+    FileIndex *ix = NULL;
+    IdxFilter filter = IDX_ALL;
+    char root[256];
+    int pf = -1;
+    if (producer[0] && p->idx_enabled && hot_pick_find_root(producer, root, sizeof(root), &filter)) {
+        ix = hot_index_get(p, root);
+        /* nothing scanned yet: run find this time */
+        if (ix && !ix->loaded) ix = NULL;
+    }
+    if (!ix && producer[0]) {
+        pf = hot_pf_find(p, p->owner, producer);
+        if (pf >= 0 && !hot_pf_fresh(p, &p->pf[pf], hot_now_us())) { hot_pf_drop(p, pf); pf = -1; }
+    }
+    if (ix || pf >= 0) {
+        /* candidates from the index or the prefetched output */
+    } else if (file[0]) {
+        /* missing file: the shell reports it in the pty */
+        fd = open(file, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+    } else if (!hot_producer_spawn(p, producer, &pid, &fd)) {
+        return false;
+    }
+
+    hot_kill_child(p);
+    HotPick *k = (HotPick*)calloc(1, sizeof(HotPick));
+    if (!k) { perror("calloc"); exit(1); }
+    int threads = p->pick_threads;
+    if (threads <= 0) {
+        long nc = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = nc < 1 ? 1 : nc > HOT_PICK_THREADS_MAX ? HOT_PICK_THREADS_MAX : (int)nc;
+    }
+    pick_init(&k->set, threads);
+    k->pid = pid;
+    k->fd = fd;
+    k->dirty = k->urgent = true;
+    k->ix = ix;
+    k->filter = filter;
+    p->pick = k;
+    p->mode = HOT_PICK;
+    p->drawn = false;
+    if (ix) hot_pick_fill(p);
+    if (pf >= 0) {
+        HotPrefetch *f = &p->pf[pf];
+        hot_pick_feed(&k->set, f->buf, f->len);
+        if (f->done_us) {
+            /* finished: keep it cached for the next visit */
+            pick_finish(&k->set);
+            f->used_us = hot_now_us();
+        } else {
+            /* still running: the picker takes the pipe over */
+            k->fd = f->fd;
+            k->pid = f->pid;
+            f->fd = -1;
+            f->pid = -1;
+            hot_pf_drop(p, pf);
+        }
+    }
+    return true;
+}
+
+/* Apply a typed query now. */
+static void hot_pick_filter(HotPopup *p) {
+    HotPick *k = p->pick;
+    if (!k->query_dirty) return;
+    k->query_dirty = false;
+    pick_query(&k->set, k->query, k->scroll + (uint32_t)hot_pick_rows(p));
+    k->dirty = k->urgent = true;
+}
+
+/* Read the producer and filter; true when a frame should be drawn now. */
+static bool hot_pick_pump(HotPopup *p) {
+    HotPick *k = p->pick;
+    PickSet *ps = &k->set;
+    /* a finished scan replaced the index this list came from */
+    if (k->ix && k->ix->scans != k->ix_scans) hot_pick_fill(p);
+    size_t got = 0;
+    while (k->fd >= 0 && got < HOT_PICK_READ_MAX) {
+        size_t room;
+        char *buf = pick_space(ps, 64 * 1024, &room);
+        ssize_t r = read(k->fd, buf, room);
+        if (r > 0) { pick_commit(ps, (size_t)r); got += (size_t)r; continue; }
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        /* EOF (or a read error): the list is complete */
+        pick_finish(ps);
+        close(k->fd);
+        k->fd = -1;
+        k->dirty = true;
+    }
+    if (k->fd < 0 && k->pid > 0) {
+        hot_reap_add(k->pid);
+        k->pid = -1;
+    }
+
+    if (k->query_dirty) {
+        /* more keys already waiting: filter once after the last of them */
+        struct pollfd in = { .fd = STDIN_FILENO, .events = POLLIN, .revents = 0 };
+        if (poll(&in, 1, 0) > 0 && hot_now_us() - k->typed_us < HOT_PICK_COALESCE_US) return false;
+        hot_pick_filter(p);
+    } else if (pick_pending(ps)) {
+        /* the rest of the query, one slice per pass so keys get through */
+        pick_update(ps, k->scroll + (uint32_t)hot_pick_rows(p));
+        k->dirty = true;
+    }
+
+    if (!k->dirty) return false;
+    if (k->urgent || (k->fd < 0 && !pick_pending(ps))) return true;
+    return hot_now_us() - k->last_draw_us >= p->pace.frame_us;
+}
+
+/* One candidate at row y, clipped to width columns. Characters in fzy's
+ * match are highlighted; the selected row is reversed. */
+static void hot_pick_line(WINDOW *w, int y, int width, const char *s, const char *q, bool selected) {
+    int pos[PICK_QUERY_MAX];
+    int npos = (q[0] && pick_positions(q, s, pos)) ? (int)strlen(q) : 0;
+    attr_t base = selected ? A_REVERSE : A_NORMAL;
+    attr_t mark = A_BOLD;
+    int pair = term_pair_get(COLOR_YELLOW, -1);
+    if (pair > 0) mark |= COLOR_PAIR(pair);
+
+    wmove(w, y, 0);
+    int col = 0, pi = 0;
+    for (int i = 0; s[i]; ) {
+        unsigned char c = (unsigned char)s[i];
+        int len = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        for (int j = 1; j < len; j++) if (!s[i + j]) { len = j; break; }
+        bool ctl = c < 0x20 || c == 0x7f;
+        int cw = ctl ? 1 : term_u8_width(s + i, len);
+        if (col + cw > width) break;
+        bool hit = false;
+        while (pi < npos && pos[pi] < i + len) { if (pos[pi] >= i) hit = true; pi++; }
+        wattrset(w, base | (hit ? mark : 0));
+        if (ctl) waddch(w, '?');
+        else waddnstr(w, s + i, len);
+        col += cw;
+        i += len;
+    }
+    wattrset(w, base);
+    if (selected) for (; col < width; col++) waddch(w, ' ');
+    wattrset(w, A_NORMAL);
+}
+
+static void hot_pick_draw(HotPopup *p) {
+    HotPick *k = p->pick;
+    PickSet *ps = &k->set;
+    hot_pt_sync(p);
+    p->drawn = false;
+
+    int ih, iw;
+    getmaxyx(p->wi, ih, iw);
+    (void)ih;
+    uint32_t rows = (uint32_t)hot_pick_rows(p);
+    uint32_t nm = pick_matches(ps);
+    if (k->sel >= nm) k->sel = nm ? nm - 1 : 0;
+    if (k->sel < k->scroll) k->scroll = k->sel;
+    if (k->sel >= k->scroll + rows) k->scroll = k->sel - rows + 1;
+    pick_top(ps, k->scroll + rows);
+
+    werase(p->wb);
+    box(p->wb, 0, 0);
+    char nb[256];
+    const char *nm_s = p->owner ? node_view_name(p->owner, nb, sizeof(nb)) : "";
+    char title[300];
+    const char *src = !k->ix ? "" : k->filter == IDX_ONLY_EXEC ? "  index:exec" :
+                      k->filter == IDX_ONLY_ELF ? "  index:ELF" : "  index";
+    bool loading = k->fd >= 0 || (k->ix && k->ix->build) || pick_pending(ps);
+    snprintf(title, sizeof(title), " Hot: %s  %u/%u%s  %.1fms%s ", nm_s, nm, ps->n,
+             loading ? "+" : "", (double)ps->filter_ns / 1e6, src);
+    hot_title_cg(title, sizeof(title), k->pid);
+    mvwaddnstr(p->wb, 0, 2, title, p->w - 4);
+
+    werase(p->wi);
+    /* the query's tail when it is wider than the row */
+    int qoff = 0;
+    while (qoff < k->qlen && term_u8_width(k->query + qoff, k->qlen - qoff) > iw - 3) {
+        qoff++;
+        while (qoff < k->qlen && ((unsigned char)k->query[qoff] & 0xC0) == 0x80) qoff++;
+    }
+    mvwaddstr(p->wi, 0, 0, "> ");
+    waddnstr(p->wi, k->query + qoff, k->qlen - qoff);
+    for (uint32_t r = 0; r < rows && k->scroll + r < ps->ntop; r++) {
+        uint32_t i = k->scroll + r;
+        hot_pick_line(p->wi, 1 + (int)r, iw, pick_str(ps, ps->top[i].idx), k->query, i == k->sel);
+    }
+    curs_set(1);
+    wmove(p->wi, 0, 2 + term_u8_width(k->query + qoff, k->qlen - qoff));
+
+    k->dirty = k->urgent = false;
+    k->last_draw_us = hot_now_us();
+    wnoutrefresh(p->wb);
+    wnoutrefresh(p->wi);
+}
+
+/* Leave the picker the way fzy exits: sel (NULL = cancelled, value kept)
+ * becomes the owner's value and the popup does not reopen on this node. */
+static void hot_pick_done(HotPopup *p, const char *sel) {
+    if (sel && p->owner) {
+        char *v = strdup(sel);
+        if (!v) { perror("strdup"); exit(1); }
+        free(p->owner->val);
+        p->owner->val = v;
+        p->owner->val_cap = 0;
+        p->vals_changed = true;
+    }
+    p->closed_by_enter = true;
+    p->last_owner = p->owner;
+    hot_close(p);
+}
+
+static void hot_pick_edited(HotPick *k) {
+    k->query[k->qlen] = 0;
+    if (!k->query_dirty) k->typed_us = hot_now_us();
+    k->query_dirty = true;
+    k->sel = k->scroll = 0;
+    k->dirty = k->urgent = true;
+}
+
+static bool hot_pick_key(HotPopup *p, int ch) {
+    HotPick *k = p->pick;
+    PickSet *ps = &k->set;
+    uint32_t rows = (uint32_t)hot_pick_rows(p);
+
+    if (ch == KEY_RESIZE) return false;
+    if (ch == HOT_KEY_PASTE_BEGIN || ch == HOT_KEY_PASTE_END) {
+        p->pasting = (ch == HOT_KEY_PASTE_BEGIN);
+        return true;
+    }
+    /* a pasted line break must not pick anything */
+    if (p->pasting && (ch == '\n' || ch == '\r' || ch == KEY_ENTER)) return true;
+
+    switch (ch) {
+        case 24: case 27: case 3:   /* Ctrl+X / ESC / Ctrl+C */
+            hot_pick_done(p, NULL);
+            return true;
+        case '\n': case '\r': case KEY_ENTER:
+            hot_pick_filter(p);
+            /* pick from all matches, not the slice filtered so far */
+            while (pick_pending(ps)) pick_update(ps, k->sel + 1);
+            pick_top(ps, k->sel + 1);
+            /* as fzy: with no match the query itself is the result */
+            if (k->sel < ps->ntop) hot_pick_done(p, pick_str(ps, ps->top[k->sel].idx));
+            else hot_pick_done(p, k->qlen ? k->query : NULL);
+            return true;
+        case KEY_UP: case 16: case 11:   /* Ctrl+P / Ctrl+K */
+        case KEY_DOWN: case 14: {        /* Ctrl+N */
+            hot_pick_filter(p);
+            uint32_t nm = pick_matches(ps);
+            if (!nm) return true;
+            bool up = (ch == KEY_UP || ch == 16 || ch == 11);
+            k->sel = up ? (k->sel + nm - 1) % nm : (k->sel + 1) % nm;
+            k->dirty = k->urgent = true;
+            return true;
+        }
+        case KEY_PPAGE:
+            k->sel = k->sel > rows ? k->sel - rows : 0;
+            k->dirty = k->urgent = true;
+            return true;
+        case KEY_NPAGE: {
+            hot_pick_filter(p);
+            uint32_t nm = pick_matches(ps);
+            k->sel = k->sel + rows < nm ? k->sel + rows : (nm ? nm - 1 : 0);
+            k->dirty = k->urgent = true;
+            return true;
+        }
+        case 9: {   /* Tab: complete the query to the selected line */
+            hot_pick_filter(p);
+            pick_top(ps, k->sel + 1);
+            if (k->sel >= ps->ntop) return true;
+            const char *s = pick_str(ps, ps->top[k->sel].idx);
+            int n = (int)strnlen(s, PICK_QUERY_MAX - 1);
+            while (n > 0 && s[n] && ((unsigned char)s[n] & 0xC0) == 0x80) n--;
+            memcpy(k->query, s, (size_t)n);
+            k->qlen = n;
+            hot_pick_edited(k);
+            return true;
+        }
+        case KEY_BACKSPACE: case 127: case 8:
+            if (k->qlen > 0) {
+                do k->qlen--;
+                while (k->qlen > 0 && ((unsigned char)k->query[k->qlen] & 0xC0) == 0x80);
+                hot_pick_edited(k);
+            }
+            return true;
+        case 23:   /* Ctrl+W: delete the last word */
+            while (k->qlen > 0 && k->query[k->qlen - 1] == ' ') k->qlen--;
+            while (k->qlen > 0 && k->query[k->qlen - 1] != ' ') k->qlen--;
+            hot_pick_edited(k);
+            return true;
+        case 21:   /* Ctrl+U */
+            k->qlen = 0;
+            hot_pick_edited(k);
+            return true;
+        case 20:   /* Ctrl+T: all files / executables / ELF (index only) */
+            if (k->ix) {
+                k->filter = (IdxFilter)((k->filter + 1) % 3);
+                hot_pick_fill(p);
+            }
+            return true;
+        default: break;
+    }
+    if (ch >= 32 && ch <= 255 && ch != 127) {
+        if (k->qlen + 1 < PICK_QUERY_MAX) {
+            k->query[k->qlen++] = (char)ch;
+            hot_pick_edited(k);
+        }
+        return true;
+    }
+    return true;
+}
+
+/* =========================
+ *  CPU picker
+ *  cmd 为 "@cpus" 的节点（例如 CPU ID）不再运行 htop，而是打开内置的 CPU 选择器：
+ *  - 按 package / NUMA node 分组，SMT 兄弟线程相邻；每格显示 CPU 号和最近一次的利用率
+ *  - /proc/stat 只打开一次，每 PERFTUI_HOT_CPU_MS（默认 500）pread 采样一次
+ *  - Space 选/取消当前 CPU，c 整个物理核，p 整个 package，n 整个 NUMA node，
+ *    a 全选/全不选，i 反选；也可以直接输入 cpulist（如 0-3,8）
+ *  - Enter 把 cpulist 写入节点的 val（什么都没选时取光标所在的 CPU），ESC 放弃
+ * ========================= */
+#define HOT_CPU_CELL_W      10   /* "*  12  45%" */
+#define HOT_CPU_HEAD_ROWS   2    /* cpulist input, cursor CPU details */
+
+static bool hot_cpu_is_cmd(const char *cmd) {
+    while (*cmd == ' ' || *cmd == '\t') cmd++;
+    if (strncmp(cmd, "@cpus", 5) != 0) return false;
+    for (cmd += 5; *cmd; cmd++) if (*cmd != ' ' && *cmd != '\t' && *cmd != '\n') return false;
+    return true;
+}
+
+static void hot_cpu_stop(HotPopup *p) {
+    HotCpu *k = p ? p->cpu : NULL;
+    if (!k) return;
+    cpu_topo_close(&k->topo);
+    free(k->set);
+    free(k->lines);
+    free(k);
+    p->cpu = NULL;
+}
+
+/* Same package, node, die, cluster and core: SMT siblings. */
+static bool hot_cpu_same_core(const CpuInfo *a, const CpuInfo *b) {
+    return a->pkg == b->pkg && a->node == b->node && a->die == b->die &&
+           a->cluster == b->cluster && a->core == b->core;
+}
+
+static bool hot_cpu_same_group(const CpuInfo *a, const CpuInfo *b) {
+    return a->pkg == b->pkg && a->node == b->node;
+}
+
+static void hot_cpu_line_push(HotCpu *k, int v) {
+    if (k->nlines == k->lines_cap) {
+        k->lines_cap = k->lines_cap ? k->lines_cap * 2 : 64;
+        int *nl = (int*)realloc(k->lines, (size_t)k->lines_cap * sizeof(int));
+        if (!nl) { perror("realloc"); exit(1); }
+        k->lines = nl;
+    }
+    k->lines[k->nlines++] = v;
+}
+
+/* Lay the CPUs out in lines of per_line cells, each package/node group
+ * under a header line; whole cores stay on one line. */
+static void hot_cpu_layout(HotPopup *p) {
+    HotCpu *k = p->cpu;
+    const CpuTopo *t = &k->topo;
+    int iw = p->wi ? getmaxx(p->wi) : HOT_CPU_CELL_W;
+    int per = iw / (HOT_CPU_CELL_W + 1);
+    if (per > t->nsmt) per -= per % t->nsmt;
+    if (per < 1) per = 1;
+    k->per_line = per;
+    k->nlines = 0;
+    for (int i = 0; i < t->n; ) {
+        hot_cpu_line_push(k, -1 - i);
+        int g = i;
+        while (i < t->n && hot_cpu_same_group(&t->cpu[g], &t->cpu[i])) {
+            hot_cpu_line_push(k, i);
+            int col = 0;
+            while (i < t->n && hot_cpu_same_group(&t->cpu[g], &t->cpu[i])) {
+                /* the next core does not fit: new line */
+                int c = i, cw = 0;
+                while (c < t->n && hot_cpu_same_core(&t->cpu[i], &t->cpu[c])) { c++; cw++; }
+                if (col > 0 && col + cw > per) break;
+                col += cw;
+                i = c;
+            }
+        }
+    }
+}
+
+/* Grid line of CPU index i. */
+static int hot_cpu_line_of(const HotCpu *k, int i) {
+    int l = 0;
+    for (int j = 0; j < k->nlines; j++) if (k->lines[j] >= 0 && k->lines[j] <= i) l = j;
+    return l;
+}
+
+/* First CPU after line l (the start of the next line or group, or n). */
+static int hot_cpu_line_end(const HotCpu *k, int l) {
+    if (l + 1 < k->nlines) return k->lines[l + 1] >= 0 ? k->lines[l + 1] : -1 - k->lines[l + 1];
+    return k->topo.n;
+}
+
+static void hot_cpu_text_sync(HotCpu *k) {
+    k->tlen = (int)cpulist_format(k->set, k->text, sizeof(k->text));
+    k->text_bad = false;
+}
+
+static bool hot_cpu_start(HotPopup *p, const char *cmd) {
+    if (!hot_cpu_is_cmd(cmd)) return false;
+    HotCpu *k = (HotCpu*)calloc(1, sizeof(HotCpu));
+    if (!k) { perror("calloc"); exit(1); }
+    if (!cpu_topo_open(&k->topo)) {
+        free(k);
+        return false;
+    }
+    hot_kill_child(p);
+    k->set = (bool*)calloc(CPU_MAX, sizeof(bool));
+    if (!k->set) { perror("calloc"); exit(1); }
+    /* the current value, if it is a cpulist */
+    if (p->owner && p->owner->val && cpulist_parse(p->owner->val, k->set) > 0) {
+        for (int i = 0; i < k->topo.n; i++) if (k->set[k->topo.cpu[i].id]) { k->cur = i; break; }
+    } else {
+        memset(k->set, 0, CPU_MAX * sizeof(bool));
+    }
+    hot_cpu_text_sync(k);
+    k->next_sample_us = hot_now_us() + (uint64_t)p->cpu_sample_ms * 1000u;
+    k->dirty = true;
+    p->cpu = k;
+    p->mode = HOT_CPU;
+    p->drawn = false;
+    hot_cpu_layout(p);
+    return true;
+}
+
+static bool hot_cpu_pump(HotPopup *p) {
+    HotCpu *k = p->cpu;
+    uint64_t now = hot_now_us();
+    if (now >= k->next_sample_us) {
+        cpu_sample(&k->topo);
+        k->next_sample_us = now + (uint64_t)p->cpu_sample_ms * 1000u;
+        k->dirty = true;
+    }
+    return k->dirty;
+}
+
+static int hot_cpu_util_pair(float u) {
+    return term_pair_get(u >= 0.85f ? COLOR_RED : u >= 0.5f ? COLOR_YELLOW : COLOR_GREEN, -1);
+}
+
+static void hot_cpu_draw(HotPopup *p) {
+    HotCpu *k = p->cpu;
+    const CpuTopo *t = &k->topo;
+    hot_pt_sync(p);
+    p->drawn = false;
+    if (k->per_line != getmaxx(p->wi) / (HOT_CPU_CELL_W + 1)) hot_cpu_layout(p);
+
+    int ih, iw;
+    getmaxyx(p->wi, ih, iw);
+    int rows = ih - HOT_CPU_HEAD_ROWS;
+    if (rows < 1) rows = 1;
+    int cl = hot_cpu_line_of(k, k->cur);
+    /* keep the cursor's group header in view when it fits */
+    int top = cl > 0 && k->lines[cl - 1] < 0 ? cl - 1 : cl;
+    if (top < k->scroll) k->scroll = top;
+    if (cl >= k->scroll + rows) k->scroll = cl - rows + 1;
+
+    int nsel = 0;
+    for (int i = 0; i < t->n; i++) if (k->set[t->cpu[i].id]) nsel++;
+
+    werase(p->wb);
+    box(p->wb, 0, 0);
+    char nb[256];
+    const char *nm_s = p->owner ? node_view_name(p->owner, nb, sizeof(nb)) : "";
+    char title[300], avg[16] = "--";
+    if (t->util >= 0) snprintf(avg, sizeof(avg), "%.0f%%", t->util * 100.0f);
+    snprintf(title, sizeof(title), " Hot: %s  %d/%d selected  all %s  %d package%s  %d node%s  SMT%d ",
+             nm_s, nsel, t->n, avg, t->npkg, t->npkg == 1 ? "" : "s",
+             t->nnode, t->nnode == 1 ? "" : "s", t->nsmt);
+    mvwaddnstr(p->wb, 0, 2, title, p->w - 4);
+    mvwaddnstr(p->wb, p->h - 1, 2, " Space=cpu c=core p=package n=node a=all i=invert  Enter=ok ESC=cancel ",
+               p->w - 4);
+
+    werase(p->wi);
+    mvwaddstr(p->wi, 0, 0, "cpus> ");
+    if (k->text_bad) wattrset(p->wi, A_BOLD | COLOR_PAIR(term_pair_get(COLOR_RED, -1)));
+    waddnstr(p->wi, k->text, iw - 7);
+    wattrset(p->wi, A_NORMAL);
+    int cx = getcurx(p->wi);
+
+    const CpuInfo *cc = &t->cpu[k->cur];
+    char info[160], ub[16] = "--", fb[24] = "";
+    if (cc->util >= 0) snprintf(ub, sizeof(ub), "%.0f%%", cc->util * 100.0f);
+    if (cc->mhz > 0) snprintf(fb, sizeof(fb), "  %d MHz", cc->mhz);
+    snprintf(info, sizeof(info), "cpu%d  package %d  die %d  cluster %d  core %d  node %d  %s%s%s",
+             cc->id, cc->pkg, cc->die, cc->cluster, cc->core, cc->node, cc->online ? ub : "offline", fb,
+             k->set[cc->id] ? "  [selected]" : "");
+    wattrset(p->wi, A_DIM);
+    mvwaddnstr(p->wi, 1, 0, info, iw);
+    wattrset(p->wi, A_NORMAL);
+
+    for (int r = 0; r < rows && k->scroll + r < k->nlines; r++) {
+        int l = k->scroll + r, y = HOT_CPU_HEAD_ROWS + r;
+        if (k->lines[l] < 0) {
+            /* group header: package, node, its CPUs and their average */
+            int g = -1 - k->lines[l], e = g;
+            double sum = 0;
+            int nu = 0;
+            while (e < t->n && hot_cpu_same_group(&t->cpu[g], &t->cpu[e])) {
+                if (t->cpu[e].util >= 0) { sum += t->cpu[e].util; nu++; }
+                e++;
+            }
+            char head[128], gu[16] = "--";
+            if (nu) snprintf(gu, sizeof(gu), "%.0f%%", sum * 100.0 / nu);
+            if (t->cpu[g].node >= 0)
+                snprintf(head, sizeof(head), "package %d  node %d  %d CPU%s  %s", t->cpu[g].pkg, t->cpu[g].node,
+                         e - g, e - g == 1 ? "" : "s", gu);
+            else
+                snprintf(head, sizeof(head), "package %d  %d CPU%s  %s", t->cpu[g].pkg, e - g, e - g == 1 ? "" : "s", gu);
+            wattrset(p->wi, A_BOLD);
+            mvwaddnstr(p->wi, y, 0, head, iw);
+            wattrset(p->wi, A_NORMAL);
+            continue;
+        }
+        int end = hot_cpu_line_end(k, l);
+        wmove(p->wi, y, 0);
+        for (int i = k->lines[l]; i < end; i++) {
+            const CpuInfo *c = &t->cpu[i];
+            /* a bar between cores, a space between SMT siblings */
+            if (i > k->lines[l]) {
+                if (t->nsmt > 1 && !hot_cpu_same_core(&t->cpu[i - 1], c)) waddch(p->wi, ACS_VLINE);
+                else waddch(p->wi, ' ');
+            }
+            bool sel = k->set[c->id];
+            attr_t base = (i == k->cur ? A_REVERSE : A_NORMAL) | (sel ? A_BOLD : 0);
+            char cell[24];
+            snprintf(cell, sizeof(cell), "%c%4d", sel ? '*' : ' ', c->id);
+            wattrset(p->wi, base);
+            waddstr(p->wi, cell);
+            if (!c->online || c->util < 0) {
+                waddstr(p->wi, c->online ? "   --" : "  off");
+            } else {
+                int pair = hot_cpu_util_pair(c->util);
+                snprintf(cell, sizeof(cell), "%4.0f%%", c->util * 100.0f);
+                wattrset(p->wi, base | (pair > 0 ? COLOR_PAIR(pair) : 0));
+                waddstr(p->wi, cell);
+            }
+            wattrset(p->wi, A_NORMAL);
+        }
+    }
+    curs_set(1);
+    wmove(p->wi, 0, cx);
+
+    k->dirty = false;
+    wnoutrefresh(p->wb);
+    wnoutrefresh(p->wi);
+}
+
+/* Select the CPUs that share `same` with the cursor's, or clear them if
+ * they all were selected. */
+static void hot_cpu_toggle_run(HotCpu *k, bool (*same)(const CpuInfo*, const CpuInfo*)) {
+    const CpuTopo *t = &k->topo;
+    const CpuInfo *ref = &t->cpu[k->cur];
+    bool all = true;
+    for (int i = 0; i < t->n; i++) if (same(ref, &t->cpu[i]) && !k->set[t->cpu[i].id]) all = false;
+    for (int i = 0; i < t->n; i++) if (same(ref, &t->cpu[i])) k->set[t->cpu[i].id] = !all;
+    hot_cpu_text_sync(k);
+}
+
+static bool hot_cpu_same_pkg(const CpuInfo *a, const CpuInfo *b) { return a->pkg == b->pkg; }
+static bool hot_cpu_same_node(const CpuInfo *a, const CpuInfo *b) { return a->node == b->node; }
+
+static void hot_cpu_text_edited(HotCpu *k) {
+    k->text[k->tlen] = 0;
+    bool *set = (bool*)malloc(CPU_MAX * sizeof(bool));
+    if (!set) { perror("malloc"); exit(1); }
+    /* a trailing ',' or '-' is still being typed: keep the selection */
+    k->text_bad = cpulist_parse(k->text, set) < 0;
+    if (!k->text_bad) memcpy(k->set, set, CPU_MAX * sizeof(bool));
+    free(set);
+}
+
+/* Cursor to column col of grid line l (or the last CPU on it). */
+static void hot_cpu_goto(HotCpu *k, int l, int col) {
+    int start = k->lines[l], end = hot_cpu_line_end(k, l);
+    k->cur = start + col < end ? start + col : end - 1;
+}
+
+static bool hot_cpu_key(HotPopup *p, int ch) {
+    HotCpu *k = p->cpu;
+    const CpuTopo *t = &k->topo;
+    int rows = getmaxy(p->wi) - HOT_CPU_HEAD_ROWS;
+    if (rows < 1) rows = 1;
+
+    if (ch == KEY_RESIZE) return false;
+    if (ch == HOT_KEY_PASTE_BEGIN || ch == HOT_KEY_PASTE_END) {
+        p->pasting = (ch == HOT_KEY_PASTE_BEGIN);
+        return true;
+    }
+    if (p->pasting && (ch == '\n' || ch == '\r' || ch == KEY_ENTER)) return true;
+    k->dirty = true;
+
+    switch (ch) {
+        case 24: case 27: case 3:   /* Ctrl+X / ESC / Ctrl+C */
+            hot_pick_done(p, NULL);
+            return true;
+        case '\n': case '\r': case KEY_ENTER: {
+            if (k->text_bad) { beep(); return true; }
+            char v[sizeof(k->text)];
+            if (k->tlen > 0) snprintf(v, sizeof(v), "%s", k->text);
+            else snprintf(v, sizeof(v), "%d", t->cpu[k->cur].id);
+            hot_pick_done(p, v);
+            return true;
+        }
+        case KEY_LEFT: case 'h':
+            if (k->cur > 0) k->cur--;
+            return true;
+        case KEY_RIGHT: case 'l':
+            if (k->cur + 1 < t->n) k->cur++;
+            return true;
+        case KEY_UP: case 'k': case KEY_DOWN: case 'j': {
+            int l = hot_cpu_line_of(k, k->cur), col = k->cur - k->lines[l];
+            int d = (ch == KEY_UP || ch == 'k') ? -1 : 1;
+            for (int j = l + d; j >= 0 && j < k->nlines; j += d)
+                if (k->lines[j] >= 0) { hot_cpu_goto(k, j, col); break; }
+            return true;
+        }
+        case KEY_PPAGE: case KEY_NPAGE: {
+            int l = hot_cpu_line_of(k, k->cur), col = k->cur - k->lines[l];
+            int j = l + (ch == KEY_PPAGE ? -rows : rows);
+            if (j < 0) j = 0;
+            if (j >= k->nlines) j = k->nlines - 1;
+            /* nearest CPU line */
+            while (j < k->nlines - 1 && k->lines[j] < 0) j++;
+            hot_cpu_goto(k, j, col);
+            return true;
+        }
+        case KEY_HOME: k->cur = 0; return true;
+        case KEY_END:  k->cur = t->n - 1; return true;
+        case ' ':
+            k->set[t->cpu[k->cur].id] = !k->set[t->cpu[k->cur].id];
+            hot_cpu_text_sync(k);
+            return true;
+        case 'c': hot_cpu_toggle_run(k, hot_cpu_same_core); return true;
+        case 'p': hot_cpu_toggle_run(k, hot_cpu_same_pkg); return true;
+        case 'n': hot_cpu_toggle_run(k, hot_cpu_same_node); return true;
+        case 'a': case 'i': {
+            bool any = false;
+            for (int i = 0; i < t->n; i++) if (k->set[t->cpu[i].id]) any = true;
+            for (int i = 0; i < t->n; i++) {
+                bool *s = &k->set[t->cpu[i].id];
+                *s = ch == 'i' ? !*s : !any;
+            }
+            hot_cpu_text_sync(k);
+            return true;
+        }
+        case KEY_BACKSPACE: case 127: case 8:
+            if (k->tlen > 0) { k->tlen--; hot_cpu_text_edited(k); }
+            return true;
+        case 21:   /* Ctrl+U */
+            k->tlen = 0;
+            hot_cpu_text_edited(k);
+            return true;
+        default: break;
+    }
+    if ((ch >= '0' && ch <= '9') || ch == ',' || ch == '-') {
+        if (k->tlen + 1 < (int)sizeof(k->text)) {
+            k->text[k->tlen++] = (char)ch;
+            hot_cpu_text_edited(k);
+        }
+        return true;
+    }
     return true;
 }
 
@@ -1187,16 +2534,156 @@ bool hot_start_cmd(HotPopup *p, const char *cmd) {
     p->input[n] = 0;
     p->in_len = (int)n;
 
-    return hot_spawn(p, p->input);
+    return hot_cpu_start(p, p->input) || hot_pick_start(p, p->input) || hot_spawn(p, p->input);
 }
 
 
-void hot_draw(HotPopup *p) {
-    if (!p || !p->active || !p->wb || !p->wi) return;
+/* =========================
+ *  Scrollback view
+ *  Shift+PgUp 进入历史查看（子进程照常运行、输出照常进入历史）：
+ *  - PgUp/PgDn/Up/Down/Home 滚动，滚到底部、End/q/ESC 回到实时画面
+ *  - '/' 输入关键字，Enter 向上（更早）搜索，'n' 继续找上一处
+ *  - 其它按键回到实时画面并照常发给子进程
+ * ========================= */
+static void hot_view_changed(HotPopup *p) {
+    p->drawn = false;
+    p->pace.dirty = true;
+    p->pace.echo_ready = true; /* local UI change: draw on the next pass */
+}
+
+static void hot_sb_leave(HotPopup *p) {
+    if (!p->sb_viewing) return;
+    p->sb_viewing = false;
+    p->sb_prompt = false;
+    p->sb_hit = -1;
+    hot_view_changed(p);
+}
+
+/* Move the view by delta lines (negative = older); reaching the live
+ * screen leaves the view. */
+static void hot_sb_scroll(HotPopup *p, int64_t delta) {
+    const TermScrollback *sb = p->sess.term.sb;
+    if (!sb) return;
+    int64_t live = (int64_t)(sb->base + (uint64_t)sb->nlines);
+    int64_t top = (p->sb_viewing ? (int64_t)p->sb_top : live) + delta;
+    if (top < (int64_t)sb->base) top = (int64_t)sb->base;
+    if (top >= live) { hot_sb_leave(p); return; }
+    p->sb_viewing = true;
+    p->sb_top = (uint64_t)top;
+    hot_view_changed(p);
+}
+
+/* Output keeps arriving while the view is open: once the lines under
+ * sb_top or sb_hit are evicted (sb->base moved past them), follow the
+ * oldest line still kept. */
+static void hot_sb_clamp(HotPopup *p) {
+    const TermScrollback *sb = p->sess.term.sb;
+    if (!sb) return;
+    if (p->sb_top < sb->base) p->sb_top = sb->base;
+    if (p->sb_hit >= 0 && (uint64_t)p->sb_hit < sb->base) p->sb_hit = -1;
+}
+
+/* Next older match of sb_query, above the last hit or the view bottom. */
+static void hot_sb_find(HotPopup *p) {
+    const TermScrollback *sb = p->sess.term.sb;
+    if (!sb || p->sb_qlen == 0) return;
+    hot_sb_clamp(p);
+    int page = getmaxy(p->wi);
+    uint64_t before = p->sb_hit >= 0 ? (uint64_t)p->sb_hit : p->sb_top + (uint64_t)page;
+    int col = 0;
+    int64_t hit = term_sb_search(sb, before, p->sb_query, &col);
+    if (hit < 0) { beep(); return; }
+    p->sb_hit = hit;
+    p->sb_hit_col = col;
+    p->sb_top = (uint64_t)hit;
+    hot_sb_scroll(p, -(int64_t)(page / 2));
+}
+
+static bool hot_sb_key(HotPopup *p, int ch) {
+    if (!p->sess.term.sb) return false;
+    int page = getmaxy(p->wi);
+    if (page < 1) page = 1;
+    if (ch == KEY_SPREVIOUS) { hot_sb_scroll(p, -page); return true; }
+    if (ch == KEY_SNEXT) { if (p->sb_viewing) hot_sb_scroll(p, page); return true; }
+    if (!p->sb_viewing) return false;
+
+    if (p->sb_prompt) {
+        if (ch == '\n' || ch == '\r' || ch == KEY_ENTER) {
+            p->sb_prompt = false;
+            p->sb_hit = -1;
+            hot_view_changed(p);
+            hot_sb_find(p);
+        } else if (ch == 27) {
+            p->sb_prompt = false;
+            hot_view_changed(p);
+        } else if (ch == KEY_BACKSPACE || ch == 127 || ch == 8) {
+            /* drop one whole UTF-8 character */
+            while (p->sb_qlen > 0 && ((unsigned char)p->sb_query[--p->sb_qlen] & 0xC0) == 0x80) {}
+            p->sb_query[p->sb_qlen] = 0;
+            hot_view_changed(p);
+        } else if (ch >= 32 && ch <= 255 && ch != 127) {
+            if (p->sb_qlen + 1 < (int)sizeof(p->sb_query)) {
+                p->sb_query[p->sb_qlen++] = (char)ch;
+                p->sb_query[p->sb_qlen] = 0;
+            }
+            hot_view_changed(p);
+        }
+        return true;
+    }
+
+    switch (ch) {
+        case KEY_PPAGE: hot_sb_scroll(p, -page); return true;
+        case KEY_NPAGE: hot_sb_scroll(p, page); return true;
+        case KEY_UP:    hot_sb_scroll(p, -1); return true;
+        case KEY_DOWN:  hot_sb_scroll(p, 1); return true;
+        case KEY_HOME:  hot_sb_scroll(p, INT32_MIN); return true;
+        case KEY_END:
+        case 'q':
+        case 27:        hot_sb_leave(p); return true;
+        case '/':
+            p->sb_prompt = true;
+            p->sb_qlen = 0;
+            p->sb_query[0] = 0;
+            hot_view_changed(p);
+            return true;
+        case 'n':       hot_sb_find(p); return true;
+        default:
+            /* typing goes back to the live screen and on to the child */
+            hot_sb_leave(p);
+            return false;
+    }
+}
+
+static void hot_draw_history(HotPopup *p) {
+    const TermScrollback *sb = p->sess.term.sb;
+    hot_sb_clamp(p);
+    char nb[256];
+    const char *nm = p->owner ? node_view_name(p->owner, nb, sizeof(nb)) : "";
+    char title[300];
+    if (p->sb_prompt)
+        snprintf(title, sizeof(title), " Hot: %s  search: %s_ ", nm, p->sb_query);
+    else
+        snprintf(title, sizeof(title), " Hot: %s  history -%llu/%d  /=search n=next q=back ", nm,
+                 (unsigned long long)(sb->base + (uint64_t)sb->nlines - p->sb_top), sb->nlines);
     werase(p->wb);
     box(p->wb, 0, 0);
+    mvwaddnstr(p->wb, 0, 2, title, p->w - 4);
+    hot_pt_sync(p);
+    term_draw_history(p->wi, &p->sess.term, p->sb_top, p->sb_hit, p->sb_hit_col,
+                      term_u8_width(p->sb_query, p->sb_qlen));
+    p->drawn = false; /* the live screen is redrawn in full afterwards */
+    wnoutrefresh(p->wb);
+    wnoutrefresh(p->wi);
+}
+
+void hot_draw(HotPopup *p) {
+    if (!p || !p->active || !p->wb || !p->wi) return;
 
     if (p->mode == HOT_INPUT) {
+        hot_pt_sync(p);
+        werase(p->wb);
+        box(p->wb, 0, 0);
+        p->drawn = false;
         char nb[256];
         const char *nm = p->owner ? node_view_name(p->owner, nb, sizeof(nb)) : "";
         char title[300];
@@ -1214,32 +2701,260 @@ void hot_draw(HotPopup *p) {
         wnoutrefresh(p->wi);
         return;
     }
+    if (p->mode == HOT_PICK && p->pick) {
+        hot_pick_draw(p);
+        return;
+    }
+    if (p->mode == HOT_CPU && p->cpu) {
+        hot_cpu_draw(p);
+        return;
+    }
 
     curs_set(0);
-    term_draw(p->wi, &p->term);
+    if (p->sb_viewing && p->sess.term.sb) {
+        hot_draw_history(p);
+        return;
+    }
+    /* HOT_TERM is incremental: border once per window, title when its text
+     * changes, and only the terminal rows that changed. */
+    bool full = !p->drawn;
+    if (full) {
+        werase(p->wb);
+        box(p->wb, 0, 0);
+        p->drawn_title[0] = 0;
+    }
+    {
+        char nb[256];
+        const char *nm = p->owner ? node_view_name(p->owner, nb, sizeof(nb)) : "";
+        char title[300];
+        if (p->sess.ff_active)
+            snprintf(title, sizeof(title), " Hot: %s  fast-forward (%.1f MB skipped) ", nm,
+                     (double)p->sess.ff_skipped / (1024.0 * 1024.0));
+        else if (p->sess.status[0] || p->sess.progress >= 0) {
+            char pc[8] = "";
+            if (p->sess.progress >= 0) snprintf(pc, sizeof(pc), "%d%% ", p->sess.progress);
+            snprintf(title, sizeof(title), " Hot: %s  %s%s ", nm, pc, p->sess.status);
+        }
+        else if (p->pace.echo_lat_us)
+            snprintf(title, sizeof(title), " Hot: %s  echo %.2fms (avg %.2fms) ", nm,
+                     (double)p->pace.echo_lat_us / 1000.0, (double)p->pace.echo_avg_us / 1000.0);
+        else if (p->sess.ttfb_us)
+            snprintf(title, sizeof(title), " Hot: %s  first byte %.1fms ", nm,
+                     (double)p->sess.ttfb_us / 1000.0);
+        else
+            snprintf(title, sizeof(title), " Hot: %s ", nm);
+        hot_title_cg(title, sizeof(title), p->sess.pid);
+        if (strcmp(title, p->drawn_title) != 0) {
+            mvwhline(p->wb, 0, 1, ACS_HLINE, p->w - 2);
+            mvwaddnstr(p->wb, 0, 2, title, p->w - 4);
+            snprintf(p->drawn_title, sizeof(p->drawn_title), "%s", title);
+        }
+    }
+    /* mid-frame (mode 2026): keep showing the previous frame; the rows stay
+     * dirty and go out together once the child finishes the frame */
+    if (!full && hot_sync_hold(p, hot_now_us())) p->pace.sync_held = true;
+    else if (!full && p->pt_enabled && hot_pt_draw(p)) {}
+    else {
+        if (!full && p->pt_enabled) {
+            /* the write broke off mid-frame: the rows on screen are
+             * unknown, let curses repaint the popup and keep to curses */
+            p->pt_enabled = false;
+            p->pt_painted = true;
+            full = true;
+        }
+        hot_pt_sync(p);
+        term_draw(p->wi, &p->sess.term, full);
+    }
+    p->drawn = true;
     /* Batch screen updates with doupdate() in the caller. */
     wnoutrefresh(p->wb);
     wnoutrefresh(p->wi);
 }
 
-bool hot_pump(HotPopup *p) {
-    if (!p || !p->active || p->mode != HOT_TERM || p->master_fd < 0) return false;
+/* The base UI was drawn over the popup area: copy the popup's unchanged
+ * window content back on the next wnoutrefresh. */
+void hot_touch(HotPopup *p) {
+    if (!p || !p->active || !p->wb) return;
+    /* wi is behind the real screen: let curses draw the popup in full */
+    if (p->pt_painted) p->drawn = false;
+    touchwin(p->wb);
+    touchwin(p->wi);
+}
 
-    unsigned char buf[4096];
-    bool changed = false;
+/* =========================
+ *  Backlog fast-forward
+ *  子进程大量输出（大 find / perf report --stdio）时，普通 pump 每次最多 64KB，
+ *  子进程会长时间阻塞在写满的 pty 上。进入快进模式后：
+ *  - readv 大块读入 ring，尽量一次读空 pty
+ *  - 已经滚出屏幕的纯文本不做仿真（term_ff_skip）；开着回看时只跳过
+ *    回看本来也留不下的行
+ *  - 期间只按 HOT_FF_FRAME_US 低频绘制，最后只渲染最终画面
+ * ========================= */
+#define HOT_PUMP_MAX_BYTES   (64 * 1024)
+#define HOT_FF_RING_KB       1024     /* PERFTUI_HOT_FF_RING_KB */
+#define HOT_FF_BUDGET_US     50000    /* keep keys (Ctrl+X) responsive */
+#define HOT_FF_EXIT_BYTES    (16 * 1024)
+
+static void hot_ff_consume(HotSession *s, const unsigned char *buf, size_t n) {
+    hot_rec_output(s, buf, n);
+    int skip = term_ff_skip(&s->term, buf, (int)n);
+    s->ff_skipped += (uint64_t)skip;
+    term_feed(&s->term, buf + skip, (int)n - skip);
+}
 
+static bool hot_fast_forward(HotSession *s) {
+    HotRing *r = &s->ff_ring;
+    if (!r->buf) {
+        r->cap = (size_t)env_int("PERFTUI_HOT_FF_RING_KB", HOT_FF_RING_KB, 64, 64 * 1024) * 1024u;
+        r->buf = (unsigned char*)malloc(r->cap);
+        if (!r->buf) { perror("malloc"); exit(1); }
+        r->head = r->len = 0;
+    }
+
+    uint64_t t0 = hot_now_us();
+    size_t total = 0;
+    bool drained = false;
+
+    while (!drained && hot_now_us() - t0 < HOT_FF_BUDGET_US) {
+        /* fill: read everything the child has queued, up to the ring size */
+        while (r->len < r->cap) {
+            size_t tail = (r->head + r->len) % r->cap;
+            size_t room = r->cap - r->len;
+            size_t first = r->cap - tail;
+            if (first > room) first = room;
+            struct iovec iov[2];
+            int niov = 1;
+            iov[0].iov_base = r->buf + tail;
+            iov[0].iov_len = first;
+            if (room > first) {
+                iov[1].iov_base = r->buf;
+                iov[1].iov_len = room - first;
+                niov = 2;
+            }
+            ssize_t n = readv(s->master_fd, iov, niov);
+            if (n > 0) { r->len += (size_t)n; continue; }
+            if (n < 0 && errno == EINTR) continue;
+            drained = true; /* EAGAIN, EOF or EIO */
+            break;
+        }
+        if (r->len == 0) break;
+
+        /* consume in (at most two) contiguous spans */
+        while (r->len > 0) {
+            size_t span = r->cap - r->head;
+            if (span > r->len) span = r->len;
+            hot_ff_consume(s, r->buf + r->head, span);
+            r->head = (r->head + span) % r->cap;
+            r->len -= span;
+            total += span;
+        }
+        /* ring is empty: rewind so the next fill is a single large span */
+        r->head = 0;
+    }
+
+    if (drained && total < HOT_FF_EXIT_BYTES) s->ff_active = false;
+    return total > 0;
+}
+
+/* =========================
+ *  OSC value protocol
+ *  热区命令可以在运行中用私有 OSC（TERM_OSC_APP）把结果交回菜单，
+ *  不用抓屏、不用临时文件、也不必退出：
+ *      printf '\033]7717;val=%s\a' "$v"       替换 owner 节点的 val
+ *      printf '\033]7717;add=%s\a' "$v"       追加一个值（按行分隔，同 fzy 多选）
+ *      printf '\033]7717;status=%s\a' "$s"    状态文本显示在标题栏（空串清除）
+ *      printf '\033]7717;progress=%d\a' 42    进度 0..100 显示在标题栏（其它值清除）
+ *  - 也可用 ST（ESC \）结尾；未知的 key 忽略
+ *  - 停放在后台的会话同样生效，菜单上的值随时更新
+ * ========================= */
+static void hot_set_val(HotSession *s, const char *v, bool append) {
+    Node *o = s->owner;
+    if (!o) return;
+    if (!append && o->val && strcmp(o->val, v) == 0) return;
+    size_t old = 0;
+    if (append && o->val && o->val[0]) old = o->val_cap ? o->val_len : strlen(o->val);
+    size_t n = strlen(v);
+    size_t need = old + 1 + n + 1;
+    /* a stream of add= appends in place: the buffer grows by doubling */
+    if (o->val_cap < need) {
+        size_t cap = o->val_cap ? o->val_cap : 64;
+        while (cap < need) cap *= 2;
+        char *nv = (char*)(o->val_cap ? realloc(o->val, cap) : malloc(cap));
+        if (!nv) { perror("realloc"); exit(1); }
+        if (!o->val_cap) {
+            if (old) memcpy(nv, o->val, old);
+            free(o->val);
+        }
+        o->val = nv;
+        o->val_cap = cap;
+    }
+    if (old) o->val[old++] = '\n';
+    memcpy(o->val + old, v, n + 1);
+    o->val_len = old + n;
+    s->val_changed = true;
+}
+
+static void hot_app_msg(HotSession *s, const char *m) {
+    const char *v = strchr(m, '=');
+    if (!v) return;
+    size_t kl = (size_t)(v++ - m);
+    if (kl == 3 && !memcmp(m, "val", 3)) {
+        hot_set_val(s, v, false);
+    } else if (kl == 3 && !memcmp(m, "add", 3)) {
+        hot_set_val(s, v, true);
+    } else if (kl == 6 && !memcmp(m, "status", 6)) {
+        /* cut on a UTF-8 character boundary */
+        size_t n = strlen(v);
+        if (n >= sizeof(s->status)) {
+            n = sizeof(s->status) - 1;
+            while (n > 0 && ((unsigned char)v[n] & 0xC0) == 0x80) n--;
+        }
+        memcpy(s->status, v, n);
+        s->status[n] = 0;
+    } else if (kl == 8 && !memcmp(m, "progress", 8)) {
+        char *end = NULL;
+        long pc = strtol(v, &end, 10);
+        s->progress = (end != v && !*end && pc >= 0 && pc <= 100) ? (int)pc : -1;
+    }
+}
+
+/* After term_feed: answer the child's queries, apply its OSC messages and
+ * note synchronized frames. */
+static void hot_session_fed(HotSession *s) {
+    TermView *t = &s->term;
+    if (t->reply_len > 0) {
+        hot_outq_push(&s->out, t->reply, (size_t)t->reply_len);
+        t->reply_len = 0;
+        hot_flush_out(s);
+    }
+    for (int i = 0; i < t->app_len; i += (int)strlen(t->app + i) + 1) hot_app_msg(s, t->app + i);
+    t->app_len = 0;
+    if (!t->sync_update) s->sync_since_us = 0;
+    else if (!s->sync_since_us) s->sync_since_us = hot_now_us();
+}
+
+/* Read and emulate whatever the child has written; true if anything changed. */
+static bool hot_session_read(HotSession *s) {
+    if (!s || s->master_fd < 0) return false;
+    hot_sel_read(s);
+    if (s->ff_active) {
+        bool fed = hot_fast_forward(s);
+        hot_session_fed(s);
+        return fed;
+    }
+
+    unsigned char buf[4096];
     /* Avoid spending unbounded CPU time in one pump when the child (e.g. htop)
      * redraws aggressively or when resize triggers a burst of output. */
     int total = 0;
-    const int max_bytes = 64 * 1024;
+    const int max_bytes = HOT_PUMP_MAX_BYTES;
 
     /* 先尽可能读出数据 */
     while (total < max_bytes) {
-        ssize_t n = read(p->master_fd, buf, sizeof(buf));
+        ssize_t n = read(s->master_fd, buf, sizeof(buf));
         if (n > 0) {
-            hot_raw_append(p, buf, (int)n);
-            term_feed(&p->term, buf, (int)n);
-            changed = true;
+            hot_rec_output(s, buf, (size_t)n);
+            term_feed(&s->term, buf, (int)n);
             total += (int)n;
             continue;
         }
@@ -1248,60 +2963,231 @@ bool hot_pump(HotPopup *p) {
         if (errno == EINTR) continue;
         break;
     }
+    hot_session_fed(s);
+    if (total > 0 && !s->ttfb_us && s->spawn_us) s->ttfb_us = hot_now_us() - s->spawn_us;
+    /* Hit the cap with data still queued: the child is flooding. */
+    if (total >= max_bytes) s->ff_active = true;
+    return total > 0;
+}
 
-    /* 子进程是否退出 */
-    if (p->running && p->pid > 0) {
-        int st = 0;
-        pid_t r = waitpid(p->pid, &st, WNOHANG);
-        if (r == p->pid) {
-            /* 退出后再 drain 一次，确保拿到最终输出（fzy 会在退出前打印选中行） */
-            while (total < max_bytes) {
-                ssize_t n = read(p->master_fd, buf, sizeof(buf));
-                if (n > 0) {
-                    hot_raw_append(p, buf, (int)n);
-                    term_feed(&p->term, buf, (int)n);
-                    total += (int)n;
-                    continue;
-                }
-                if (n == 0) break;
-                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
-                if (errno == EINTR) continue;
-                break;
-            }
+/* Reap the child if it exited; true when it is gone. */
+static bool hot_session_exited(HotSession *s) {
+    if (!s->running || s->pid <= 0) return false;
+    int st = 0;
+    pid_t r = waitpid(s->pid, &st, WNOHANG);
+    if (r != s->pid) return false;
+    s->running = false;
+    return true;
+}
 
-            if (hot_cmd_is_fzy(p->input) && p->owner) {
-                char plain[8192];
-                char sel[2048];
-                strip_ansi_to_plain(p->raw_tail, p->raw_len, plain, sizeof(plain));
-                if (last_nonempty_line(plain, sel, sizeof(sel))) {
-                    free(p->owner->val);
-                    p->owner->val = strdup(sel);
-                }
-                p->closed_by_enter = true;
-                p->last_owner = p->owner;
-                hot_close(p);
-                return true;
-            }
+bool hot_pump(HotPopup *p) {
+    if (p && p->active && p->mode == HOT_PICK && p->pick) return hot_pick_pump(p);
+    if (p && p->active && p->mode == HOT_CPU && p->cpu) return hot_cpu_pump(p);
+    if (!p || !p->active || p->mode != HOT_TERM || p->sess.master_fd < 0) return false;
+
+    bool changed = hot_session_read(&p->sess);
+    if (changed) hot_pacer_output(&p->pace);
+    /* cgroup stats in the title */
+    if (!changed && hot_cg_due(p->sess.pid)) {
+        p->pace.dirty = true;
+        changed = true;
+    }
+    if (p->sess.val_changed) { p->sess.val_changed = false; p->vals_changed = true; }
 
-            /* 非 fzy：回到输入模式 */
-            hot_kill_child(p);
-            p->mode = HOT_INPUT;
+    /* 子进程是否退出 */
+    if (hot_session_exited(&p->sess)) {
+        /* 退出后再 drain 一次，确保拿到最终输出（fzy 会在退出前打印选中行） */
+        p->sess.ff_active = false;
+        hot_session_read(&p->sess);
+
+        if (hot_cmd_is_fzy(p->sess.cmd) && p->owner) {
+            /* 取消（ESC/Ctrl+C）时 fzy 不输出：保留原值 */
+            char *sel = hot_sel_take(&p->sess);
+            if (sel) {
+                free(p->owner->val);
+                p->owner->val = sel;
+                p->owner->val_cap = 0;
+            }
+            p->closed_by_enter = true;
+            p->last_owner = p->owner;
+            hot_close(p);
             return true;
         }
+
+        /* 非 fzy：回到输入模式 */
+        hot_kill_child(p);
+        p->mode = HOT_INPUT;
+        return true;
     }
     return changed;
 }
 
+/* =========================
+ *  Background sessions
+ *  光标离开 a 节点时不杀子进程，而是把会话停放到后台池（按 owner Node）：
+ *  - 后台继续读 pty 并仿真（不渲染），子进程不会因 pty 写满而阻塞
+ *  - 回到该节点时直接接管，屏幕内容完整，无需重启 fzy/htop
+ *  - 数量 (PERFTUI_HOT_SESSIONS) 与内存 (PERFTUI_HOT_SESSION_MB) 超限时按 LRU 淘汰
+ * ========================= */
+static size_t hot_session_bytes(const HotSession *s) {
+    return sizeof(*s) + term_mem_bytes(&s->term) + s->ff_ring.cap + s->out.cap + s->sel_cap;
+}
+
+static void hot_bg_remove(HotPopup *p, int i) {
+    p->bg[i] = p->bg[p->bg_n - 1];
+    p->bg_n--;
+}
+
+static void hot_bg_enforce(HotPopup *p) {
+    for (;;) {
+        size_t used = 0;
+        for (int i = 0; i < p->bg_n; i++) used += hot_session_bytes(&p->bg[i]);
+        if (p->bg_n == 0 || (p->bg_n <= p->bg_max && used <= p->bg_budget)) return;
+        int lru = 0;
+        for (int i = 1; i < p->bg_n; i++)
+            if (p->bg[i].last_used_us < p->bg[lru].last_used_us) lru = i;
+        hot_session_kill(&p->bg[lru]);
+        hot_bg_remove(p, lru);
+    }
+}
+
+/* Like hot_close(), but a running session is parked instead of killed. */
+void hot_detach(HotPopup *p) {
+    if (!p) return;
+    HotSession *s = &p->sess;
+    if (p->bg_max > 0 && s->running && s->master_fd >= 0 && s->owner) {
+        if (!p->bg) {
+            p->bg = (HotSession*)calloc((size_t)p->bg_max + 1, sizeof(HotSession));
+            if (!p->bg) { perror("calloc"); exit(1); }
+        }
+        s->last_used_us = hot_now_us();
+        p->bg[p->bg_n++] = *s;      /* ownership of fds/buffers moves */
+        hot_session_reset(s);
+        hot_bg_enforce(p);
+    }
+    hot_close(p);
+}
+
+/* Re-attach the parked session of owner, if any. Call after hot_detach(). */
+bool hot_attach(HotPopup *p, Node *owner) {
+    if (!p || !owner) return false;
+    for (int i = 0; i < p->bg_n; i++) {
+        if (p->bg[i].owner != owner) continue;
+        hot_session_kill(&p->sess);
+        p->sess = p->bg[i];
+        hot_bg_remove(p, i);
+        snprintf(p->input, sizeof(p->input), "%s", p->sess.cmd);
+        p->in_len = (int)strlen(p->input);
+        p->mode = HOT_TERM;
+        p->drawn = false;
+        p->sb_viewing = p->sb_prompt = false;
+        p->sb_hit = -1;
+        hot_pacer_reset(&p->pace);
+        p->pace.dirty = true;
+        return true;
+    }
+    return false;
+}
+
+/* Drain background ptys (no rendering) and drop sessions whose child exited;
+ * keep the file indexes current, read prefetches, reap exited children. */
+void hot_bg_pump(HotPopup *p) {
+    if (!p) return;
+    hot_pty_refill(p);
+    for (int i = 0; i < p->idx_n; i++) idx_pump(p->idx[i]);
+    hot_pf_pump(p);
+    hot_reap_poll();
+    hot_cg_poll(false);
+    for (int i = 0; i < p->bg_n; ) {
+        HotSession *s = &p->bg[i];
+        hot_flush_out(s);
+        hot_session_read(s);
+        if (s->val_changed) { s->val_changed = false; p->vals_changed = true; }
+        if (hot_session_exited(s)) {
+            hot_session_kill(s);
+            hot_bg_remove(p, i);
+            continue;
+        }
+        i++;
+    }
+}
+
+/* Kill the attached and all background sessions (program exit). */
+void hot_shutdown(HotPopup *p) {
+    if (!p) return;
+    for (int i = 0; i < p->bg_n; i++) hot_session_kill(&p->bg[i]);
+    free(p->bg);
+    p->bg = NULL;
+    p->bg_n = 0;
+    for (int i = 0; i < p->idx_n; i++) idx_close(p->idx[i]);
+    p->idx_n = 0;
+    while (p->pf_n > 0) hot_pf_drop(p, p->pf_n - 1);
+    while (p->pty_pool_n > 0) close(p->pty_pool[--p->pty_pool_n]);
+    p->pty_pool_want = 0;
+    hot_close(p);
+    hot_reap_flush();
+    hot_cg_flush();
+    cg_root_close(&p->cg);
+    free(hot_pt_buf.buf);
+    memset(&hot_pt_buf, 0, sizeof(hot_pt_buf));
+}
+
+bool hot_bg_busy(const HotPopup *p) {
+    if (!p) return false;
+    if (p->bg_n > 0 || p->idx_n > 0 || hot_reap_n > 0) return true;
+    for (int i = 0; i < p->pf_n; i++) if (!p->pf[i].done_us) return true;
+    return false;
+}
+
 static void hot_send_bytes(HotPopup *p, const char *s, size_t n) {
-    if (!p || p->master_fd < 0 || !s || n == 0) return;
-    if (write(p->master_fd, s, n) < 0) { /* ignore */ }
+    if (!p || p->sess.master_fd < 0 || !s || n == 0) return;
+    /* key -> echo latency: measured from the first unanswered keystroke */
+    if (!p->pace.key_sent_us) p->pace.key_sent_us = hot_now_us();
+    hot_outq_push(&p->sess.out, s, n);
+}
+
+static void hot_paste_add(HotPopup *p, char c) {
+    if (p->paste_len >= HOT_PASTE_MAX) return;
+    if (p->paste_len + 1 > p->paste_cap) {
+        size_t nc = p->paste_cap ? p->paste_cap * 2 : 4096;
+        char *nb = (char*)realloc(p->paste, nc);
+        if (!nb) { perror("realloc"); exit(1); }
+        p->paste = nb;
+        p->paste_cap = nc;
+    }
+    p->paste[p->paste_len++] = c;
+}
 
+/* Forward a completed host paste. Newlines go out as CR like a real
+ * terminal; if the child enabled mode 2004 the text is bracketed (ESC bytes
+ * are dropped so the paste cannot terminate the bracket early). */
+static void hot_send_paste(HotPopup *p) {
+    bool br = p->sess.term.bracketed_paste;
+    size_t w = 0;
+    for (size_t i = 0; i < p->paste_len; i++) {
+        char c = p->paste[i];
+        if (c == '\n') c = '\r';
+        if (br && c == 0x1b) continue;
+        p->paste[w++] = c;
+    }
+    /* the child is not keeping up: queue only what fits under the cap */
+    size_t queued = hot_outq_pending(&p->sess.out);
+    size_t room = queued < HOT_OUTQ_MAX ? HOT_OUTQ_MAX - queued : 0;
+    if (w > room) w = room;
+    p->paste_len = 0;
+    if (w == 0) return;
+    if (br) hot_send_bytes(p, "\x1b[200~", 6);
+    hot_send_bytes(p, p->paste, w);
+    if (br) hot_send_bytes(p, "\x1b[201~", 6);
 }
 
 bool hot_handle_key(HotPopup *p, int ch) {
     if (!p || !p->active) return false;
+    if (p->mode == HOT_PICK && p->pick) return hot_pick_key(p, ch);
+    if (p->mode == HOT_CPU && p->cpu) return hot_cpu_key(p, ch);
 
     if (p->mode == HOT_INPUT) {
+        if (ch == HOT_KEY_PASTE_BEGIN || ch == HOT_KEY_PASTE_END) return true;
         if (ch == 24) { p->closed_by_enter = false; p->last_owner = NULL; hot_close(p); return true; } /* Ctrl+X */
         if (ch == 27) { p->closed_by_enter = false; p->last_owner = NULL; hot_close(p); return true; }
         if (ch == '\n' || ch == '\r' || ch == KEY_ENTER) {
@@ -1309,7 +3195,7 @@ bool hot_handle_key(HotPopup *p, int ch) {
             if (p->in_len > 0) {
                 const char *cmd = p->input;
                 while (*cmd && isspace((unsigned char)*cmd)) cmd++;
-                if (*cmd) hot_spawn(p, cmd);
+                if (*cmd && !hot_cpu_start(p, cmd) && !hot_pick_start(p, cmd)) hot_spawn(p, cmd);
             }
             return true;
         }
@@ -1332,13 +3218,33 @@ bool hot_handle_key(HotPopup *p, int ch) {
         /* Let the main loop handle ncurses resize bookkeeping. */
         return false;
     }
-    if (ch == 24) { p->closed_by_enter = false; p->last_owner = NULL; hot_close(p); return true; } /* Ctrl+X 强制关闭 */
+    if (ch == HOT_KEY_PASTE_BEGIN) { p->pasting = true; p->paste_len = 0; return true; }
+    if (ch == HOT_KEY_PASTE_END) {
+        if (p->pasting) hot_send_paste(p);
+        p->pasting = false;
+        return true;
+    }
+    if (p->pasting) {
+        /* collect the whole paste, then send it as a single write */
+        if (ch >= 0 && ch <= 255) hot_paste_add(p, (char)ch);
+        else if (ch == KEY_ENTER) hot_paste_add(p, '\r');
+        return true;
+    }
+    if (ch == 24) {
+        /* Ctrl+X：隐藏弹窗，会话停放到后台（回到该节点时恢复）；
+         * 抑制本节点的自动弹出，光标才能移走 */
+        p->closed_by_enter = true;
+        p->last_owner = p->owner;
+        hot_detach(p);
+        return true;
+    }
+    if (hot_sb_key(p, ch)) return true;
     if (ch == 27) {
         /* ESC 透传给子进程（fzy 需要 ESC 退出/取消；也更像正常终端） */
         char c = 0x1b; hot_send_bytes(p, &c, 1); return true;
     }
 
-    const bool app = p->term.app_cursor;
+    const bool app = p->sess.term.app_cursor;
 
     switch (ch) {
         case KEY_UP:    hot_send_bytes(p, app ? "\x1bOA" : "\x1b[A", 3); return true;
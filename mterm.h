@@ -5,6 +5,11 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include "mcg.h"
+#include "mcpu.h"
+#include "mindex.h"
+#include "mpick.h"
+#include "mterm_core.h"
 #include "ndx.h"
 
 #ifdef __has_include
@@ -19,37 +24,148 @@
 #  include <ncurses.h>
 #endif
 
-typedef enum { HOT_INPUT = 0, HOT_TERM = 1 } HotMode;
+typedef enum { HOT_INPUT = 0, HOT_TERM = 1, HOT_PICK = 2, HOT_CPU = 3 } HotMode;
 
+/* Hot-terminal frame scheduler (all times in microseconds, CLOCK_MONOTONIC).
+ * - A forwarded keystroke whose echo arrives is rendered at once.
+ * - Nothing is drawn while the child holds a synchronized update (mode
+ *   2026) open, up to sync_timeout_us; the finished frame is shown whole.
+ * - Bulk output is merged into frames at most max_fps per second.
+ * - Draw cost is measured, and frames are spaced so drawing stays within
+ *   HOT_DRAW_BUDGET_PCT of wall time even if curses output gets slow. */
 typedef struct {
-    int rows, cols;
-    char    *cells;
-    uint16_t *attrs;
-    uint16_t  cur_attr;
+    int      max_fps;        /* PERFTUI_HOT_FPS, default 30 */
+    uint64_t frame_us;       /* 1e6 / max_fps */
+    uint64_t last_draw_us;
+    uint64_t draw_cost_us;   /* EWMA of hot_draw + doupdate */
 
-    uint8_t g0_charset;
-    uint8_t g1_charset;
-    bool    use_g1;
+    uint64_t key_sent_us;    /* 0 when no keystroke is awaiting its echo */
+    uint64_t echo_lat_us;    /* last measured key -> echo latency */
+    uint64_t echo_avg_us;    /* EWMA of echo_lat_us */
+    bool     echo_ready;     /* echo arrived: next frame is due immediately */
+    bool     dirty;          /* TermView has changes not yet drawn */
 
-    bool    app_cursor;
-    bool    app_keypad;
+    uint64_t sync_timeout_us; /* PERFTUI_HOT_SYNC_MS: longest wait for a synchronized frame */
+    bool     sync_held;      /* a draw was skipped while the child was mid-frame */
+} HotPacer;
 
-    /* DECSTBM scroll region (inclusive). Ncurses apps (e.g. htop) rely on it,
-     * especially after resize where insert/delete-line is used in a region.
-     */
-    int     scroll_top;
-    int     scroll_bottom;
+/* Read-ahead ring for backlog fast-forward (filled with readv). */
+typedef struct {
+    unsigned char *buf;
+    size_t cap;
+    size_t head;  /* oldest unconsumed byte */
+    size_t len;
+} HotRing;
+
+/* Outbound byte queue to the child pty (keys and pastes). Flushed when
+ * poll() reports the master writable; never drops data. */
+typedef struct {
+    char  *buf;
+    size_t cap;
+    size_t off;   /* first unwritten byte */
+    size_t len;   /* end of queued data */
+} HotOutQ;
+
+/* Extra key codes registered with define_key() for host bracketed paste. */
+#define HOT_KEY_PASTE_BEGIN (KEY_MAX + 1)
+#define HOT_KEY_PASTE_END   (KEY_MAX + 2)
+
+#define HOT_PTY_POOL_MAX 8
+#define HOT_INDEX_MAX    4
+#define HOT_PREFETCH_MAX 8
+
+/* Session recorder (PERFTUI_HOT_RECORD): records (TermRecHdr, see
+ * mterm_core.h) are appended to buf and written out in large blocks. */
+typedef struct {
+    int      fd;
+    uint64_t t0_us;
+    unsigned char *buf;
+    size_t   len, cap;
+} HotRec;
+
+/* One child process running in a pty, with its emulated screen. A session
+ * is either attached to the popup or parked in the background pool, where
+ * its pty keeps being drained so the screen stays current. */
+typedef struct {
+    Node   *owner;
+    char    cmd[256];
 
-    int cx, cy;
-    int saved_cx, saved_cy;
-    bool    wrap_pending; /* VT100 autowrap pending at last column */
+    int     master_fd;
+    pid_t   pid;
+    bool    running;
+    TermView term;
+
+    int     sel_fd;        /* picker: read end of the child's stdout pipe, -1 = none */
+    char   *sel;           /* what the picker printed there (its selection) */
+    size_t  sel_len, sel_cap;
 
+    HotOutQ out;
 
-    int esc_state;
-    char esc_buf[128];
-    int  esc_len;
-    bool osc_esc_seen;
-} TermView;
+    HotRing ff_ring;
+    bool    ff_active;   /* child is flooding: drain in bulk, draw final state */
+    uint64_t ff_skipped; /* bytes not emulated because they scrolled away */
+
+    uint64_t last_used_us; /* LRU stamp, set when parked */
+    uint64_t spawn_us;     /* when the child was started */
+    uint64_t ttfb_us;      /* spawn -> first output byte */
+    uint64_t sync_since_us; /* start of the open synchronized frame, 0 = none */
+
+    HotRec  *rec;          /* NULL: not recording */
+
+    /* set by the child through the private OSC (see mterm.c) */
+    char    status[64];    /* shown in the popup title */
+    int     progress;      /* percent, -1 = none */
+    bool    val_changed;   /* owner->val was updated */
+} HotSession;
+
+/* Built-in picker (HOT_PICK): "<producer> | fzy" and "fzy < file" are run
+ * without fzy; the producer's lines are read into set and filtered here. */
+typedef struct {
+    PickSet  set;
+    pid_t    pid;          /* producer (its own process group), -1 = none */
+    int      fd;           /* its stdout or the file, -1 = all read */
+    char     query[PICK_QUERY_MAX];
+    int      qlen;
+    bool     query_dirty;  /* typed, not filtered yet (keys still pending) */
+    uint64_t typed_us;     /* first unfiltered keystroke */
+    uint32_t sel, scroll;  /* selected match / first visible, in rank order */
+    bool     dirty;        /* not drawn since the last change */
+    bool     urgent;       /* a key changed the view: draw without pacing */
+    uint64_t last_draw_us;
+
+    FileIndex *ix;         /* candidates come from the file index, not a producer */
+    IdxFilter  filter;     /* Ctrl+T: all files / executables / ELF */
+    uint64_t   ix_scans;   /* ix->scans when the candidates were taken */
+} HotPick;
+
+/* Built-in CPU picker (HOT_CPU, cmd "@cpus"): the CPUs grouped by package
+ * and NUMA node with live utilization; the chosen cpulist becomes the value. */
+typedef struct {
+    CpuTopo  topo;
+    bool    *set;          /* CPU_MAX entries: selected CPU numbers */
+    int      cur;          /* cursor, index in topo.cpu */
+    int      scroll;       /* first visible grid line */
+    int     *lines;        /* grid layout: first CPU of each line, -1 - first = group header */
+    int      nlines, lines_cap, per_line;
+    char     text[256];    /* the cpulist, typed or following the grid */
+    int      tlen;
+    bool     text_bad;     /* text is not a valid cpulist */
+    uint64_t next_sample_us;
+    bool     dirty;
+} HotCpu;
+
+/* A picker producer run ahead of time for a node the cursor may stop on;
+ * its output is handed to hot_pick_start instead of running it again. */
+typedef struct {
+    Node    *owner;
+    char     producer[256];
+    pid_t    pid;          /* -1 = finished */
+    int      fd;           /* -1 = finished */
+    char    *buf;          /* what it printed so far */
+    size_t   len, cap;
+    uint64_t done_us;      /* EOF time, 0 = still running */
+    uint64_t used_us;      /* LRU stamp */
+} HotPrefetch;
 
 typedef struct {
     bool    active;
@@ -63,26 +179,98 @@ typedef struct {
     char    input[256];
     int     in_len;
 
-    int     master_fd;
-    pid_t   pid;
-    bool    running;
-    TermView term;
+    HotSession sess;    /* attached session (sess.master_fd < 0: none) */
+    HotPick   *pick;    /* HOT_PICK only */
+    bool       pick_enabled;  /* PERFTUI_HOT_PICKER */
+    int        pick_threads;  /* PERFTUI_HOT_PICK_THREADS, 0 = one per CPU */
+    HotCpu    *cpu;     /* HOT_CPU only */
+    int        cpu_sample_ms; /* PERFTUI_HOT_CPU_MS */
 
-    unsigned char raw_tail[8192];
-    int           raw_len;
+    bool    pasting;    /* between HOT_KEY_PASTE_BEGIN and _END */
+    char   *paste;
+    size_t  paste_len, paste_cap;
 
     Node *last_owner;
     bool  closed_by_enter;
+    bool  vals_changed;  /* a running command set its owner's val: redraw the menu */
+
+    HotPacer pace;
+
+    /* Scrollback view (Shift+PgUp): sb_top is the absolute history line at
+     * the top of the popup; '/' searches towards older lines. */
+    size_t   sb_cap;        /* PERFTUI_HOT_SCROLLBACK_KB per session, 0 = off */
+    bool     sb_viewing;
+    uint64_t sb_top;
+    bool     sb_prompt;     /* typing the search query */
+    char     sb_query[64];
+    int      sb_qlen;
+    int64_t  sb_hit;        /* absolute line of the current match, -1 none */
+    int      sb_hit_col;
+
+    bool  drawn;             /* wb/wi hold a full frame: draw incrementally */
+    bool  pt_enabled;        /* PERFTUI_HOT_PASSTHROUGH: incremental frames bypass curses */
+    bool  pt_painted;        /* rows were written past curses since it last drew wi */
+    char  drawn_title[300];
+
+    /* Background sessions per owner Node, bounded by PERFTUI_HOT_SESSIONS
+     * and PERFTUI_HOT_SESSION_MB; least recently used is evicted first. */
+    HotSession *bg;
+    int         bg_n;
+    int         bg_max;
+    size_t      bg_budget;
+
+    /* Spawn service: pre-opened pty masters and exec mode
+     * (PERFTUI_HOT_PTY_POOL, PERFTUI_HOT_LOGIN). */
+    int         pty_pool[HOT_PTY_POOL_MAX];
+    int         pty_pool_n;
+    int         pty_pool_want;
+    bool        spawn_login;
+
+    char        rec_dir[256]; /* PERFTUI_HOT_RECORD: record sessions here ("" = off) */
+
+    /* File indexes behind "find <root> -type f | fzy" pickers, one per root
+     * (PERFTUI_HOT_INDEX, PERFTUI_HOT_INDEX_THREADS, PERFTUI_HOT_INDEX_DIR). */
+    FileIndex  *idx[HOT_INDEX_MAX];
+    int         idx_n;
+    bool        idx_enabled;
+    int         idx_threads;
+    char        idx_dir[256];
+
+    HotPrefetch pf[HOT_PREFETCH_MAX];
+    int         pf_n;
+    int         pf_jobs;       /* concurrent prefetches, 0 = off */
+    size_t      pf_max_bytes;
+    uint64_t    pf_ttl_us;
+    int         dwell_ms;      /* cursor rest before an 'a' node autoruns */
+
+    CgRoot      cg;            /* delegated cgroup v2 for commands, base "" = none */
+    CgLimits    cg_lim;        /* PERFTUI_HOT_LIMIT_CPU / _MEM_MB / _CPUS */
 } HotPopup;
 
 const char *node_view_name(const Node *n, char *buf, size_t bufsz);
 
 void hot_init(HotPopup *p);
 void hot_close(HotPopup *p);
+void hot_detach(HotPopup *p);
+bool hot_attach(HotPopup *p, Node *owner);
+void hot_bg_pump(HotPopup *p);
+void hot_shutdown(HotPopup *p);
+/* Run the pickers of nodes (nearest first) ahead of time. */
+void hot_prefetch(HotPopup *p, Node *const *nodes, int n);
+/* Background work is pending (parked sessions, prefetches, index scans, exiting children). */
+bool hot_bg_busy(const HotPopup *p);
 bool hot_set_geom(HotPopup *p, int y, int x, int h, int w);
 bool hot_start_cmd(HotPopup *p, const char *cmd);
 bool hot_pump(HotPopup *p);
 void hot_draw(HotPopup *p);
+void hot_touch(HotPopup *p);
 bool hot_handle_key(HotPopup *p, int ch);
 
+/* Frame pacing for HOT_TERM and HOT_PICK. */
+uint64_t hot_now_us(void);
+bool hot_frame_due(HotPopup *p, uint64_t now_us);
+void hot_frame_done(HotPopup *p, uint64_t start_us, uint64_t end_us);
+int  hot_wait_ms(HotPopup *p, uint64_t now_us);
+void hot_wait(HotPopup *p, int in_fd, int timeout_ms);
+
 #endif
@@ -0,0 +1,625 @@
+#define _GNU_SOURCE
+
+/* Headless replay benchmark for the VT emulator core (libmterm.a).
+ *
+ *   mterm_bench [-r rows] [-c cols] [-n reps] [-b chunk] [-s sb_kb] [-p] [-x] [capture...]
+ *   mterm_bench -q timeout_ms
+ *   mterm_bench -f lines [-t threads] [-n reps]
+ *
+ * Each capture is a raw pty byte stream (e.g. `script -q -c htop htop.raw`,
+ * or `cat` of a command's output with CRs) or a session recording made with
+ * PERFTUI_HOT_RECORD (*.ptrec: output is replayed with its resizes, at the
+ * recorded size). -p replays recordings at the recorded pace instead of as
+ * fast as possible; -x writes a recording's output to stdout at its pace
+ * instead of emulating it (watch it in any terminal).
+ *
+ * Without files a built-in set of synthetic streams is replayed (find,
+ * ls --color, a top-like full-screen redraw, CJK text, long printable
+ * runs, short lines scrolling the screen or a DECSTBM region). Every stream is fed through term_feed in chunk-sized
+ * pieces, like hot_session_read does; reported per stream: best ns/byte and
+ * MB/s over the reps, heap allocations per rep, and a hash of the final
+ * screen so runs before and after a change can be compared.
+ *
+ * -q checks the query replies (DSR, DA1/DA2, XTVERSION, XTWINOPS, DECRQM)
+ * against the expected bytes, then times a child on a pty that sends
+ * queries and waits up to timeout_ms for each answer, once with the
+ * replies written back (as hot_session_read does) and once without.
+ * Exits non-zero if a reply is wrong or the answered child missed one.
+ *
+ * -f times the built-in picker (mpick.c) on that many synthetic paths:
+ * the first key, extending the query and Backspace, each as one
+ * pick_query call like a keystroke in HOT_PICK (key: until the call
+ * returns, done: until pick_update has matched everything; best over
+ * the reps). */
+
+#include "mterm_core.h"
+#include "mpick.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <locale.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Allocation counting: linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc */
+static uint64_t bench_allocs, bench_alloc_bytes;
+
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t m, size_t n);
+void *__real_realloc(void *p, size_t n);
+
+void *__wrap_malloc(size_t n) {
+    bench_allocs++;
+    bench_alloc_bytes += n;
+    return __real_malloc(n);
+}
+
+void *__wrap_calloc(size_t m, size_t n) {
+    bench_allocs++;
+    bench_alloc_bytes += m * n;
+    return __real_calloc(m, n);
+}
+
+void *__wrap_realloc(void *p, size_t n) {
+    bench_allocs++;
+    bench_alloc_bytes += n;
+    return __real_realloc(p, n);
+}
+
+typedef struct {
+    char          *name;
+    unsigned char *buf;
+    size_t         len;
+
+    /* session recording: records start at buf + body */
+    bool           rec;
+    size_t         body;
+    int            rows, cols;
+    size_t         out_bytes;    /* output payload bytes */
+    uint64_t       dur_us;       /* time of the last record */
+} BenchStream;
+
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_sleep_until(uint64_t t_ns) {
+    uint64_t now = bench_now_ns();
+    if (t_ns <= now) return;
+    struct timespec ts = { (time_t)((t_ns - now) / 1000000000u), (long)((t_ns - now) % 1000000000u) };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {}
+}
+
+/* Growable byte buffer for the synthetic streams. */
+typedef struct {
+    unsigned char *buf;
+    size_t len, cap;
+} BenchBuf;
+
+static void bench_printf(BenchBuf *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void bench_printf(BenchBuf *b, const char *fmt, ...) {
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf((char*)b->buf + b->len, b->cap - b->len, fmt, ap);
+        va_end(ap);
+        if (n >= 0 && b->len + (size_t)n < b->cap) { b->len += (size_t)n; return; }
+        b->cap = b->cap ? b->cap * 2 : 1 << 20;
+        b->buf = (unsigned char*)__real_realloc(b->buf, b->cap);
+        if (!b->buf) { perror("realloc"); exit(1); }
+    }
+}
+
+#define BENCH_SYNTH_BYTES (16u << 20)
+
+static void synth_find(BenchBuf *b, int rows) {
+    (void)rows;
+    for (unsigned long k = 0; b->len < BENCH_SYNTH_BYTES; k++)
+        bench_printf(b, "/usr/share/doc/package-%lu/examples/subdir/file_%lu.txt%s\r\n", k, k * 7,
+                     (k % 5 == 0) ? "  -- a considerably longer trailing comment that makes this line wrap at the popup edge" : "");
+}
+
+static void synth_ls_color(BenchBuf *b, int rows) {
+    (void)rows;
+    for (unsigned long k = 0; b->len < BENCH_SYNTH_BYTES; k++)
+        bench_printf(b, "\x1b[01;34mdir%lu\x1b[0m  \x1b[38;5;%lumlib%lu.so\x1b[0m  \x1b[01;32mrun_%lu.sh\x1b[0m  "
+                        "\x1b[38;2;%lu;128;64mdata_%lu.bin\x1b[0m\r\n", k, k % 256, k, k, k % 256, k);
+}
+
+/* top/htop-like: alternate screen, then full-screen frames addressed with
+ * CUP, a reversed header, colored columns, EL at line ends. */
+static void synth_top(BenchBuf *b, int rows) {
+    bench_printf(b, "\x1b[?1049h\x1b[?25l");
+    for (unsigned long f = 0; b->len < BENCH_SYNTH_BYTES; f++) {
+        bench_printf(b, "\x1b[?2026h\x1b[H\x1b[7m  PID USER      PR  NI    VIRT    RES  %%CPU  COMMAND\x1b[K\x1b[m");
+        for (int r = 2; r <= rows; r++)
+            bench_printf(b, "\x1b[%d;1H%5lu \x1b[32mroot\x1b[m      20   0 %7lu %6lu \x1b[1m%5.1f\x1b[m  proc-%lu\x1b[K",
+                         r, (f * 31 + (unsigned long)r) % 99999, f * 13 + (unsigned long)r, (unsigned long)r * 97,
+                         (double)((f + (unsigned long)r) % 1000) / 10.0, (unsigned long)r);
+        bench_printf(b, "\x1b[?2026l");
+    }
+    bench_printf(b, "\x1b[?1049l");
+}
+
+static void synth_cjk(BenchBuf *b, int rows) {
+    (void)rows;
+    for (unsigned long k = 0; b->len < BENCH_SYNTH_BYTES; k++)
+        bench_printf(b, "%lu 处理器分析 / 计算处理分析：目标程序 %lu — ┌──┐ café ok\r\n", k, k * 3);
+}
+
+/* Printable runs only: 300-column lines with no control bytes except the
+ * CR LF, so every line wraps twice (the term_put_run fast path). */
+static void synth_print(BenchBuf *b, int rows) {
+    (void)rows;
+    for (unsigned long k = 0; b->len < BENCH_SYNTH_BYTES; k++) {
+        char line[301];
+        for (int i = 0; i < 300; i++) line[i] = (char)(' ' + 1 + (k * 7 + (unsigned long)i) % 94);
+        line[300] = '\0';
+        bench_printf(b, "%s\r\n", line);
+    }
+}
+
+/* Scroll-heavy: short lines, so nearly every byte run ends in a scroll. */
+static void synth_scroll(BenchBuf *b, int rows) {
+    (void)rows;
+    while (b->len < BENCH_SYNTH_BYTES) bench_printf(b, "123456\r\n");
+}
+
+/* The same inside a scroll region (DECSTBM 5..rows-4) */
+static void synth_scroll_region(BenchBuf *b, int rows) {
+    int bot = rows > 12 ? rows - 4 : rows;
+    bench_printf(b, "\x1b[%d;%dr\x1b[%d;1H", rows > 12 ? 5 : 1, bot, bot);
+    while (b->len < BENCH_SYNTH_BYTES) bench_printf(b, "123456\r\n");
+    bench_printf(b, "\x1b[r");
+}
+
+static const struct {
+    const char *name;
+    void (*gen)(BenchBuf *b, int rows);
+} bench_synth[] = {
+    { "synth:find",         synth_find },
+    { "synth:ls-color",     synth_ls_color },
+    { "synth:top",          synth_top },
+    { "synth:cjk",          synth_cjk },
+    { "synth:print",        synth_print },
+    { "synth:scroll",       synth_scroll },
+    { "synth:scroll-region", synth_scroll_region },
+};
+
+static bool load_file(BenchStream *s, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) { fprintf(stderr, "mterm_bench: %s: %s\n", path, strerror(errno)); return false; }
+    BenchBuf b = { 0 };
+    for (;;) {
+        if (b.cap - b.len < 65536) {
+            b.cap = b.cap ? b.cap * 2 : 1 << 20;
+            b.buf = (unsigned char*)__real_realloc(b.buf, b.cap);
+            if (!b.buf) { perror("realloc"); exit(1); }
+        }
+        size_t n = fread(b.buf + b.len, 1, b.cap - b.len, f);
+        if (n == 0) break;
+        b.len += n;
+    }
+    fclose(f);
+    memset(s, 0, sizeof(*s));
+    s->name = strdup(path);
+    s->buf = b.buf;
+    s->len = b.len;
+
+    TermRecFileHdr fh;
+    if (b.len < sizeof(fh) || memcmp(b.buf, TERM_REC_MAGIC, sizeof(fh.magic)) != 0) return true;
+    memcpy(&fh, b.buf, sizeof(fh));
+    s->rec = true;
+    s->rows = (int)fh.rows;
+    s->cols = (int)fh.cols;
+    s->body = sizeof(fh) + fh.cmd_len;
+    if (s->body > b.len || s->rows < 1 || s->cols < 1) {
+        fprintf(stderr, "mterm_bench: %s: bad recording header\n", path);
+        free(s->buf);
+        free(s->name);
+        return false;
+    }
+    /* validate the records once, so replay can trust them */
+    size_t o = s->body;
+    while (o + sizeof(TermRecHdr) <= b.len) {
+        TermRecHdr h;
+        memcpy(&h, b.buf + o, sizeof(h));
+        if (h.len > b.len - o - sizeof(h)) break; /* cut short (perftui killed) */
+        if (h.kind == TERM_REC_OUTPUT) s->out_bytes += h.len;
+        s->dur_us = h.t_us;
+        o += sizeof(h) + h.len;
+    }
+    s->len = o;
+    return true;
+}
+
+/* Feed a recording into t (or write its output to out_fd when >= 0),
+ * paced like the original session if paced. */
+static void replay_rec(const BenchStream *s, TermView *t, bool paced, int out_fd) {
+    uint64_t t0 = bench_now_ns();
+    size_t o = s->body;
+    while (o + sizeof(TermRecHdr) <= s->len) {
+        TermRecHdr h;
+        memcpy(&h, s->buf + o, sizeof(h));
+        const unsigned char *data = s->buf + o + sizeof(h);
+        o += sizeof(h) + h.len;
+        if (paced) bench_sleep_until(t0 + h.t_us * 1000u);
+        if (h.kind == TERM_REC_OUTPUT) {
+            if (out_fd >= 0) {
+                for (size_t w = 0; w < h.len; ) {
+                    ssize_t n = write(out_fd, data + w, h.len - w);
+                    if (n > 0) w += (size_t)n;
+                    else if (n < 0 && errno == EINTR) continue;
+                    else return;
+                }
+            } else {
+                term_feed(t, data, (int)h.len);
+                t->reply_len = 0;
+            }
+        } else if (h.kind == TERM_REC_RESIZE && h.len == 2 * sizeof(uint32_t) && out_fd < 0) {
+            uint32_t sz[2];
+            memcpy(sz, data, sizeof(sz));
+            /* as hot_set_geom does */
+            term_resize(t, (int)sz[0], (int)sz[1]);
+            term_clear_screenbuf_keep_modes(t);
+        }
+    }
+}
+
+static uint32_t screen_hash(const TermView *t) {
+    uint32_t h = 2166136261u;
+    for (int r = 0; r < t->rows; r++) {
+        const TermCell *row = term_row(t, r);
+        int ext = term_ext(t, r);
+        for (int c = 0; c < ext && c < t->cols; c++) {
+            const TermStyle *st = row[c].attr ? &t->styles[row[c].attr] : NULL;
+            uint32_t v[4] = { row[c].ch, st ? st->fg : 0, st ? st->bg : 0, st ? st->flags : 0 };
+            for (int i = 0; i < 4; i++) h = (h ^ v[i]) * 16777619u;
+        }
+        h = (h ^ (uint32_t)ext) * 16777619u;
+    }
+    return (h ^ (uint32_t)(t->cy * 65536 + t->cx)) * 16777619u;
+}
+
+static void run_stream(const BenchStream *s, int rows, int cols, int reps, int chunk, size_t sb_bytes, bool paced) {
+    if (s->rec) {
+        rows = s->rows;
+        cols = s->cols;
+        if (paced) reps = 1;
+    }
+    uint64_t best = UINT64_MAX;
+    uint64_t allocs = 0, alloc_bytes = 0;
+    uint32_t hash = 0;
+    for (int rep = 0; rep < reps; rep++) {
+        TermView t;
+        term_init(&t, rows, cols);
+        if (sb_bytes) t.sb = term_sb_new(sb_bytes);
+        uint64_t a0 = bench_allocs, b0 = bench_alloc_bytes;
+        uint64_t t0 = bench_now_ns();
+        if (s->rec) replay_rec(s, &t, paced, -1);
+        else for (size_t o = 0; o < s->len; o += (size_t)chunk) {
+            size_t n = s->len - o < (size_t)chunk ? s->len - o : (size_t)chunk;
+            term_feed(&t, s->buf + o, (int)n);
+            t.reply_len = 0;
+        }
+        uint64_t el = bench_now_ns() - t0;
+        allocs += bench_allocs - a0;
+        alloc_bytes += bench_alloc_bytes - b0;
+        if (el < best) best = el;
+        hash = screen_hash(&t);
+        term_free(&t);
+    }
+    size_t bytes = s->rec ? s->out_bytes : s->len;
+    if (s->rec && paced) {
+        printf("%-16s %9.2f MB replayed in %.3f s (recorded %.3f s), %dx%d  screen %08x\n",
+               s->name, (double)bytes / 1e6, (double)best / 1e9, (double)s->dur_us / 1e6, rows, cols, hash);
+        return;
+    }
+    double ns_b = bytes ? (double)best / (double)bytes : 0.0;
+    printf("%-19s %9.2f MB %8.3f ns/B %9.1f MB/s %10.1f allocs %9.1f KB alloc  screen %08x\n",
+           s->name, (double)bytes / 1e6, ns_b, ns_b > 0 ? 1e3 / ns_b : 0.0,
+           (double)allocs / reps, (double)alloc_bytes / reps / 1024.0, hash);
+}
+
+/* =========================
+ *  Query replies (-q)
+ *  - 先逐条核对回答字节（整段喂入和逐字节喂入各一次）
+ *  - 再在 pty 上跑一个"查询密集"的子进程：每条查询等回答直到超时，
+ *    分别测写回回答 / 不写回回答时子进程的启动耗时
+ * ========================= */
+typedef struct {
+    const char *name;
+    const char *query;   /* fed to a fresh 24x80 TermView */
+    const char *reply;   /* expected t->reply */
+} BenchQuery;
+
+static const BenchQuery bench_queries[] = {
+    { "DSR 5n",       "\x1b[5n",              "\x1b[0n" },
+    { "DSR 6n",       "\x1b[3;5H\x1b[6n",     "\x1b[3;5R" },
+    { "DECXCPR ?6n",  "ab\r\nc\x1b[?6n",      "\x1b[?2;2R" },
+    { "DA1",          "\x1b[c",               "\x1b[?62;22c" },
+    { "DA1 0c",       "\x1b[0c",              "\x1b[?62;22c" },
+    { "DA2",          "\x1b[>c",              "\x1b[>1;10;0c" },
+    { "XTVERSION",    "\x1b[>q",              "\x1bP>|perftui\x1b\\" },
+    { "XTWINOPS 18t", "\x1b[18t",             "\x1b[8;24;80t" },
+    { "XTWINOPS 19t", "\x1b[19t",             "\x1b[9;24;80t" },
+    { "DECRQM ?2026", "\x1b[?2026$p",         "\x1b[?2026;2$y" },
+    { "DECRQM ?2004", "\x1b[?2004h\x1b[?2004$p", "\x1b[?2004;1$y" },
+    { "DECRQM ?12",   "\x1b[?12$p",           "\x1b[?12;0$y" },
+    { "two queries",  "\x1b[5n\x1b[6n",       "\x1b[0n\x1b[1;1R" },
+    { "not a query",  "\x1b[1;2m\x1b[K",      "" },
+};
+
+#define BENCH_QUERY_N ((int)(sizeof(bench_queries) / sizeof(bench_queries[0])))
+
+/* What the startup child sends, the queries tools like vim, fish or
+ * notcurses issue before their first frame. */
+static const BenchQuery bench_child_queries[] = {
+    { "DSR 5n",       "\x1b[5n",  "n" },
+    { "DSR 6n",       "\x1b[6n",  "R" },
+    { "DECXCPR ?6n",  "\x1b[?6n", "R" },
+    { "DA1",          "\x1b[c",   "c" },
+    { "DA2",          "\x1b[>c",  "c" },
+    { "XTVERSION",    "\x1b[>q",  "\\" },
+    { "XTWINOPS 18t", "\x1b[18t", "t" },
+};
+
+#define BENCH_CHILD_QUERY_N ((int)(sizeof(bench_child_queries) / sizeof(bench_child_queries[0])))
+
+static bool query_check_one(const BenchQuery *q, bool bytewise) {
+    TermView t;
+    term_init(&t, 24, 80);
+    int n = (int)strlen(q->query);
+    if (bytewise) for (int k = 0; k < n; k++) term_feed(&t, (const unsigned char*)q->query + k, 1);
+    else term_feed(&t, (const unsigned char*)q->query, n);
+    bool ok = t.reply_len == (int)strlen(q->reply) && memcmp(t.reply, q->reply, (size_t)t.reply_len) == 0;
+    if (!ok) {
+        printf("  %-14s FAIL (%s): got \"", q->name, bytewise ? "bytewise" : "whole");
+        for (int k = 0; k < t.reply_len; k++) {
+            unsigned char c = (unsigned char)t.reply[k];
+            if (c < 0x20 || c >= 0x7F) printf("\\x%02x", c);
+            else putchar(c);
+        }
+        printf("\"\n");
+    }
+    term_free(&t);
+    return ok;
+}
+
+/* The query-heavy child: raw mode, then each query is sent and the answer
+ * awaited up to timeout_ms (until its final byte arrives). Exit status is
+ * the number of queries answered. */
+static void query_child(int fd, int timeout_ms) {
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    int answered = 0;
+    for (int k = 0; k < BENCH_CHILD_QUERY_N; k++) {
+        const BenchQuery *q = &bench_child_queries[k];
+        if (write(fd, q->query, strlen(q->query)) < 0) _exit(255);
+        uint64_t until = bench_now_ns() + (uint64_t)timeout_ms * 1000000u;
+        bool got = false;
+        while (!got) {
+            uint64_t now = bench_now_ns();
+            if (now >= until) break;
+            struct pollfd pfd = { fd, POLLIN, 0 };
+            if (poll(&pfd, 1, (int)((until - now + 999999u) / 1000000u)) <= 0) continue;
+            char buf[256];
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0) break;
+            if (memchr(buf, q->reply[0], (size_t)n)) got = true;
+        }
+        answered += got;
+    }
+    _exit(answered);
+}
+
+/* Run the child on a new pty; the parent emulates its output and, if
+ * answer, writes the replies back. Returns the child's run time in ns,
+ * *answered gets how many queries it saw answered. */
+static uint64_t query_run(int timeout_ms, bool answer, int *answered) {
+    *answered = -1;
+    int m = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (m < 0 || grantpt(m) != 0 || unlockpt(m) != 0) { perror("posix_openpt"); exit(1); }
+    const char *name = ptsname(m);
+    if (!name) { perror("ptsname"); exit(1); }
+    TermView t;
+    term_init(&t, 24, 80);
+
+    uint64_t t0 = bench_now_ns();
+    pid_t pid = fork();
+    if (pid < 0) { perror("fork"); exit(1); }
+    if (pid == 0) {
+        setsid();
+        int s = open(name, O_RDWR);
+        if (s < 0) _exit(255);
+        query_child(s, timeout_ms);
+    }
+    int st = 0;
+    for (;;) {
+        struct pollfd pfd = { m, POLLIN, 0 };
+        if (poll(&pfd, 1, 10) > 0) {
+            unsigned char buf[4096];
+            ssize_t n = read(m, buf, sizeof(buf));
+            if (n > 0) {
+                term_feed(&t, buf, (int)n);
+                if (answer && t.reply_len > 0 && write(m, t.reply, (size_t)t.reply_len) < 0) perror("write");
+                t.reply_len = 0;
+            }
+        }
+        pid_t w = waitpid(pid, &st, WNOHANG);
+        if (w == pid) break;
+        if (w < 0 && errno != EINTR) { perror("waitpid"); exit(1); }
+    }
+    uint64_t el = bench_now_ns() - t0;
+    if (WIFEXITED(st) && WEXITSTATUS(st) != 255) *answered = WEXITSTATUS(st);
+    term_free(&t);
+    close(m);
+    return el;
+}
+
+static int run_queries(int timeout_ms) {
+    int bad = 0;
+    for (int k = 0; k < BENCH_QUERY_N; k++) {
+        bool ok = query_check_one(&bench_queries[k], false);
+        ok = query_check_one(&bench_queries[k], true) && ok;
+        bad += !ok;
+    }
+    printf("mterm_bench: %d/%d query replies correct\n", BENCH_QUERY_N - bad, BENCH_QUERY_N);
+
+    int a_on, a_off;
+    uint64_t on = query_run(timeout_ms, true, &a_on);
+    uint64_t off = query_run(timeout_ms, false, &a_off);
+    printf("mterm_bench: child with %d queries, %d ms timeout each\n", BENCH_CHILD_QUERY_N, timeout_ms);
+    printf("  %-16s %10.3f ms  %d/%d answered\n", "replies", (double)on / 1e6, a_on, BENCH_CHILD_QUERY_N);
+    printf("  %-16s %10.3f ms  %d/%d answered\n", "no replies", (double)off / 1e6, a_off, BENCH_CHILD_QUERY_N);
+    if (a_on != BENCH_CHILD_QUERY_N) bad++;
+    return bad ? 1 : 0;
+}
+
+/* =========================
+ *  Picker latency (-f)
+ *  每一步是一次 pick_query（和 HOT_PICK 里一次按键相同），没做完的部分
+ *  再循环 pick_update 到做完；每轮重建候选集，免得上一轮保存的匹配历史
+ *  让首键变快
+ * ========================= */
+#define BENCH_PICK_ROWS 40   /* want: the visible rows of the picker */
+
+static const char *const bench_pick_steps[] = { "", "s", "sr", "src", "srcm", "src", "sr", "s", "" };
+static const char *const bench_pick_kind[]  = { "empty", "first key", "extend", "extend", "extend",
+                                                "backspace", "backspace", "backspace", "backspace" };
+#define BENCH_PICK_STEPS ((int)(sizeof(bench_pick_steps) / sizeof(bench_pick_steps[0])))
+
+/* find-like paths: a few thousand directories, varied names and depths */
+static void pick_load(PickSet *ps, long lines) {
+    static const char *const top[] = { "usr/src/linux", "home/user/projects", "var/lib/docker/overlay2",
+                                       "opt/toolchain", "usr/share/doc", "etc/systemd" };
+    static const char *const mid[] = { "drivers", "include", "arch/x86", "tests", "lib", "net/core",
+                                       "fs/ext4", "kernel/sched", "tools/perf", "Documentation" };
+    static const char *const ext[] = { ".c", ".h", ".txt", ".rs", ".py", ".o", ".md", "" };
+    uint32_t r = 12345;
+    for (long k = 0; k < lines; k++) {
+        size_t room;
+        char *dst = pick_space(ps, 512, &room);
+        r = r * 1103515245u + 12345u;
+        int n = snprintf(dst, room, "/%s/%s/mod_%u/%s_%ld%s\n", top[r % 6], mid[(r >> 8) % 10],
+                         (r >> 12) % 4096, (k & 1) ? "file" : "entry", k, ext[(r >> 20) % 8]);
+        pick_commit(ps, (size_t)n);
+    }
+    pick_finish(ps);
+}
+
+static void run_pick(long lines, int threads, int reps) {
+    if (threads <= 0) {
+        long nc = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = nc < 1 ? 1 : (int)nc;
+    }
+    uint64_t best[BENCH_PICK_STEPS], done[BENCH_PICK_STEPS];
+    uint32_t matches[BENCH_PICK_STEPS];
+    for (int k = 0; k < BENCH_PICK_STEPS; k++) best[k] = done[k] = UINT64_MAX;
+    for (int rep = 0; rep < reps; rep++) {
+        PickSet ps;
+        pick_init(&ps, threads);
+        pick_load(&ps, lines);
+        pick_update(&ps, BENCH_PICK_ROWS);
+        for (int k = 0; k < BENCH_PICK_STEPS; k++) {
+            uint64_t t0 = bench_now_ns();
+            pick_query(&ps, bench_pick_steps[k], BENCH_PICK_ROWS);
+            uint64_t el = bench_now_ns() - t0;
+            if (el < best[k]) best[k] = el;
+            while (pick_pending(&ps)) pick_update(&ps, BENCH_PICK_ROWS);
+            el = bench_now_ns() - t0;
+            if (el < done[k]) done[k] = el;
+            matches[k] = pick_matches(&ps);
+        }
+        pick_free(&ps);
+    }
+    printf("mterm_bench: picker, %ld lines, %d threads, %d reps\n", lines, threads, reps);
+    for (int k = 0; k < BENCH_PICK_STEPS; k++)
+        printf("  %-10s \"%s\"%*s key %8.3f ms  done %8.3f ms %9u matches\n", bench_pick_kind[k],
+               bench_pick_steps[k], (int)(6 - strlen(bench_pick_steps[k])), "",
+               (double)best[k] / 1e6, (double)done[k] / 1e6, matches[k]);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: mterm_bench [-r rows] [-c cols] [-n reps] [-b chunk] [-s sb_kb] [-p] [-x] [capture...]\n"
+                    "       mterm_bench -q timeout_ms\n"
+                    "       mterm_bench -f lines [-t threads] [-n reps]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    int rows = 40, cols = 118, reps = 5, chunk = 4096, sb_kb = 4096;
+    int query_ms = 0, pick_threads = 0;
+    long pick_lines = 0;
+    bool paced = false, play = false;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1]; i++) {
+        if (argv[i][1] == 'p') { paced = true; continue; }
+        if (argv[i][1] == 'x') { play = paced = true; continue; }
+        if (i + 1 >= argc) usage();
+        int v = atoi(argv[i + 1]);
+        switch (argv[i][1]) {
+            case 'r': rows = v; break;
+            case 'c': cols = v; break;
+            case 'n': reps = v; break;
+            case 'b': chunk = v; break;
+            case 's': sb_kb = v; break;
+            case 'q': query_ms = v; if (v < 1) usage(); break;
+            case 'f': pick_lines = atol(argv[i + 1]); if (pick_lines < 1) usage(); break;
+            case 't': pick_threads = v; break;
+            default: usage();
+        }
+        i++;
+    }
+    if (rows < 1 || cols < 1 || reps < 1 || chunk < 1 || sb_kb < 0) usage();
+
+    /* wide-character widths come from wcwidth, as in perftui */
+    if (!setlocale(LC_CTYPE, "") || MB_CUR_MAX == 1) setlocale(LC_CTYPE, "C.UTF-8");
+    if (query_ms) return run_queries(query_ms);
+    if (pick_lines) { run_pick(pick_lines, pick_threads, reps); return 0; }
+
+    /* one stream in memory at a time: each is freed once it has run */
+    if (play) {
+        for (; i < argc; i++) {
+            BenchStream s;
+            if (!load_file(&s, argv[i])) continue;
+            if (s.rec) replay_rec(&s, NULL, true, STDOUT_FILENO);
+            free(s.buf);
+            free(s.name);
+        }
+        return 0;
+    }
+
+    printf("mterm_bench: %dx%d, %d reps, %d-byte chunks, scrollback %d KB\n", rows, cols, reps, chunk, sb_kb);
+    if (i == argc) {
+        for (size_t k = 0; k < sizeof(bench_synth) / sizeof(bench_synth[0]); k++) {
+            BenchBuf b = { 0 };
+            bench_synth[k].gen(&b, rows);
+            BenchStream s = { .name = (char*)bench_synth[k].name, .buf = b.buf, .len = b.len };
+            run_stream(&s, rows, cols, reps, chunk, (size_t)sb_kb * 1024u, paced);
+            free(b.buf);
+        }
+    }
+    for (; i < argc; i++) {
+        BenchStream s;
+        if (!load_file(&s, argv[i])) continue;
+        run_stream(&s, rows, cols, reps, chunk, (size_t)sb_kb * 1024u, paced);
+        free(s.buf);
+        free(s.name);
+    }
+    return 0;
+}
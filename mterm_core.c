@@ -0,0 +1,1786 @@
+#define _GNU_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include "mterm_core.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/* =========================
+ *  VT 仿真核心（不依赖 curses）
+ *  - 解析子进程输出（VT500 状态机、CSI/SGR/DEC 模式），维护屏幕 cell、scrollback
+ *  - 绘制在 mterm.c（curses），离线回放在 mterm_bench.c
+ *  - 对外接口见 mterm_core.h
+ * ========================= */
+
+/* Rows changed since the last term_draw (cursor moves do not count). */
+static inline void term_dirty_rows(TermView *t, int r0, int r1) {
+    if (!t || !t->dirty) return;
+    if (r0 < 0) r0 = 0;
+    if (r1 >= t->rows) r1 = t->rows - 1;
+    if (r0 <= r1) memset(t->dirty + r0, 1, (size_t)(r1 - r0 + 1));
+}
+
+static inline void term_dirty_row(TermView *t, int r) {
+    if (t && t->dirty && r >= 0 && r < t->rows) t->dirty[r] = 1;
+}
+
+static inline TermCell term_cell(uint32_t ch, uint16_t attr) {
+    TermCell c = { ch, attr, 1, 0 };
+    return c;
+}
+
+/* Rotate logical rows [top..bottom] up by n (0 < n < height): the n rows
+ * leaving at the top come back at the bottom, ready to be cleared. */
+static void term_rows_rotate_up(TermView *t, int top, int bottom, int n) {
+    int *m = t->rowmap;
+    int height = bottom - top + 1;
+    int tmp[64];
+    if (n > height - n) {
+        /* rotating up by n == rotating down by height - n */
+        int k = height - n;
+        if (k <= (int)(sizeof(tmp) / sizeof(tmp[0]))) {
+            memcpy(tmp, m + bottom - k + 1, (size_t)k * sizeof(int));
+            memmove(m + top + k, m + top, (size_t)n * sizeof(int));
+            memcpy(m + top, tmp, (size_t)k * sizeof(int));
+            return;
+        }
+    } else if (n <= (int)(sizeof(tmp) / sizeof(tmp[0]))) {
+        memcpy(tmp, m + top, (size_t)n * sizeof(int));
+        memmove(m + top, m + top + n, (size_t)(height - n) * sizeof(int));
+        memcpy(m + bottom - n + 1, tmp, (size_t)n * sizeof(int));
+        return;
+    }
+    /* very tall screens: one step at a time through the scratch buffer */
+    while (n > 0) {
+        int step = n < 64 ? n : 64;
+        term_rows_rotate_up(t, top, bottom, step);
+        n -= step;
+    }
+}
+
+/* c[0..n) = v, with wide stores. */
+static void term_cell_fill(TermCell *c, TermCell v, int n) {
+    int i = 0;
+#if defined(__SSE2__)
+    long long w;
+    memcpy(&w, &v, sizeof(w));
+    const __m128i v2 = _mm_set1_epi64x(w);
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_si128((__m128i*)(c + i), v2);
+        _mm_storeu_si128((__m128i*)(c + i + 2), v2);
+        _mm_storeu_si128((__m128i*)(c + i + 4), v2);
+        _mm_storeu_si128((__m128i*)(c + i + 6), v2);
+    }
+#endif
+    for (; i < n; i++) c[i] = v;
+}
+
+static inline TermCell *term_row_open(TermView *t, int r, int from, int to) {
+    int *e = &t->rowext[t->rowmap[r]];
+    TermCell *row = term_row(t, r);
+    if (from > *e) term_cell_fill(row + *e, term_cell(' ', 0), from - *e);
+    if (to > *e) *e = to;
+    return row;
+}
+
+/* Display width of code point cp: 1 or 2, 0 for combining marks. */
+static inline int term_cp_width(uint32_t cp) {
+    if (cp < 0x80) return 1;
+    int w = wcwidth((wchar_t)cp);
+    return w < 0 ? 1 : w;
+}
+
+/* Before cells on one side of column c of row r are rewritten: if c
+ * splits a wide character, blank both halves (one would be left dangling). */
+static inline void term_wide_split(TermView *t, int r, int c) {
+    if (c <= 0 || c >= term_ext(t, r)) return;
+    TermCell *row = term_row(t, r);
+    if (row[c].width != 0) return;
+    row[c - 1] = term_cell(' ', row[c - 1].attr);
+    row[c] = term_cell(' ', row[c].attr);
+}
+
+/* UTF-8 helpers for scrollback records (cells are stored as text). */
+int term_u8_put(char *d, uint32_t cp) {
+    if (cp < 0x80) { d[0] = (char)cp; return 1; }
+    if (cp < 0x800) {
+        d[0] = (char)(0xC0 | (cp >> 6));
+        d[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        d[0] = (char)(0xE0 | (cp >> 12));
+        d[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        d[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    d[0] = (char)(0xF0 | (cp >> 18));
+    d[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    d[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    d[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/* Decode one character of well-formed UTF-8 (as written by term_u8_put);
+ * returns its length. */
+static int term_u8_get(const unsigned char *s, int n, uint32_t *cp) {
+    unsigned char b = s[0];
+    int len = b < 0x80 ? 1 : b < 0xE0 ? 2 : b < 0xF0 ? 3 : 4;
+    if (len > n) { *cp = 0xFFFD; return n; }
+    uint32_t v = len == 1 ? b : len == 2 ? (b & 0x1Fu) : len == 3 ? (b & 0x0Fu) : (b & 0x07u);
+    for (int i = 1; i < len; i++) v = (v << 6) | (s[i] & 0x3Fu);
+    *cp = v;
+    return len;
+}
+
+/* Width in cells of the UTF-8 text s[0..n). */
+int term_u8_width(const char *s, int n) {
+    int w = 0;
+    for (int i = 0; i < n; ) {
+        uint32_t cp;
+        i += term_u8_get((const unsigned char*)s + i, n - i, &cp);
+        w += term_cp_width(cp);
+    }
+    return w;
+}
+
+/* =========================
+ *  Scrollback
+ *  从全屏滚动区顶部滚出的行压缩保存（只对 HOT_TERM 会话开启，t->sb 非空）：
+ *  - 去掉行尾默认属性的空白；属性按 run-length 存 (len, attr)
+ *  - 空行只占一个索引项 (TERM_SB_BLANK)，不占数据
+ *  - 数据按 TERM_SB_BLOCK 分块，超过上限 (PERFTUI_HOT_SCROLLBACK_KB) 丢弃最旧的块
+ *  - 文本以 UTF-8 在记录末尾连续存放（宽字符的右半格不存），
+ *    搜索直接对压缩数据 memmem，无需解码
+ *  - 代价在 term_feed 里：每滚出一行编码一次，O(该行长度)；行首的
+ *    同属性 ASCII 用 SSE2 一次窄化 16 格，其余逐格；丢弃的块留一个复用
+ *    （滚动很快的输出比 -s 0 仍慢，数字见 mterm_bench）
+ *
+ *  记录格式：u16 text_bytes, u16 nruns, nruns * (u16 cells, u16 attr), text
+ * ========================= */
+#define TERM_SB_BLOCK    (64 * 1024)
+#define TERM_SB_BLANK    UINT32_MAX
+
+TermScrollback *term_sb_new(size_t max_bytes) {
+    TermScrollback *sb = (TermScrollback*)calloc(1, sizeof(*sb));
+    if (!sb) { perror("calloc"); exit(1); }
+    sb->max_bytes = max_bytes;
+    return sb;
+}
+
+static void term_sb_free(TermScrollback *sb) {
+    if (!sb) return;
+    for (int i = 0; i < sb->nblocks; i++) {
+        free(sb->blocks[i].data);
+        free(sb->blocks[i].offs);
+    }
+    free(sb->spare.data);
+    free(sb->spare.offs);
+    free(sb->blocks);
+    free(sb);
+}
+
+static void term_sb_drop_oldest(TermScrollback *sb) {
+    TermSbBlock *b = &sb->blocks[0];
+    sb->bytes -= TERM_SB_BLOCK + (size_t)b->cap_lines * sizeof(uint32_t);
+    sb->base += (uint64_t)b->nlines;
+    sb->nlines -= b->nlines;
+    /* keep it for the next block: at the cap every new block would
+     * otherwise be a fresh 64 KB malloc whose pages fault in again */
+    free(sb->spare.data);
+    free(sb->spare.offs);
+    sb->spare = *b;
+    memmove(sb->blocks, sb->blocks + 1, (size_t)(sb->nblocks - 1) * sizeof(TermSbBlock));
+    sb->nblocks--;
+}
+
+/* Newest block, with room for need more data bytes and one more line. */
+static TermSbBlock *term_sb_block(TermScrollback *sb, size_t need) {
+    TermSbBlock *b = sb->nblocks ? &sb->blocks[sb->nblocks - 1] : NULL;
+    if (!b || b->len + need > TERM_SB_BLOCK) {
+        while (sb->nblocks > 0 && sb->bytes + TERM_SB_BLOCK > sb->max_bytes) term_sb_drop_oldest(sb);
+        if (sb->nblocks == sb->cap_blocks) {
+            int nc = sb->cap_blocks ? sb->cap_blocks * 2 : 16;
+            TermSbBlock *nb = (TermSbBlock*)realloc(sb->blocks, (size_t)nc * sizeof(TermSbBlock));
+            if (!nb) { perror("realloc"); exit(1); }
+            sb->blocks = nb;
+            sb->cap_blocks = nc;
+        }
+        b = &sb->blocks[sb->nblocks++];
+        memset(b, 0, sizeof(*b));
+        if (sb->spare.data) {
+            b->data = sb->spare.data;
+            b->offs = sb->spare.offs;
+            b->cap_lines = sb->spare.cap_lines;
+            sb->bytes += (size_t)b->cap_lines * sizeof(uint32_t);
+            memset(&sb->spare, 0, sizeof(sb->spare));
+        } else {
+            b->data = (unsigned char*)malloc(TERM_SB_BLOCK);
+            if (!b->data) { perror("malloc"); exit(1); }
+        }
+        sb->bytes += TERM_SB_BLOCK;
+    }
+    if (b->nlines == b->cap_lines) {
+        int nc = b->cap_lines ? b->cap_lines * 2 : 256;
+        uint32_t *no = (uint32_t*)realloc(b->offs, (size_t)nc * sizeof(uint32_t));
+        if (!no) { perror("realloc"); exit(1); }
+        sb->bytes += (size_t)(nc - b->cap_lines) * sizeof(uint32_t);
+        b->offs = no;
+        b->cap_lines = nc;
+    }
+    return b;
+}
+
+/* The inverse of term_cells_from_ascii: d[i] = c[i].ch for the leading
+ * cells that are ASCII and carry exactly tpl's attribute/width word;
+ * returns how many. SSE2 checks and narrows 16 cells at a time. */
+static int term_cells_to_ascii(char *d, const TermCell *c, int n, TermCell tpl) {
+    int i = 0;
+    uint32_t hi;
+    memcpy(&hi, (const char*)&tpl + 4, sizeof(hi)); /* attr, width, pad */
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    /* per cell (two 32-bit lanes): ch must have no bits above 0x7F and
+     * the second lane must equal hi */
+    const __m128i keep = _mm_set_epi32(-1, ~0x7F, -1, ~0x7F);
+    const __m128i want = _mm_set_epi32((int)hi, 0, (int)hi, 0);
+    for (; i + 16 <= n; i += 16) {
+        const __m128i *s = (const __m128i*)(c + i);
+        __m128i v[8], bad = zero;
+        for (int k = 0; k < 8; k++) {
+            v[k] = _mm_loadu_si128(s + k);
+            bad = _mm_or_si128(bad, _mm_xor_si128(_mm_and_si128(v[k], keep), want));
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(bad, zero)) != 0xFFFF) break;
+        __m128i q[4];
+        for (int k = 0; k < 4; k++)
+            q[k] = _mm_unpacklo_epi64(_mm_shuffle_epi32(v[2 * k], _MM_SHUFFLE(0, 0, 2, 0)),
+                                      _mm_shuffle_epi32(v[2 * k + 1], _MM_SHUFFLE(0, 0, 2, 0)));
+        __m128i w = _mm_packus_epi16(_mm_packs_epi32(q[0], q[1]), _mm_packs_epi32(q[2], q[3]));
+        _mm_storeu_si128((__m128i*)(d + i), w);
+    }
+#endif
+    for (; i < n; i++) {
+        uint32_t h;
+        memcpy(&h, (const char*)&c[i] + 4, sizeof(h));
+        if (c[i].ch >= 0x80 || h != hi) break;
+        d[i] = (char)c[i].ch;
+    }
+    return i;
+}
+
+static void term_sb_push(TermScrollback *sb, const TermCell *cells, int cols) {
+    int len = cols < TERM_SB_MAX_COLS ? cols : TERM_SB_MAX_COLS;
+    while (len > 0 && cells[len - 1].ch == ' ' && cells[len - 1].attr == 0) len--;
+    if (len == 0) {
+        TermSbBlock *b = term_sb_block(sb, 0);
+        sb->nlines++;
+        b->offs[b->nlines++] = TERM_SB_BLANK;
+        return;
+    }
+
+    /* Most lines start with (or are entirely) ASCII in one attribute: that
+     * prefix is narrowed in bulk. The rest goes one cell at a time, with the
+     * attribute runs and the text side by side; the right half of a wide
+     * char (width 0) stores nothing. One copy into the block at the end. */
+    uint16_t runs[TERM_SB_MAX_COLS * 2];
+    char text[TERM_SB_MAX_COLS * 4];
+    int nruns = 0, start = 0;
+    uint16_t attr = cells[0].attr;
+    int tlen = term_cells_to_ascii(text, cells, len, term_cell(' ', attr));
+    for (int i = tlen; i < len; i++) {
+        const TermCell *c = &cells[i];
+        if (c->attr != attr) {
+            runs[nruns * 2] = (uint16_t)(i - start);
+            runs[nruns * 2 + 1] = attr;
+            nruns++;
+            attr = c->attr;
+            start = i;
+        }
+        if (c->ch < 0x80 && c->width == 1) text[tlen++] = (char)c->ch;
+        else if (c->width) tlen += term_u8_put(text + tlen, c->ch);
+    }
+    runs[nruns * 2] = (uint16_t)(len - start);
+    runs[nruns * 2 + 1] = attr;
+    nruns++;
+    size_t need = 4 + (size_t)nruns * 4 + (size_t)tlen;
+
+    TermSbBlock *b = term_sb_block(sb, need);
+    sb->nlines++;
+    unsigned char *d = b->data + b->len;
+    uint16_t h[2] = { (uint16_t)tlen, (uint16_t)nruns };
+    memcpy(d, h, sizeof(h));
+    memcpy(d + sizeof(h), runs, (size_t)nruns * 4);
+    memcpy(d + sizeof(h) + (size_t)nruns * 4, text, (size_t)tlen);
+    b->offs[b->nlines++] = (uint32_t)b->len;
+    b->len += need;
+}
+
+/* Record of history line i (0 = oldest kept); NULL for a blank line. */
+const unsigned char *term_sb_line(const TermScrollback *sb, int i) {
+    for (int k = 0; k < sb->nblocks; k++) {
+        const TermSbBlock *b = &sb->blocks[k];
+        if (i < b->nlines) return b->offs[i] == TERM_SB_BLANK ? NULL : b->data + b->offs[i];
+        i -= b->nlines;
+    }
+    return NULL;
+}
+
+/* Text of a record (stored after the attribute runs). */
+static const char *term_sb_text(const unsigned char *rec, int *len) {
+    uint16_t h[2];
+    memcpy(h, rec, sizeof(h));
+    *len = h[0];
+    return (const char*)rec + 4 + (size_t)h[1] * 4;
+}
+
+void term_sb_decode(const unsigned char *rec, TermCell *cells, int cols) {
+    term_cell_fill(cells, term_cell(' ', 0), cols);
+    if (!rec) return;
+    int len;
+    const unsigned char *text = (const unsigned char*)term_sb_text(rec, &len);
+    uint16_t h[2];
+    memcpy(h, rec, sizeof(h));
+    int c = 0;
+    for (int i = 0; i < len && c < cols; ) {
+        uint32_t cp;
+        i += term_u8_get(text + i, len - i, &cp);
+        int w = term_cp_width(cp);
+        if (w == 2 && c + 1 < cols) {
+            cells[c].ch = cp;
+            cells[c].width = 2;
+            cells[c + 1].ch = 0;
+            cells[c + 1].width = 0;
+        } else {
+            cells[c].ch = w == 2 ? ' ' : cp;
+        }
+        c += w == 2 ? 2 : 1;
+    }
+    c = 0;
+    for (int r = 0; r < h[1] && c < cols; r++) {
+        uint16_t run[2];
+        memcpy(run, rec + 4 + (size_t)r * 4, sizeof(run));
+        int n = run[0] < cols - c ? run[0] : cols - c;
+        for (int k = 0; k < n; k++) cells[c + k].attr = run[1];
+        c += n;
+    }
+}
+
+/* Newest history line with absolute number < before that contains q.
+ * Returns its absolute number (or -1) and the match cell column in *col. */
+int64_t term_sb_search(const TermScrollback *sb, uint64_t before, const char *q, int *col) {
+    size_t qn = strlen(q);
+    if (!sb || qn == 0) return -1;
+    uint64_t abs = sb->base + (uint64_t)sb->nlines;
+    for (int k = sb->nblocks - 1; k >= 0; k--) {
+        const TermSbBlock *b = &sb->blocks[k];
+        for (int i = b->nlines - 1; i >= 0; i--) {
+            abs--;
+            if (abs >= before || b->offs[i] == TERM_SB_BLANK) continue;
+            int len;
+            const char *text = term_sb_text(b->data + b->offs[i], &len);
+            const char *m = (const char*)memmem(text, (size_t)len, q, qn);
+            if (m) { *col = term_u8_width(text, (int)(m - text)); return (int64_t)abs; }
+        }
+    }
+    return -1;
+}
+
+void term_free(TermView *t) {
+    if (!t) return;
+    free(t->rowmap); t->rowmap = NULL;
+    free(t->rowext); t->rowext = NULL;
+    term_sb_free(t->sb); t->sb = NULL;
+    free(t->styles); t->styles = NULL;
+    free(t->style_hash); t->style_hash = NULL;
+    t->nstyles = t->cap_styles = t->style_hash_cap = 0;
+    free(t->cells); t->cells = NULL;
+    free(t->dirty); t->dirty = NULL;
+    free(t->alt_cells); t->alt_cells = NULL;
+    free(t->alt_rowmap); t->alt_rowmap = NULL;
+    free(t->alt_rowext); t->alt_rowext = NULL;
+    free(t->osc); t->osc = NULL;
+    free(t->app); t->app = NULL;
+    t->osc_len = t->app_len = t->app_cap = 0;
+    t->alt_active = false;
+    t->rows = t->cols = 0;
+    t->cx = t->cy = 0;
+    t->saved_cx = t->saved_cy = 0;
+    t->cur_attr = 0;
+    t->wrap_pending = false;
+    t->scroll_top = 0;
+    t->scroll_bottom = 0;
+    t->vt_state = 0;
+    t->vt_nparams = 0;
+    t->u8_need = 0;
+}
+
+/* =========================
+ *  Styles
+ *  cell 里只存 16 位 style id；颜色（默认 / 256 色索引 / 24 位 RGB）与属性
+ *  存在每个 TermView 的 style 表里（id 0 = 默认），按内容哈希去重：
+ *  - SGR 只改 pen，序列结束时查一次表得到 cur_attr
+ *  - id 只增不回收，scrollback 里的记录始终有效；表满时 RGB 退化为 256 色，
+ *    再不行就丢掉颜色
+ * ========================= */
+static void term_pen_reset(TermView *t) {
+    t->pen.fg = t->pen.bg = 0;
+    t->pen.flags = 0;
+    t->cur_attr = 0;
+}
+
+static inline uint32_t term_style_hash(uint32_t fg, uint32_t bg, uint16_t flags) {
+    uint32_t h = fg * 0x9E3779B1u;
+    h ^= bg + 0x7F4A7C15u + (h << 6) + (h >> 2);
+    h ^= flags * 0x85EBCA77u;
+    return h ^ (h >> 15);
+}
+
+static void term_style_rehash(TermView *t, int cap) {
+    free(t->style_hash);
+    t->style_hash = (int32_t*)malloc((size_t)cap * sizeof(int32_t));
+    if (!t->style_hash) { perror("malloc"); exit(1); }
+    memset(t->style_hash, 0xFF, (size_t)cap * sizeof(int32_t));
+    t->style_hash_cap = cap;
+    for (int id = 1; id < t->nstyles; id++) {
+        const TermStyle *st = &t->styles[id];
+        uint32_t h = term_style_hash(st->fg, st->bg, st->flags) & (uint32_t)(cap - 1);
+        while (t->style_hash[h] >= 0) h = (h + 1) & (uint32_t)(cap - 1);
+        t->style_hash[h] = id;
+    }
+}
+
+/* Nearest xterm-256 palette entry: the 6x6x6 cube or the gray ramp. */
+int term_rgb_to_xterm256(int r, int g, int b) {
+    static const int lv[6] = { 0, 95, 135, 175, 215, 255 };
+    int q[3], v[3] = { r, g, b };
+    for (int i = 0; i < 3; i++) q[i] = v[i] < 48 ? 0 : v[i] < 115 ? 1 : (v[i] - 35) / 40;
+    int avg = (r + g + b) / 3;
+    int gi = avg > 238 ? 23 : avg < 8 ? 0 : (avg - 3) / 10;
+    int gv = 8 + 10 * gi;
+    int dc = 0, dg = 0;
+    for (int i = 0; i < 3; i++) {
+        dc += (v[i] - lv[q[i]]) * (v[i] - lv[q[i]]);
+        dg += (v[i] - gv) * (v[i] - gv);
+    }
+    return dg < dc ? 232 + gi : 16 + 36 * q[0] + 6 * q[1] + q[2];
+}
+
+static uint16_t term_style_id(TermView *t, uint32_t fg, uint32_t bg, uint16_t flags) {
+    if (!fg && !bg && !flags) return 0;
+    if (!t->styles) {
+        t->cap_styles = 64;
+        t->styles = (TermStyle*)calloc((size_t)t->cap_styles, sizeof(TermStyle));
+        if (!t->styles) { perror("calloc"); exit(1); }
+        t->nstyles = 1; /* id 0: defaults */
+        term_style_rehash(t, 128);
+    }
+    uint32_t mask = (uint32_t)(t->style_hash_cap - 1);
+    uint32_t h = term_style_hash(fg, bg, flags) & mask;
+    for (int32_t id; (id = t->style_hash[h]) >= 0; h = (h + 1) & mask) {
+        const TermStyle *st = &t->styles[id];
+        if (st->fg == fg && st->bg == bg && st->flags == flags) return (uint16_t)id;
+    }
+    if (t->nstyles >= TERM_STYLE_MAX) {
+        /* table full: fold 24-bit colors into the palette, then drop colors */
+        if ((fg | bg) & TERM_COLOR_RGB) {
+            uint32_t q[2] = { fg, bg };
+            for (int i = 0; i < 2; i++)
+                if (q[i] & TERM_COLOR_RGB)
+                    q[i] = TERM_COLOR_IDX | (uint32_t)term_rgb_to_xterm256((int)(q[i] >> 16) & 0xFF,
+                                                                            (int)(q[i] >> 8) & 0xFF, (int)q[i] & 0xFF);
+            return term_style_id(t, q[0], q[1], flags);
+        }
+        return (fg || bg) ? term_style_id(t, 0, 0, flags) : 0;
+    }
+    if (t->nstyles == t->cap_styles) {
+        int nc = t->cap_styles * 2;
+        TermStyle *ns = (TermStyle*)realloc(t->styles, (size_t)nc * sizeof(TermStyle));
+        if (!ns) { perror("realloc"); exit(1); }
+        t->styles = ns;
+        t->cap_styles = nc;
+    }
+    int id = t->nstyles++;
+    TermStyle *st = &t->styles[id];
+    memset(st, 0, sizeof(*st));
+    st->fg = fg;
+    st->bg = bg;
+    st->flags = flags;
+    t->style_hash[h] = id;
+    if (t->nstyles * 2 > t->style_hash_cap) term_style_rehash(t, t->style_hash_cap * 2);
+    return (uint16_t)id;
+}
+
+/* Every cell := blank with attr. */
+static void term_fill_screen(TermView *t, uint16_t attr) {
+    if (attr) term_cell_fill(t->cells, term_cell(' ', attr), t->rows * t->cols);
+    for (int r = 0; r < t->rows; r++) t->rowext[r] = attr ? t->cols : 0;
+    term_dirty_rows(t, 0, t->rows - 1);
+}
+
+static void term_alt_swap(TermView *t);
+
+void term_clear_all(TermView *t) {
+    if (!t || !t->cells) return;
+    if (t->alt_active) term_alt_swap(t);
+    if (t->alt_rowext) for (int r = 0; r < t->rows; r++) t->alt_rowext[r] = 0;
+    term_fill_screen(t, 0);
+    t->cx = t->cy = 0;
+    term_pen_reset(t);
+    t->g0_charset = 0;
+    t->g1_charset = 0;
+    t->use_g1 = false;
+    t->app_cursor = false;
+    t->app_keypad = false;
+    t->bracketed_paste = false;
+    t->sync_update = false;
+    t->scroll_top = 0;
+    t->scroll_bottom = t->rows > 0 ? (t->rows - 1) : 0;
+    t->wrap_pending = false;
+}
+
+/* Clear only the screen buffer (cells/attrs) but keep terminal modes.
+ * This is important for ncurses apps when the viewport is resized:
+ * we want a clean canvas without losing DECCKM / keypad modes. */
+void term_clear_screenbuf_keep_modes(TermView *t) {
+    if (!t || !t->cells) return;
+    term_fill_screen(t, 0);
+    t->cx = t->cy = 0;
+    t->saved_cx = t->saved_cy = 0;
+    term_pen_reset(t);
+    t->wrap_pending = false;
+    t->scroll_top = 0;
+    t->scroll_bottom = t->rows > 0 ? (t->rows - 1) : 0;
+}
+
+void term_init(TermView *t, int rows, int cols) {
+    memset(t, 0, sizeof(*t));
+    if (rows < 1) rows = 1;
+    if (cols < 1) cols = 1;
+    t->rows = rows;
+    t->cols = cols;
+    t->cells = (TermCell*)malloc((size_t)rows * (size_t)cols * sizeof(TermCell));
+    t->dirty = (uint8_t*)malloc((size_t)rows);
+    t->rowmap = (int*)malloc((size_t)rows * sizeof(int));
+    t->rowext = (int*)malloc((size_t)rows * sizeof(int));
+    if (!t->cells || !t->dirty || !t->rowmap || !t->rowext) { perror("malloc"); exit(1); }
+    for (int r = 0; r < rows; r++) t->rowmap[r] = r;
+    term_clear_all(t);
+}
+
+/* Heap bytes held by the screen buffers (for session memory budgets). */
+size_t term_mem_bytes(const TermView *t) {
+    if (!t || !t->cells) return 0;
+    size_t screen = (size_t)t->rows * (size_t)t->cols * sizeof(TermCell) + (size_t)t->rows * 2 * sizeof(int);
+    return screen * (t->alt_cells ? 2 : 1) + (size_t)t->rows + (t->sb ? t->sb->bytes : 0) +
+           (size_t)t->cap_styles * sizeof(TermStyle) + (size_t)t->style_hash_cap * sizeof(int32_t) +
+           (t->osc ? TERM_OSC_MAX : 0) + (size_t)t->app_cap;
+}
+
+static inline bool term_is_acs(const TermView *t) {
+    if (!t) return false;
+    uint8_t cs = t->use_g1 ? t->g1_charset : t->g0_charset;
+    return cs == 1;
+}
+
+/* Reallocate one screen buffer (primary or alternate) as rows x cols,
+ * keeping its top-left content. */
+static void term_buf_resize(TermCell **cells, int **rowmap, int **rowext,
+                            int orows, int ocols, int rows, int cols) {
+    TermCell *oldc = *cells;
+    int *oldm = *rowmap;
+    int *olde = *rowext;
+
+    TermCell *nc = (TermCell*)malloc((size_t)rows * (size_t)cols * sizeof(TermCell));
+    int *nm = (int*)malloc((size_t)rows * sizeof(int));
+    int *ne = (int*)malloc((size_t)rows * sizeof(int));
+    if (!nc || !nm || !ne) { perror("malloc"); exit(1); }
+    for (int r = 0; r < rows; r++) { nm[r] = r; ne[r] = 0; }
+
+    if (oldc && oldm && olde) {
+        int rmin = (orows < rows) ? orows : rows;
+        int cmin = (ocols < cols) ? ocols : cols;
+        for (int r = 0; r < rmin; r++) {
+            TermCell *row = nc + (size_t)r * (size_t)cols;
+            int n = olde[oldm[r]] < cmin ? olde[oldm[r]] : cmin;
+            memcpy(row, oldc + (size_t)oldm[r] * (size_t)ocols, (size_t)n * sizeof(TermCell));
+            /* a wide character cut in half by the new right edge */
+            if (n > 0 && row[n - 1].width == 2 && n == cols) row[n - 1] = term_cell(' ', row[n - 1].attr);
+            ne[r] = n;
+        }
+    }
+    free(oldc);
+    free(oldm);
+    free(olde);
+    *cells = nc;
+    *rowmap = nm;
+    *rowext = ne;
+}
+
+void term_resize(TermView *t, int rows, int cols) {
+    if (!t) return;
+    if (rows < 1) rows = 1;
+    if (cols < 1) cols = 1;
+    if (rows == t->rows && cols == t->cols && t->cells) return;
+
+    int orows = t->rows, ocols = t->cols;
+    t->rows = rows;
+    t->cols = cols;
+    term_buf_resize(&t->cells, &t->rowmap, &t->rowext, orows, ocols, rows, cols);
+    if (t->alt_cells) term_buf_resize(&t->alt_cells, &t->alt_rowmap, &t->alt_rowext, orows, ocols, rows, cols);
+    free(t->dirty);
+    t->dirty = (uint8_t*)malloc((size_t)rows);
+    if (!t->dirty) { perror("malloc"); exit(1); }
+    term_dirty_rows(t, 0, rows - 1);
+
+    if (t->cy >= rows) t->cy = rows - 1;
+    if (t->cx >= cols) t->cx = cols - 1;
+    t->wrap_pending = false;
+
+    /* clamp scroll region */
+    if (t->scroll_top < 0) t->scroll_top = 0;
+    if (t->scroll_bottom < 0) t->scroll_bottom = rows - 1;
+    if (t->scroll_top >= rows) t->scroll_top = 0;
+    if (t->scroll_bottom >= rows) t->scroll_bottom = rows - 1;
+    if (t->scroll_top > t->scroll_bottom) {
+        t->scroll_top = 0;
+        t->scroll_bottom = rows - 1;
+    }
+}
+
+static void term_fill_blank_line(TermView *t, int row) {
+    if (!t || !t->cells) return;
+    if (row < 0 || row >= t->rows) return;
+    if (t->cur_attr) term_cell_fill(term_row_open(t, row, t->cols, t->cols), term_cell(' ', t->cur_attr), t->cols);
+    else t->rowext[t->rowmap[row]] = 0;
+    term_dirty_row(t, row);
+}
+
+static void term_scroll_up_region(TermView *t, int top, int bottom, int n) {
+    if (!t || !t->cells || n <= 0) return;
+    if (top < 0) top = 0;
+    if (bottom >= t->rows) bottom = t->rows - 1;
+    if (top > bottom) return;
+    term_dirty_rows(t, top, bottom);
+    int height = bottom - top + 1;
+    /* lines leaving the top of the screen go to the scrollback (not from
+     * the alternate screen: full-screen apps redraw, that is not history) */
+    if (top == 0 && t->sb && !t->alt_active) {
+        for (int r = 0; r < n && r < height; r++)
+            term_sb_push(t->sb, term_row(t, r), term_ext(t, r) < t->cols ? term_ext(t, r) : t->cols);
+    }
+    if (n >= height) {
+        for (int r = top; r <= bottom; r++) term_fill_blank_line(t, r);
+        return;
+    }
+    term_rows_rotate_up(t, top, bottom, n);
+    for (int r = bottom - n + 1; r <= bottom; r++) term_fill_blank_line(t, r);
+}
+
+static void term_scroll_down_region(TermView *t, int top, int bottom, int n) {
+    if (!t || !t->cells || n <= 0) return;
+    if (top < 0) top = 0;
+    if (bottom >= t->rows) bottom = t->rows - 1;
+    if (top > bottom) return;
+    term_dirty_rows(t, top, bottom);
+    int height = bottom - top + 1;
+    if (n >= height) {
+        for (int r = top; r <= bottom; r++) term_fill_blank_line(t, r);
+        return;
+    }
+    term_rows_rotate_up(t, top, bottom, height - n);
+    for (int r = top; r < top + n; r++) term_fill_blank_line(t, r);
+}
+
+static void term_scroll_up(TermView *t, int n) {
+    /* full screen scroll */
+    term_scroll_up_region(t, 0, t ? (t->rows - 1) : 0, n);
+}
+
+/* =========================
+ *  Alternate screen
+ *  全屏程序（less/vim/htop/fzy）切到备用屏，退出时切回主屏：
+ *  - 两套 cells/rowmap/rowext，切换只交换指针，主屏内容原样保留
+ *  - 1049 进入时保存光标并清空备用屏，退出时恢复光标；1047 退出时清空；47 只切换
+ *  - 备用屏滚出的行不进 scrollback
+ * ========================= */
+static void term_alt_swap(TermView *t) {
+    TermCell *c = t->cells; t->cells = t->alt_cells; t->alt_cells = c;
+    int *m = t->rowmap; t->rowmap = t->alt_rowmap; t->alt_rowmap = m;
+    int *e = t->rowext; t->rowext = t->alt_rowext; t->alt_rowext = e;
+    t->alt_active = !t->alt_active;
+    t->wrap_pending = false;
+    term_dirty_rows(t, 0, t->rows - 1);
+}
+
+static void term_alt_screen(TermView *t, int mode, bool set) {
+    if (set == t->alt_active) return;
+    if (set) {
+        if (!t->alt_cells) {
+            t->alt_cells = (TermCell*)malloc((size_t)t->rows * (size_t)t->cols * sizeof(TermCell));
+            t->alt_rowmap = (int*)malloc((size_t)t->rows * sizeof(int));
+            t->alt_rowext = (int*)malloc((size_t)t->rows * sizeof(int));
+            if (!t->alt_cells || !t->alt_rowmap || !t->alt_rowext) { perror("malloc"); exit(1); }
+            for (int r = 0; r < t->rows; r++) { t->alt_rowmap[r] = r; t->alt_rowext[r] = 0; }
+        }
+        if (mode == 1049) { t->alt_saved_cx = t->cx; t->alt_saved_cy = t->cy; }
+        term_alt_swap(t);
+        if (mode == 1049) term_fill_screen(t, 0);
+    } else {
+        if (mode == 1047) term_fill_screen(t, 0);
+        term_alt_swap(t);
+        if (mode == 1049) {
+            t->cx = t->alt_saved_cx < t->cols ? t->alt_saved_cx : t->cols - 1;
+            t->cy = t->alt_saved_cy < t->rows ? t->alt_saved_cy : t->rows - 1;
+        }
+    }
+}
+
+static void term_erase_all_keep_modes(TermView *t) {
+    if (!t || !t->cells) return;
+    term_fill_screen(t, t->cur_attr);
+}
+
+static void term_get_region(TermView *t, int *top, int *bottom) {
+    int tt = 0, bb = 0;
+    if (t) {
+        tt = t->scroll_top;
+        bb = t->scroll_bottom;
+    }
+    if (!t || tt < 0 || bb < 0 || tt >= t->rows || bb >= t->rows || tt > bb) {
+        tt = 0;
+        bb = t ? (t->rows - 1) : 0;
+    }
+    if (top) *top = tt;
+    if (bottom) *bottom = bb;
+}
+
+static void term_insert_lines(TermView *t, int n) {
+    if (!t || !t->cells) return;
+    if (n <= 0) n = 1;
+    int top, bottom;
+    term_get_region(t, &top, &bottom);
+    if (t->cy < top || t->cy > bottom) return;
+    int maxn = bottom - t->cy + 1;
+    if (n > maxn) n = maxn;
+    term_dirty_rows(t, t->cy, bottom);
+
+    /* shift down within region: [cy..bottom-n] -> [cy+n..bottom] */
+    if (n < maxn) term_rows_rotate_up(t, t->cy, bottom, maxn - n);
+    for (int r = t->cy; r < t->cy + n; r++) term_fill_blank_line(t, r);
+}
+
+static void term_delete_lines(TermView *t, int n) {
+    if (!t || !t->cells) return;
+    if (n <= 0) n = 1;
+    int top, bottom;
+    term_get_region(t, &top, &bottom);
+    if (t->cy < top || t->cy > bottom) return;
+    int maxn = bottom - t->cy + 1;
+    if (n > maxn) n = maxn;
+    term_dirty_rows(t, t->cy, bottom);
+
+    /* shift up within region: [cy+n..bottom] -> [cy..bottom-n] */
+    if (n < maxn) term_rows_rotate_up(t, t->cy, bottom, n);
+    for (int r = bottom - n + 1; r <= bottom; r++) term_fill_blank_line(t, r);
+}
+
+static void term_insert_chars(TermView *t, int n) {
+    if (!t || !t->cells) return;
+    if (n <= 0) n = 1;
+    if (t->cx < 0) t->cx = 0;
+    if (t->cx >= t->cols) return;
+    if (n > t->cols - t->cx) n = t->cols - t->cx;
+    term_dirty_row(t, t->cy);
+    term_wide_split(t, t->cy, t->cx);
+    term_wide_split(t, t->cy, t->cols - n); /* cells pushed off the edge */
+    TermCell *row = term_row_open(t, t->cy, t->cols, t->cols);
+
+    memmove(row + t->cx + n, row + t->cx, (size_t)(t->cols - t->cx - n) * sizeof(TermCell));
+    term_cell_fill(row + t->cx, term_cell(' ', t->cur_attr), n);
+}
+
+static void term_delete_chars(TermView *t, int n) {
+    if (!t || !t->cells) return;
+    if (n <= 0) n = 1;
+    if (t->cx < 0) t->cx = 0;
+    if (t->cx >= t->cols) return;
+    if (n > t->cols - t->cx) n = t->cols - t->cx;
+    term_dirty_row(t, t->cy);
+    term_wide_split(t, t->cy, t->cx);
+    term_wide_split(t, t->cy, t->cx + n);
+    TermCell *row = term_row_open(t, t->cy, t->cols, t->cols);
+
+    memmove(row + t->cx, row + t->cx + n, (size_t)(t->cols - t->cx - n) * sizeof(TermCell));
+    term_cell_fill(row + t->cols - n, term_cell(' ', t->cur_attr), n);
+}
+
+static void term_erase_chars(TermView *t, int n) {
+    if (!t || !t->cells) return;
+    if (n <= 0) n = 1;
+    if (t->cx < 0) t->cx = 0;
+    if (t->cx >= t->cols) return;
+    if (n > t->cols - t->cx) n = t->cols - t->cx;
+    term_dirty_row(t, t->cy);
+    term_wide_split(t, t->cy, t->cx);
+    term_wide_split(t, t->cy, t->cx + n);
+    int *ext = &t->rowext[t->rowmap[t->cy]];
+    if (!t->cur_attr && t->cx + n >= *ext) {
+        if (t->cx < *ext) *ext = t->cx;
+        return;
+    }
+    TermCell *row = term_row_open(t, t->cy, t->cx, t->cx + n);
+    term_cell_fill(row + t->cx, term_cell(' ', t->cur_attr), n);
+}
+
+static void term_lf(TermView *t) {
+    if (!t) return;
+    t->wrap_pending = false;
+    int top = t->scroll_top;
+    int bottom = t->scroll_bottom;
+    if (top < 0 || bottom < 0 || top >= t->rows || bottom >= t->rows || top > bottom) {
+        top = 0;
+        bottom = t->rows - 1;
+    }
+
+    if (t->cy == bottom) {
+        term_scroll_up_region(t, top, bottom, 1);
+        t->cy = bottom;
+    } else {
+        t->cy++;
+        if (t->cy >= t->rows) t->cy = t->rows - 1;
+    }
+}
+
+static void term_ri(TermView *t) {
+    if (!t) return;
+    t->wrap_pending = false;
+    int top = t->scroll_top;
+    int bottom = t->scroll_bottom;
+    if (top < 0 || bottom < 0 || top >= t->rows || bottom >= t->rows || top > bottom) {
+        top = 0;
+        bottom = t->rows - 1;
+    }
+
+    if (t->cy == top) {
+        term_scroll_down_region(t, top, bottom, 1);
+        t->cy = top;
+    } else {
+        t->cy--;
+        if (t->cy < 0) t->cy = 0;
+    }
+}
+
+/* DEC special graphics (ESC ( 0), 0x5F..0x7E -> Unicode. Translated when
+ * stored, so drawing and the scrollback see ordinary characters. */
+static const uint32_t term_dec_graphics[32] = {
+    0x0020, 0x25C6, 0x2592, 0x2409, 0x240C, 0x240D, 0x240A, 0x00B0, /* _ ` a b c d e f */
+    0x00B1, 0x2424, 0x240B, 0x2518, 0x2510, 0x250C, 0x2514, 0x253C, /* g h i j k l m n */
+    0x23BA, 0x23BB, 0x2500, 0x23BC, 0x23BD, 0x251C, 0x2524, 0x2534, /* o p q r s t u v */
+    0x252C, 0x2502, 0x2264, 0x2265, 0x03C0, 0x2260, 0x00A3, 0x00B7, /* w x y z { | } ~ */
+};
+
+/* Cursor position for the next printable character.
+ *
+ * VT100 autowrap:
+ * When a character is written in the last column, the cursor does not
+ * immediately advance to the next line. Instead, a "wrap pending" flag is
+ * set and the *next* printable character triggers the line wrap.
+ *
+ * Many ncurses apps (top/htop) write full-width lines and also emit explicit
+ * cursor moves / linefeeds. If we wrap immediately, we end up skipping a
+ * line and showing "blank lines" between rows. */
+static void term_print_pos(TermView *t) {
+    if (t->cx < 0) t->cx = 0;
+    if (t->cy < 0) t->cy = 0;
+    if (t->wrap_pending) {
+        t->wrap_pending = false;
+        t->cx = 0;
+        t->cy++;
+        if (t->cy >= t->rows) {
+            term_scroll_up(t, 1);
+            t->cy = t->rows - 1;
+        }
+    }
+    if (t->cx >= t->cols) t->cx = t->cols - 1;
+    if (t->cy >= t->rows) {
+        term_scroll_up(t, 1);
+        t->cy = t->rows - 1;
+    }
+}
+
+static void term_put_cp(TermView *t, uint32_t cp) {
+    if (!t || !t->cells) return;
+    if (cp >= 0x5F && cp <= 0x7E && term_is_acs(t)) cp = term_dec_graphics[cp - 0x5F];
+    int w = term_cp_width(cp);
+    if (w == 0) return; /* combining marks are not kept */
+    if (w == 2 && t->cols < 2) { cp = ' '; w = 1; }
+
+    term_print_pos(t);
+    if (w == 2 && t->cx == t->cols - 1) {
+        /* no room for both halves: wrap first, like xterm */
+        t->wrap_pending = true;
+        term_print_pos(t);
+    }
+
+    term_wide_split(t, t->cy, t->cx);
+    term_wide_split(t, t->cy, t->cx + w);
+    TermCell *row = term_row_open(t, t->cy, t->cx, t->cx + w);
+    row[t->cx] = term_cell(cp, t->cur_attr);
+    if (w == 2) {
+        row[t->cx].width = 2;
+        row[t->cx + 1] = term_cell(0, t->cur_attr);
+        row[t->cx + 1].width = 0;
+    }
+    term_dirty_row(t, t->cy);
+
+    if (t->cx + w >= t->cols) {
+        t->wrap_pending = true;
+        t->cx = t->cols - 1; /* keep cx at last column */
+    } else {
+        t->cx += w;
+    }
+}
+
+/* Incremental UTF-8 decoding of one byte >= 0x80 (or an ASCII byte that
+ * cuts a sequence short). Malformed input shows as U+FFFD. */
+static void term_put_u8(TermView *t, unsigned char ch) {
+    if (ch >= 0x80 && ch < 0xC0) {
+        if (t->u8_need == 0) { term_put_cp(t, 0xFFFD); return; }
+        t->u8_cp = (t->u8_cp << 6) | (ch & 0x3Fu);
+        if (--t->u8_need == 0) term_put_cp(t, t->u8_cp <= 0x10FFFF ? t->u8_cp : 0xFFFD);
+        return;
+    }
+    if (t->u8_need) { t->u8_need = 0; term_put_cp(t, 0xFFFD); }
+    if (ch < 0x80)                    term_put_cp(t, ch);
+    else if (ch >= 0xC2 && ch < 0xE0) { t->u8_cp = ch & 0x1Fu; t->u8_need = 1; }
+    else if (ch >= 0xE0 && ch < 0xF0) { t->u8_cp = ch & 0x0Fu; t->u8_need = 2; }
+    else if (ch >= 0xF0 && ch < 0xF5) { t->u8_cp = ch & 0x07u; t->u8_need = 3; }
+    else                              term_put_cp(t, 0xFFFD);
+}
+
+/* =========================
+ *  Printable-run fast path
+ *  find / perf report 的输出绝大部分是成段的纯 ASCII：
+ *  - SIMD 找到下一个非 ASCII 可打印字节（< 0x20 含 ESC，或 >= 0x80 的 UTF-8），
+ *    整段交给 term_put_run
+ *  - term_put_run 按行批量写 cell，在行尾处理 autowrap
+ *  语义与逐字符 term_put_cp 完全一致；UTF-8 走 term_put_u8。
+ * ========================= */
+
+/* Length of the leading run of bytes 0x20..0x7F in s[0..n). */
+static size_t term_printable_span(const unsigned char *s, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i lim = _mm256_set1_epi8(0x20);
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+        /* signed: byte < 0x20 or >= 0x80 <=> 0x20 > byte */
+        unsigned m = (unsigned)_mm256_movemask_epi8(_mm256_cmpgt_epi8(lim, v));
+        if (m) return i + (size_t)__builtin_ctz(m);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i limx = _mm_set1_epi8(0x20);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmplt_epi8(v, limx));
+        if (m) return i + (size_t)__builtin_ctz(m);
+    }
+#endif
+    while (i < n && s[i] >= 0x20 && s[i] < 0x80) i++;
+    return i;
+}
+
+/* d[i] = tpl with ch = s[i]. Cells are 8 times the size of the input, so
+ * the SSE2 path widens 16 bytes at a time straight into cell layout. */
+static void term_cells_from_ascii(TermCell *d, const unsigned char *s, int n, TermCell tpl) {
+    int i = 0;
+#if defined(__SSE2__)
+    uint32_t hi;
+    memcpy(&hi, (const char*)&tpl + 4, sizeof(hi)); /* attr, width, pad */
+    const __m128i hiv = _mm_set1_epi32((int)hi);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i < n && n >= 16; i += 16) {
+        if (i + 16 > n) i = n - 16; /* last block overlaps the previous one */
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i w8[2] = { _mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero) };
+        __m128i *o = (__m128i*)(d + i);
+        for (int h = 0; h < 2; h++) {
+            __m128i c0 = _mm_unpacklo_epi16(w8[h], zero);
+            __m128i c1 = _mm_unpackhi_epi16(w8[h], zero);
+            _mm_storeu_si128(o++, _mm_unpacklo_epi32(c0, hiv));
+            _mm_storeu_si128(o++, _mm_unpackhi_epi32(c0, hiv));
+            _mm_storeu_si128(o++, _mm_unpacklo_epi32(c1, hiv));
+            _mm_storeu_si128(o++, _mm_unpackhi_epi32(c1, hiv));
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        d[i] = tpl;
+        d[i].ch = s[i];
+    }
+}
+
+/* term_put_cp for a run of ASCII: cells written per row segment. */
+static void term_put_run(TermView *t, const unsigned char *s, int n) {
+    if (!t || !t->cells || n <= 0) return;
+    if (term_is_acs(t)) {
+        for (int i = 0; i < n; i++) term_put_cp(t, s[i]);
+        return;
+    }
+    TermCell tpl = term_cell(0, t->cur_attr);
+
+    while (n > 0) {
+        term_print_pos(t);
+
+        int k = t->cols - t->cx;
+        if (k > n) k = n;
+        term_wide_split(t, t->cy, t->cx);
+        term_wide_split(t, t->cy, t->cx + k);
+        TermCell *row = term_row_open(t, t->cy, t->cx, t->cx + k);
+        term_cells_from_ascii(row + t->cx, s, k, tpl);
+        term_dirty_row(t, t->cy);
+
+        s += k;
+        n -= k;
+        t->cx += k;
+        if (t->cx >= t->cols) {
+            /* last column written: wrap on the next printable */
+            t->cx = t->cols - 1;
+            t->wrap_pending = true;
+        }
+    }
+}
+
+static void term_clear_line_from(TermView *t, int from_x) {
+    if (!t || !t->cells) return;
+    if (from_x < 0) from_x = 0;
+    if (from_x >= t->cols) return;
+    term_dirty_row(t, t->cy);
+    term_wide_split(t, t->cy, from_x);
+    if (!t->cur_attr) {
+        int *ext = &t->rowext[t->rowmap[t->cy]];
+        if (from_x < *ext) *ext = from_x;
+        return;
+    }
+    TermCell *row = term_row_open(t, t->cy, from_x, t->cols);
+    term_cell_fill(row + from_x, term_cell(' ', t->cur_attr), t->cols - from_x);
+}
+
+static void term_clear_line_to(TermView *t, int to_x) {
+    if (!t || !t->cells) return;
+    if (to_x < 0) return;
+    if (to_x >= t->cols) to_x = t->cols - 1;
+    term_dirty_row(t, t->cy);
+    term_wide_split(t, t->cy, to_x + 1);
+    if (!t->cur_attr && to_x + 1 >= term_ext(t, t->cy)) {
+        t->rowext[t->rowmap[t->cy]] = 0;
+        return;
+    }
+    TermCell *row = term_row_open(t, t->cy, 0, to_x + 1);
+    term_cell_fill(row, term_cell(' ', t->cur_attr), to_x + 1);
+}
+
+static void term_clear_screen_from(TermView *t) {
+    if (!t || !t->cells) return;
+    term_clear_line_from(t, t->cx);
+    for (int r = t->cy + 1; r < t->rows; r++) term_fill_blank_line(t, r);
+}
+
+static void term_clear_screen_to(TermView *t) {
+    if (!t || !t->cells) return;
+    for (int r = 0; r < t->cy; r++) term_fill_blank_line(t, r);
+    term_clear_line_to(t, t->cx);
+}
+
+static int term_rgb_to_ansi8(int r, int g, int b) {
+    /* 近似映射到 8 色：0 black,1 red,2 green,3 yellow,4 blue,5 magenta,6 cyan,7 white */
+    if (r < 0) r = 0;
+    if (r > 255) r = 255;
+    if (g < 0) g = 0;
+    if (g > 255) g = 255;
+    if (b < 0) b = 0;
+    if (b > 255) b = 255;
+
+    int maxc = r; if (g > maxc) maxc = g; if (b > maxc) maxc = b;
+    int minc = r; if (g < minc) minc = g; if (b < minc) minc = b;
+    int avg  = (r + g + b) / 3;
+
+    if (maxc < 60) return 0;                 /* 很暗：黑 */
+    if (minc > 210) return 7;                /* 很亮：白 */
+    if ((maxc - minc) < 20) return (avg > 140) ? 7 : 0; /* 近灰 */
+
+    bool rh = (r > 160), gh = (g > 160), bh = (b > 160);
+    if (rh && gh && bh) return 7;
+    if (rh && gh && !bh) return 3;
+    if (rh && !gh && bh) return 5;
+    if (!rh && gh && bh) return 6;
+    if (rh && !gh && !bh) return 1;
+    if (!rh && gh && !bh) return 2;
+    if (!rh && !gh && bh) return 4;
+
+    /* fallback: 选最大通道 */
+    if (r >= g && r >= b) return 1;
+    if (g >= r && g >= b) return 2;
+    return 4;
+}
+
+int term_xterm256_to_ansi8(int n) {
+    if (n < 0) return 7;
+    if (n < 8) return n;
+    if (n < 16) return n - 8; /* bright -> 近似为基础色 */
+    if (n >= 232 && n <= 255) {
+        int level = 8 + (n - 232) * 10; /* 8..238 */
+        return (level > 128) ? 7 : 0;
+    }
+    if (n >= 16 && n <= 231) {
+        int x = n - 16;
+        int rr = x / 36;
+        int gg = (x % 36) / 6;
+        int bb = x % 6;
+        int r = rr * 51;
+        int g = gg * 51;
+        int b = bb * 51;
+        return term_rgb_to_ansi8(r, g, b);
+    }
+    return 7;
+}
+
+static void term_apply_sgr(TermView *t, int code) {
+    if (!t) return;
+    TermStyle *pen = &t->pen;
+
+    /* reset */
+    if (code == 0) { pen->fg = pen->bg = 0; pen->flags = 0; return; }
+
+    /* basic attrs */
+    switch (code) {
+        case 1:  pen->flags |= TVA_BOLD; break;
+        case 2:  pen->flags |= TVA_DIM; break;
+        case 4:  pen->flags |= TVA_UNDERLINE; break;
+        case 7:  pen->flags |= TVA_REVERSE; break;
+        case 22: pen->flags &= (uint16_t)~(TVA_BOLD | TVA_DIM); break;
+        case 24: pen->flags &= (uint16_t)~TVA_UNDERLINE; break;
+        case 27: pen->flags &= (uint16_t)~TVA_REVERSE; break;
+        case 39: pen->fg = 0; break;
+        case 49: pen->bg = 0; break;
+        default: break;
+    }
+
+    /* 8-color and bright fg/bg: palette 0..7 / 8..15 */
+    if (code >= 30 && code <= 37)   pen->fg = TERM_COLOR_IDX | (uint32_t)(code - 30);
+    if (code >= 40 && code <= 47)   pen->bg = TERM_COLOR_IDX | (uint32_t)(code - 40);
+    if (code >= 90 && code <= 97)   pen->fg = TERM_COLOR_IDX | (uint32_t)(code - 90 + 8);
+    if (code >= 100 && code <= 107) pen->bg = TERM_COLOR_IDX | (uint32_t)(code - 100 + 8);
+}
+
+/* =========================
+ *  Escape sequence parser
+ *  DEC VT500 状态机模型（vt100.net: "A parser for DEC's ANSI-compatible
+ *  video terminals"）：
+ *  - 每个状态一张 256 项转移表（首次使用时由区间规则生成）：动作 + 下一状态
+ *  - 参数在同一遍扫描中解析进 vt_params[]，支持 ':' 子参数
+ *  - C0 / ESC / CSI 各用一张函数表分派；不支持的序列被完整吞掉
+ *    （DCS/APC/PM/SOS、带中间字节或私有前缀的 CSI），不会让后续输出错位
+ *  - UTF-8：>= 0x80 在 GROUND 中交给 term_put_u8 增量解码，不解释 8-bit C1
+ * ========================= */
+enum {
+    VT_GROUND = 0,
+    VT_ESCAPE, VT_ESCAPE_INTER,
+    VT_CSI_ENTRY, VT_CSI_PARAM, VT_CSI_INTER, VT_CSI_IGNORE,
+    VT_DCS_ENTRY, VT_DCS_PARAM, VT_DCS_INTER, VT_DCS_PASS, VT_DCS_IGNORE,
+    VT_OSC_STRING, VT_SOS_STRING,
+    VT_NSTATES,
+    VT_STAY = 0xF      /* transition without a state change */
+};
+
+enum {
+    VA_IGNORE = 0, VA_PRINT, VA_EXECUTE, VA_COLLECT, VA_PARAM,
+    VA_ESC_DISPATCH, VA_CSI_DISPATCH, VA_OSC_END
+};
+
+#define VT_TR(act, st) ((uint8_t)(((act) << 4) | (st)))
+
+static uint8_t vt_table[VT_NSTATES][256];
+static bool    vt_table_ready;
+
+static void vt_rule(int st, int lo, int hi, int act, int next) {
+    for (int b = lo; b <= hi; b++) vt_table[st][b] = VT_TR(act, next);
+}
+
+/* C0 controls other than CAN/SUB/ESC (those are "anywhere" transitions). */
+static void vt_rule_c0(int st, int act) {
+    vt_rule(st, 0x00, 0x17, act, VT_STAY);
+    vt_rule(st, 0x19, 0x19, act, VT_STAY);
+    vt_rule(st, 0x1C, 0x1F, act, VT_STAY);
+}
+
+static void vt_table_build(void) {
+    for (int st = 0; st < VT_NSTATES; st++) vt_rule(st, 0x00, 0xFF, VA_IGNORE, VT_STAY);
+
+    vt_rule_c0(VT_GROUND, VA_EXECUTE);
+    vt_rule(VT_GROUND, 0x20, 0xFF, VA_PRINT, VT_STAY);
+
+    vt_rule_c0(VT_ESCAPE, VA_EXECUTE);
+    vt_rule(VT_ESCAPE, 0x20, 0x2F, VA_COLLECT, VT_ESCAPE_INTER);
+    vt_rule(VT_ESCAPE, 0x30, 0x7E, VA_ESC_DISPATCH, VT_GROUND);
+    vt_rule(VT_ESCAPE, 'P', 'P', VA_IGNORE, VT_DCS_ENTRY);
+    vt_rule(VT_ESCAPE, 'X', 'X', VA_IGNORE, VT_SOS_STRING);
+    vt_rule(VT_ESCAPE, '[', '[', VA_IGNORE, VT_CSI_ENTRY);
+    vt_rule(VT_ESCAPE, ']', ']', VA_IGNORE, VT_OSC_STRING);
+    vt_rule(VT_ESCAPE, '^', '_', VA_IGNORE, VT_SOS_STRING);
+
+    vt_rule_c0(VT_ESCAPE_INTER, VA_EXECUTE);
+    vt_rule(VT_ESCAPE_INTER, 0x20, 0x2F, VA_COLLECT, VT_STAY);
+    vt_rule(VT_ESCAPE_INTER, 0x30, 0x7E, VA_ESC_DISPATCH, VT_GROUND);
+
+    /* ':' is accepted as a sub-parameter separator (SGR 38:2::r:g:b) */
+    vt_rule_c0(VT_CSI_ENTRY, VA_EXECUTE);
+    vt_rule(VT_CSI_ENTRY, 0x20, 0x2F, VA_COLLECT, VT_CSI_INTER);
+    vt_rule(VT_CSI_ENTRY, 0x30, 0x3B, VA_PARAM, VT_CSI_PARAM);
+    vt_rule(VT_CSI_ENTRY, 0x3C, 0x3F, VA_COLLECT, VT_CSI_PARAM);
+    vt_rule(VT_CSI_ENTRY, 0x40, 0x7E, VA_CSI_DISPATCH, VT_GROUND);
+
+    vt_rule_c0(VT_CSI_PARAM, VA_EXECUTE);
+    vt_rule(VT_CSI_PARAM, 0x20, 0x2F, VA_COLLECT, VT_CSI_INTER);
+    vt_rule(VT_CSI_PARAM, 0x30, 0x3B, VA_PARAM, VT_STAY);
+    vt_rule(VT_CSI_PARAM, 0x3C, 0x3F, VA_IGNORE, VT_CSI_IGNORE);
+    vt_rule(VT_CSI_PARAM, 0x40, 0x7E, VA_CSI_DISPATCH, VT_GROUND);
+
+    vt_rule_c0(VT_CSI_INTER, VA_EXECUTE);
+    vt_rule(VT_CSI_INTER, 0x20, 0x2F, VA_COLLECT, VT_STAY);
+    vt_rule(VT_CSI_INTER, 0x30, 0x3F, VA_IGNORE, VT_CSI_IGNORE);
+    vt_rule(VT_CSI_INTER, 0x40, 0x7E, VA_CSI_DISPATCH, VT_GROUND);
+
+    vt_rule_c0(VT_CSI_IGNORE, VA_EXECUTE);
+    vt_rule(VT_CSI_IGNORE, 0x40, 0x7E, VA_IGNORE, VT_GROUND);
+
+    /* DCS is parsed to its end but not interpreted (no hook handlers) */
+    vt_rule(VT_DCS_ENTRY, 0x20, 0x2F, VA_COLLECT, VT_DCS_INTER);
+    vt_rule(VT_DCS_ENTRY, 0x30, 0x39, VA_PARAM, VT_DCS_PARAM);
+    vt_rule(VT_DCS_ENTRY, 0x3A, 0x3A, VA_IGNORE, VT_DCS_IGNORE);
+    vt_rule(VT_DCS_ENTRY, 0x3B, 0x3B, VA_PARAM, VT_DCS_PARAM);
+    vt_rule(VT_DCS_ENTRY, 0x3C, 0x3F, VA_COLLECT, VT_DCS_PARAM);
+    vt_rule(VT_DCS_ENTRY, 0x40, 0x7E, VA_IGNORE, VT_DCS_PASS);
+
+    vt_rule(VT_DCS_PARAM, 0x20, 0x2F, VA_COLLECT, VT_DCS_INTER);
+    vt_rule(VT_DCS_PARAM, 0x30, 0x39, VA_PARAM, VT_STAY);
+    vt_rule(VT_DCS_PARAM, 0x3A, 0x3A, VA_IGNORE, VT_DCS_IGNORE);
+    vt_rule(VT_DCS_PARAM, 0x3B, 0x3B, VA_PARAM, VT_STAY);
+    vt_rule(VT_DCS_PARAM, 0x3C, 0x3F, VA_IGNORE, VT_DCS_IGNORE);
+    vt_rule(VT_DCS_PARAM, 0x40, 0x7E, VA_IGNORE, VT_DCS_PASS);
+
+    vt_rule(VT_DCS_INTER, 0x20, 0x2F, VA_COLLECT, VT_STAY);
+    vt_rule(VT_DCS_INTER, 0x30, 0x3F, VA_IGNORE, VT_DCS_IGNORE);
+    vt_rule(VT_DCS_INTER, 0x40, 0x7E, VA_IGNORE, VT_DCS_PASS);
+
+    /* OSC: BEL or ST (ESC \) terminates; the payload bytes are collected
+     * in term_feed, only TERM_OSC_APP is interpreted */
+    vt_rule(VT_OSC_STRING, 0x07, 0x07, VA_OSC_END, VT_GROUND);
+
+    /* anywhere: CAN/SUB abort, ESC restarts */
+    for (int st = 0; st < VT_NSTATES; st++) {
+        vt_rule(st, 0x18, 0x18, VA_EXECUTE, VT_GROUND);
+        vt_rule(st, 0x1A, 0x1A, VA_EXECUTE, VT_GROUND);
+        vt_rule(st, 0x1B, 0x1B, VA_IGNORE, VT_ESCAPE);
+    }
+    /* ESC ends the string; the '\\' of ST is then a no-op ESC dispatch */
+    vt_rule(VT_OSC_STRING, 0x1B, 0x1B, VA_OSC_END, VT_ESCAPE);
+    vt_table_ready = true;
+}
+
+static void vt_clear(TermView *t) {
+    t->vt_nparams = 0;
+    t->vt_sub = 0;
+    t->vt_priv = 0;
+    t->vt_ninter = 0;
+}
+
+static void vt_param(TermView *t, unsigned char ch) {
+    if (t->vt_nparams == 0) { t->vt_params[0] = 0; t->vt_nparams = 1; }
+    if (ch >= '0' && ch <= '9') {
+        int *v = &t->vt_params[t->vt_nparams - 1];
+        if (*v < 10000) *v = *v * 10 + (ch - '0');
+        return;
+    }
+    /* ';' or ':' starts the next parameter; extra parameters are dropped */
+    if (t->vt_nparams >= TERM_MAX_PARAMS) return;
+    if (ch == ':') t->vt_sub |= (uint32_t)1u << t->vt_nparams;
+    t->vt_params[t->vt_nparams++] = 0;
+}
+
+static void vt_collect(TermView *t, unsigned char ch) {
+    if (ch >= 0x3C && ch <= 0x3F) { t->vt_priv = (char)ch; return; }
+    if (t->vt_ninter < (int)sizeof(t->vt_inter)) t->vt_inter[t->vt_ninter] = (char)ch;
+    if (t->vt_ninter <= (int)sizeof(t->vt_inter)) t->vt_ninter++; /* > size: too many, ignored */
+}
+
+/* Parameter i, or def when absent or 0 (ECMA-48 default). */
+static inline int vt_arg(const TermView *t, int i, int def) {
+    return (i < t->vt_nparams && t->vt_params[i] != 0) ? t->vt_params[i] : def;
+}
+
+static inline bool vt_is_sub(const TermView *t, int i) {
+    return i < t->vt_nparams && (t->vt_sub & ((uint32_t)1u << i));
+}
+
+/* ----- C0 controls ----- */
+static void term_c0_bs(TermView *t) { t->wrap_pending = false; if (t->cx > 0) t->cx--; }
+static void term_c0_cr(TermView *t) { t->cx = 0; t->wrap_pending = false; }
+static void term_c0_so(TermView *t) { t->use_g1 = true; }   /* shift out: GL = G1 */
+static void term_c0_si(TermView *t) { t->use_g1 = false; }  /* shift in:  GL = G0 */
+
+static void term_c0_ht(TermView *t) {
+    t->wrap_pending = false;
+    int next = ((t->cx / 8) + 1) * 8;
+    if (next >= t->cols) next = t->cols - 1;
+    t->cx = next;
+}
+
+typedef void (*TermFn)(TermView *t);
+
+static const TermFn term_c0_fns[0x20] = {
+    [0x08] = term_c0_bs,
+    [0x09] = term_c0_ht,
+    [0x0A] = term_lf,   /* LF, VT, FF */
+    [0x0B] = term_lf,
+    [0x0C] = term_lf,
+    [0x0D] = term_c0_cr,
+    [0x0E] = term_c0_so,
+    [0x0F] = term_c0_si,
+};
+
+/* ----- ESC sequences without intermediates ----- */
+static void term_esc_ris(TermView *t)  { term_clear_all(t); t->wrap_pending = false; }
+static void term_esc_sc(TermView *t)   { t->wrap_pending = false; t->saved_cx = t->cx; t->saved_cy = t->cy; }
+static void term_esc_rc(TermView *t)   { t->wrap_pending = false; t->cx = t->saved_cx; t->cy = t->saved_cy; }
+static void term_esc_nel(TermView *t)  { t->cx = 0; term_lf(t); }
+static void term_esc_deckpam(TermView *t) { t->app_keypad = true; }
+static void term_esc_deckpnm(TermView *t) { t->app_keypad = false; }
+
+static const TermFn term_esc_fns[0x4F] = {
+    ['7' - 0x30] = term_esc_sc,
+    ['8' - 0x30] = term_esc_rc,
+    ['=' - 0x30] = term_esc_deckpam,
+    ['>' - 0x30] = term_esc_deckpnm,
+    ['D' - 0x30] = term_lf,       /* IND */
+    ['E' - 0x30] = term_esc_nel,
+    ['M' - 0x30] = term_ri,       /* RI */
+    ['c' - 0x30] = term_esc_ris,
+};
+
+static void term_esc_dispatch(TermView *t, unsigned char final) {
+    if (t->vt_ninter == 0) {
+        TermFn fn = term_esc_fns[final - 0x30];
+        if (fn) fn(t);
+        return;
+    }
+    /* ESC ( X / ESC ) X: designate G0/G1 charset */
+    if (t->vt_ninter == 1 && (t->vt_inter[0] == '(' || t->vt_inter[0] == ')')) {
+        uint8_t *dst = (t->vt_inter[0] == '(') ? &t->g0_charset : &t->g1_charset;
+        if (final == '0') *dst = 1;       /* line drawing */
+        else *dst = 0;                    /* ASCII / national sets -> ASCII */
+    }
+}
+
+/* ----- CSI sequences ----- */
+static void term_csi_cup(TermView *t) {
+    t->cy = vt_arg(t, 0, 1) - 1;
+    t->cx = vt_arg(t, 1, 1) - 1;
+    if (t->cy >= t->rows) t->cy = t->rows - 1;
+    if (t->cx >= t->cols) t->cx = t->cols - 1;
+}
+static void term_csi_cuu(TermView *t) { t->cy -= vt_arg(t, 0, 1); if (t->cy < 0) t->cy = 0; }
+static void term_csi_cud(TermView *t) { t->cy += vt_arg(t, 0, 1); if (t->cy >= t->rows) t->cy = t->rows - 1; }
+static void term_csi_cuf(TermView *t) { t->cx += vt_arg(t, 0, 1); if (t->cx >= t->cols) t->cx = t->cols - 1; }
+static void term_csi_cub(TermView *t) { t->cx -= vt_arg(t, 0, 1); if (t->cx < 0) t->cx = 0; }
+static void term_csi_cha(TermView *t) { t->cx = vt_arg(t, 0, 1) - 1; if (t->cx >= t->cols) t->cx = t->cols - 1; }
+static void term_csi_vpa(TermView *t) { t->cy = vt_arg(t, 0, 1) - 1; if (t->cy >= t->rows) t->cy = t->rows - 1; }
+static void term_csi_cnl(TermView *t) { term_csi_cud(t); t->cx = 0; }
+static void term_csi_cpl(TermView *t) { term_csi_cuu(t); t->cx = 0; }
+
+static void term_csi_ed(TermView *t) {
+    /* ED: do NOT reset modes/state (ncurses relies on this). */
+    switch (vt_arg(t, 0, 0)) {
+        case 0: term_clear_screen_from(t); break;
+        case 1: term_clear_screen_to(t); break;
+        case 2: term_erase_all_keep_modes(t); break;
+        default: break;
+    }
+}
+
+static void term_csi_el(TermView *t) {
+    /* EL: do NOT move cursor. */
+    switch (vt_arg(t, 0, 0)) {
+        case 0: term_clear_line_from(t, t->cx); break;
+        case 1: term_clear_line_to(t, t->cx); break;
+        case 2: term_clear_line_from(t, 0); break;
+        default: break;
+    }
+}
+
+static void term_csi_decstbm(TermView *t) {
+    /* DECSTBM: set scrolling region (top/bottom, inclusive). */
+    int top = vt_arg(t, 0, 1);
+    int bot = vt_arg(t, 1, t->rows);
+    if (top > t->rows) top = t->rows;
+    if (bot > t->rows) bot = t->rows;
+    if (top >= bot) {
+        t->scroll_top = 0;
+        t->scroll_bottom = t->rows - 1;
+    } else {
+        t->scroll_top = top - 1;
+        t->scroll_bottom = bot - 1;
+    }
+    /* xterm/vt100 moves cursor to home after setting margins */
+    t->cx = 0;
+    t->cy = 0;
+}
+
+static void term_csi_il(TermView *t)  { term_insert_lines(t, vt_arg(t, 0, 1)); }
+static void term_csi_dl(TermView *t)  { term_delete_lines(t, vt_arg(t, 0, 1)); }
+static void term_csi_ich(TermView *t) { term_insert_chars(t, vt_arg(t, 0, 1)); }
+static void term_csi_dch(TermView *t) { term_delete_chars(t, vt_arg(t, 0, 1)); }
+static void term_csi_ech(TermView *t) { term_erase_chars(t, vt_arg(t, 0, 1)); }
+
+static void term_csi_su(TermView *t) {
+    int top, bottom;
+    term_get_region(t, &top, &bottom);
+    term_scroll_up_region(t, top, bottom, vt_arg(t, 0, 1));
+}
+
+static void term_csi_sd(TermView *t) {
+    int top, bottom;
+    term_get_region(t, &top, &bottom);
+    term_scroll_down_region(t, top, bottom, vt_arg(t, 0, 1));
+}
+
+static void term_csi_scosc(TermView *t) { t->saved_cx = t->cx; t->saved_cy = t->cy; }
+static void term_csi_scorc(TermView *t) { t->cx = t->saved_cx; t->cy = t->saved_cy; }
+
+/* 38/48 extended color starting at params[i]; returns the last parameter
+ * consumed and sets *color (TERM_COLOR_*, 0 if unsupported). Accepts
+ * 38;5;n, 38;2;r;g;b and the colon forms 38:5:n, 38:2:r:g:b, 38:2:cs:r:g:b. */
+static int term_sgr_color(const TermView *t, int i, uint32_t *color) {
+    bool colon = vt_is_sub(t, i + 1);
+    int mode = (i + 1 < t->vt_nparams) ? t->vt_params[i + 1] : 0;
+    int j = i + 2;
+    if (colon) {
+        int nsub = 0;
+        while (vt_is_sub(t, i + 1 + nsub)) nsub++;
+        /* 38:2:cs:r:g:b carries a color-space id first */
+        if (mode == 2 && nsub >= 5) j++;
+    }
+    if (mode == 5) {
+        int n = j < t->vt_nparams ? t->vt_params[j] : 0;
+        *color = TERM_COLOR_IDX | (uint32_t)(n & 0xFF);
+        return j;
+    }
+    if (mode == 2) {
+        int r = j     < t->vt_nparams ? t->vt_params[j]     : 0;
+        int g = j + 1 < t->vt_nparams ? t->vt_params[j + 1] : 0;
+        int b = j + 2 < t->vt_nparams ? t->vt_params[j + 2] : 0;
+        *color = TERM_COLOR_RGB | ((uint32_t)(r & 0xFF) << 16) | ((uint32_t)(g & 0xFF) << 8) | (uint32_t)(b & 0xFF);
+        return j + 2;
+    }
+    /* unsupported color model: skip its sub-parameters */
+    *color = 0;
+    int k = i;
+    while (vt_is_sub(t, k + 1)) k++;
+    return k;
+}
+
+static void term_csi_sgr(TermView *t) {
+    /* SGR: 多参数 + 颜色（30/40/90/100 + 38;5;n / 48;5;n / 38;2;r;g;b 及 ':' 形式） */
+    if (t->vt_nparams == 0) term_apply_sgr(t, 0);
+    for (int i = 0; i < t->vt_nparams; i++) {
+        int v = t->vt_params[i];
+        if (v == 38 || v == 48) {
+            uint32_t color = 0;
+            i = term_sgr_color(t, i, &color);
+            if (color) {
+                if (v == 38) t->pen.fg = color;
+                else         t->pen.bg = color;
+            }
+            continue;
+        }
+        term_apply_sgr(t, v);
+        /* e.g. 4:3 (curly underline): keep the main attribute only */
+        while (vt_is_sub(t, i + 1)) i++;
+    }
+    t->cur_attr = term_style_id(t, t->pen.fg, t->pen.bg, t->pen.flags);
+}
+
+static void term_csi_decset(TermView *t, bool set) {
+    for (int i = 0; i < t->vt_nparams; i++) {
+        switch (t->vt_params[i]) {
+            case 1:    t->app_cursor = set; break;       /* DECCKM: application cursor keys */
+            case 2004: t->bracketed_paste = set; break;  /* pastes wrapped in ESC[200~ ... ESC[201~ */
+            case 2026: t->sync_update = set; break;      /* synchronized output: frame begin/end */
+            case 47:
+            case 1047:
+            case 1049:
+                term_alt_screen(t, t->vt_params[i], set);
+                break;
+            default: break;
+        }
+    }
+}
+
+/* Queue an answer for the child; dropped if the buffer is full (a child
+ * that floods queries without reading has no use for the answers). */
+static void term_reply(TermView *t, const char *fmt, ...) {
+    char tmp[64];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (n <= 0 || n >= (int)sizeof(tmp) || t->reply_len + n > (int)sizeof(t->reply)) return;
+    memcpy(t->reply + t->reply_len, tmp, (size_t)n);
+    t->reply_len += n;
+}
+
+/* DECRQM (CSI ? Ps $ p): report a private mode as set (1), reset (2) or
+ * unknown (0). This is how a child finds out that mode 2026 is supported. */
+static void term_csi_decrqm(TermView *t) {
+    int mode = t->vt_nparams > 0 ? t->vt_params[0] : 0;
+    int st;
+    switch (mode) {
+        case 1:    st = t->app_cursor ? 1 : 2; break;
+        case 2004: st = t->bracketed_paste ? 1 : 2; break;
+        case 2026: st = t->sync_update ? 1 : 2; break;
+        default:   st = 0; break;
+    }
+    term_reply(t, "\x1b[?%d;%d$y", mode, st);
+}
+
+/* =========================
+ *  Query responder
+ *  子进程发出查询后会阻塞等待回答（超时才继续），不回答会拖慢启动：
+ *  - DSR 5n/6n、DECXCPR ?6n：状态和光标位置
+ *  - DA1/DA2、XTVERSION：终端类型（VT220 + 颜色）
+ *  - XTWINOPS 18t/19t：文本区大小
+ *  回答放进 t->reply，term_feed 之后由 hot 层写回 pty
+ * ========================= */
+static void term_csi_dsr(TermView *t) {
+    switch (vt_arg(t, 0, 0)) {
+        case 5: term_reply(t, "\x1b[0n"); break;
+        case 6: term_reply(t, "\x1b[%d;%dR", t->cy + 1, t->cx + 1); break;
+        default: break;
+    }
+}
+
+static void term_csi_da(TermView *t) {
+    if (vt_arg(t, 0, 0) == 0) term_reply(t, "\x1b[?62;22c"); /* VT220, ANSI color */
+}
+
+static void term_csi_xtwinops(TermView *t) {
+    int op = vt_arg(t, 0, 0);
+    if (op == 18 || op == 19) term_reply(t, "\x1b[%d;%d;%dt", op - 10, t->rows, t->cols);
+}
+
+/* Queries with a private marker: DECXCPR, DA2, XTVERSION. */
+static void term_csi_query_priv(TermView *t, unsigned char final) {
+    if (t->vt_priv == '?' && final == 'n' && vt_arg(t, 0, 0) == 6)
+        term_reply(t, "\x1b[?%d;%dR", t->cy + 1, t->cx + 1);
+    else if (t->vt_priv == '>' && final == 'c' && vt_arg(t, 0, 0) == 0)
+        term_reply(t, "\x1b[>1;10;0c");
+    else if (t->vt_priv == '>' && final == 'q' && vt_arg(t, 0, 0) == 0)
+        term_reply(t, "\x1bP>|perftui\x1b\\");
+}
+
+static const TermFn term_csi_fns[0x3F] = {
+    ['@' - 0x40] = term_csi_ich,
+    ['A' - 0x40] = term_csi_cuu,
+    ['B' - 0x40] = term_csi_cud,
+    ['C' - 0x40] = term_csi_cuf,
+    ['D' - 0x40] = term_csi_cub,
+    ['E' - 0x40] = term_csi_cnl,
+    ['F' - 0x40] = term_csi_cpl,
+    ['G' - 0x40] = term_csi_cha,
+    ['H' - 0x40] = term_csi_cup,
+    ['J' - 0x40] = term_csi_ed,
+    ['K' - 0x40] = term_csi_el,
+    ['L' - 0x40] = term_csi_il,
+    ['M' - 0x40] = term_csi_dl,
+    ['P' - 0x40] = term_csi_dch,
+    ['S' - 0x40] = term_csi_su,
+    ['T' - 0x40] = term_csi_sd,
+    ['X' - 0x40] = term_csi_ech,
+    ['c' - 0x40] = term_csi_da,
+    ['d' - 0x40] = term_csi_vpa,
+    ['f' - 0x40] = term_csi_cup,
+    ['m' - 0x40] = term_csi_sgr,
+    ['n' - 0x40] = term_csi_dsr,
+    ['r' - 0x40] = term_csi_decstbm,
+    ['s' - 0x40] = term_csi_scosc,
+    ['t' - 0x40] = term_csi_xtwinops,
+    ['u' - 0x40] = term_csi_scorc,
+};
+
+static void term_csi_dispatch(TermView *t, unsigned char final) {
+    if (final != 'm') t->wrap_pending = false;
+    if (t->vt_ninter > (int)sizeof(t->vt_inter)) return;
+    if (t->vt_priv == '?' && t->vt_ninter == 0 && (final == 'h' || final == 'l')) {
+        term_csi_decset(t, final == 'h');
+        return;
+    }
+    if (t->vt_priv == '?' && t->vt_ninter == 1 && t->vt_inter[0] == '$' && final == 'p') {
+        term_csi_decrqm(t);
+        return;
+    }
+    if (t->vt_priv && t->vt_ninter == 0) {
+        term_csi_query_priv(t, final);
+        return;
+    }
+    /* other intermediates (DECSCUSR, ...): ignored */
+    if (t->vt_priv || t->vt_ninter) return;
+    TermFn fn = term_csi_fns[final - 0x40];
+    if (fn) fn(t);
+}
+
+/* ----- OSC strings ----- */
+static void term_osc_put(TermView *t, const unsigned char *s, int n) {
+    if (t->osc_len > TERM_OSC_MAX) return;
+    if (t->osc_len + n > TERM_OSC_MAX) { t->osc_len = TERM_OSC_MAX + 1; return; }
+    if (!t->osc) {
+        t->osc = (char*)malloc(TERM_OSC_MAX);
+        if (!t->osc) { perror("malloc"); exit(1); }
+    }
+    memcpy(t->osc + t->osc_len, s, (size_t)n);
+    t->osc_len += n;
+}
+
+/* "7717;<payload>": queue the payload for the caller. Other OSCs (window
+ * title, palette, hyperlinks, ...) have no effect on the emulated screen. */
+static void term_osc_end(TermView *t) {
+    int n = t->osc_len;
+    t->osc_len = 0;
+    if (n > TERM_OSC_MAX) return;
+    int num = 0, i = 0;
+    while (i < n && i < 6 && t->osc[i] >= '0' && t->osc[i] <= '9') num = num * 10 + (t->osc[i++] - '0');
+    if (num != TERM_OSC_APP || i >= n || t->osc[i] != ';') return;
+    i++;
+    int len = n - i;
+    if (t->app_len + len + 1 > t->app_cap) {
+        if (t->app_len + len + 1 > TERM_APP_MAX) return;
+        int nc = t->app_cap ? t->app_cap * 2 : 1024;
+        while (nc < t->app_len + len + 1) nc *= 2;
+        if (nc > TERM_APP_MAX) nc = TERM_APP_MAX;
+        char *nb = (char*)realloc(t->app, (size_t)nc);
+        if (!nb) { perror("realloc"); exit(1); }
+        t->app = nb;
+        t->app_cap = nc;
+    }
+    memcpy(t->app + t->app_len, t->osc + i, (size_t)len);
+    t->app_len += len;
+    t->app[t->app_len++] = 0;
+}
+
+void term_feed(TermView *t, const unsigned char *buf, int n) {
+    if (!t || !buf || n <= 0) return;
+    if (!vt_table_ready) vt_table_build();
+    for (int k = 0; k < n; k++) {
+        unsigned char ch = buf[k];
+
+        if (t->vt_state == VT_GROUND && ch >= 0x20) {
+            if (ch >= 0x80 || t->u8_need) { term_put_u8(t, ch); continue; }
+            size_t run = term_printable_span(buf + k, (size_t)(n - k));
+            if (run > 1) term_put_run(t, buf + k, (int)run);
+            else term_put_cp(t, ch);
+            k += (int)run - 1;
+            continue;
+        }
+        if (t->vt_state == VT_OSC_STRING && ch >= 0x20) {
+            int run = 1;
+            while (k + run < n && buf[k + run] >= 0x20) run++;
+            term_osc_put(t, buf + k, run);
+            k += run - 1;
+            continue;
+        }
+        if (t->u8_need) { t->u8_need = 0; term_put_cp(t, 0xFFFD); } /* cut by a control */
+
+        uint8_t tr = vt_table[t->vt_state][ch];
+        int next = tr & 0xF;
+        switch (tr >> 4) {
+            case VA_PRINT:        term_put_u8(t, ch); break;
+            case VA_EXECUTE:      if (ch < 0x20 && term_c0_fns[ch]) term_c0_fns[ch](t); break;
+            case VA_COLLECT:      vt_collect(t, ch); break;
+            case VA_PARAM:        vt_param(t, ch); break;
+            case VA_ESC_DISPATCH: term_esc_dispatch(t, ch); break;
+            case VA_CSI_DISPATCH: term_csi_dispatch(t, ch); break;
+            case VA_OSC_END:      term_osc_end(t); break;
+            default: break;
+        }
+        if (next != VT_STAY) {
+            t->vt_state = (uint8_t)next;
+            if (next == VT_ESCAPE || next == VT_CSI_ENTRY || next == VT_DCS_ENTRY) vt_clear(t);
+            else if (next == VT_OSC_STRING) t->osc_len = 0;
+        }
+    }
+}
+
+/* Backlog fast-forward: find how much of buf can be skipped without changing
+ * the screen that term_feed(buf) would produce.
+ *
+ * Only the plain-text prefix of buf is considered (printables plus CR/LF/TAB/
+ * BS/BEL: nothing there touches attrs, modes or margins). With a full-screen
+ * scroll region, once a "\r\n" has been followed by >= rows more line feeds,
+ * every row on screen has been scrolled in afterwards, so everything before
+ * that "\r\n" is invisible. It is enough to know that the cursor sits at
+ * column 0 of the bottom row there, which holds as long as the skipped part
+ * itself contains >= rows line feeds.
+ *
+ * With scrollback on the primary screen, skipped lines would also be missing
+ * from the history. Every kept line costs at least one 4-byte index entry, so
+ * the history never holds more than max_bytes / 4 lines: only what lies
+ * beyond that many further line feeds is dropped (it would be evicted
+ * anyway). With the default cap that is rarely anything.
+ *
+ * Returns the number of leading bytes to drop (0 = feed everything) and puts
+ * the cursor where the skipped bytes would have left it. */
+int term_ff_skip(TermView *t, const unsigned char *buf, int n) {
+    if (!t || !t->cells || !buf || n <= 0) return 0;
+    if (t->vt_state != VT_GROUND || t->u8_need) return 0;
+    if (t->scroll_top != 0 || t->scroll_bottom != t->rows - 1) return 0;
+
+    int rows = t->rows;
+    /* line feeds that must follow the skipped part */
+    int64_t keep = rows;
+    if (t->sb && !t->alt_active) keep += (int64_t)(t->sb->max_bytes / sizeof(uint32_t));
+    if (keep > n) return 0;
+    int plain = 0, lf_head = 0, first_ok = -1;
+    for (; plain < n; plain++) {
+        unsigned char ch = buf[plain];
+        if (ch >= 0x20) continue;
+        if (ch == '\n') {
+            if (++lf_head == rows) first_ok = plain; /* earliest usable LF */
+            continue;
+        }
+        if (ch == '\r' || ch == '\t' || ch == '\b' || ch == 0x07) continue;
+        break;
+    }
+    if (first_ok < 0) return 0;
+
+    int lf_tail = 0;
+    for (int i = plain - 1; i >= first_ok; i--) {
+        if (buf[i] != '\n') continue;
+        if (lf_tail >= keep && i > 0 && buf[i - 1] == '\r') {
+            t->cy = rows - 1;
+            t->cx = 0;
+            t->wrap_pending = false;
+            return i + 1;
+        }
+        lf_tail++;
+    }
+    return 0;
+}
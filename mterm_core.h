@@ -0,0 +1,211 @@
+#ifndef MTERM_CORE_H
+#define MTERM_CORE_H
+
+/* VT emulator core: escape parser, screen buffers and scrollback. Nothing
+ * here depends on curses; mterm.c draws a TermView into a curses window and
+ * mterm_bench replays captured pty output through it headless. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TERM_MAX_PARAMS 16
+
+/* Scrollback: lines scrolled off the top, packed (trailing blanks trimmed,
+ * attribute runs, blank lines as an index entry only) into fixed-size
+ * blocks; the oldest block is dropped at the memory cap. */
+typedef struct {
+    unsigned char *data;
+    size_t    len;
+    uint32_t *offs;       /* per line: record offset, or UINT32_MAX if blank */
+    int       nlines, cap_lines;
+} TermSbBlock;
+
+typedef struct {
+    TermSbBlock *blocks;  /* oldest first */
+    int       nblocks, cap_blocks;
+    size_t    bytes, max_bytes;
+    uint64_t  base;       /* absolute number of the oldest kept line */
+    int       nlines;
+    TermSbBlock spare;    /* last dropped block, reused for the next one */
+} TermScrollback;
+
+/* Colors as set by SGR: 0 = terminal default, else one of */
+#define TERM_COLOR_IDX 0x01000000u  /* | n: xterm 256-color palette index */
+#define TERM_COLOR_RGB 0x02000000u  /* | 0xRRGGBB: 24-bit */
+
+/* Style flags */
+#define TVA_REVERSE   0x01
+#define TVA_BOLD      0x02
+#define TVA_UNDERLINE 0x04
+#define TVA_DIM       0x08
+
+/* Cell attributes are ids into a per-view style table; id 0 is the
+ * default style. The renderer's translation (curses colors, attributes
+ * and pair in mterm.c) is filled in when a style is first drawn and kept,
+ * so drawing does no per-cell color work. The core never reads it. */
+typedef struct {
+    uint32_t fg, bg;     /* TERM_COLOR_* or 0 */
+    uint16_t flags;      /* TVA_* */
+
+    bool     resolved;   /* cfg/cbg/cattr valid */
+    int      cfg, cbg;   /* renderer color numbers, -1 = default */
+    uint32_t cattr;      /* renderer attributes (curses attr_t) */
+    int      pair;       /* last pair handed out for (cfg, cbg), 0 = none */
+} TermStyle;
+
+#define TERM_STYLE_MAX 65535
+
+/* One screen cell (8 bytes). A double-width character occupies two cells:
+ * the left one has width 2, the right one width 0 and ch 0. */
+typedef struct {
+    uint32_t ch;        /* Unicode code point */
+    uint16_t attr;      /* style id */
+    uint8_t  width;     /* 1, 2, or 0 for the right half of a wide char */
+    uint8_t  pad;
+} TermCell;
+
+typedef struct {
+    int rows, cols;
+    TermCell *cells;
+    uint8_t  *dirty;    /* per row: changed since the last term_draw */
+    int      *rowmap;   /* logical row -> storage row (scrolls rotate it) */
+    int      *rowext;   /* per storage row: cells from here on are default blanks */
+    TermScrollback *sb; /* NULL: no history kept */
+
+    /* The screen not shown (alternate while on the primary and vice versa);
+     * DEC modes 47/1047/1049 swap it with cells/rowmap/rowext. Allocated on
+     * first use. */
+    TermCell *alt_cells;
+    int      *alt_rowmap;
+    int      *alt_rowext;
+    bool      alt_active;       /* the alternate screen is shown */
+    int       alt_saved_cx, alt_saved_cy; /* cursor saved by 1049 */
+
+    uint16_t  cur_attr; /* style id of pen */
+    TermStyle pen;      /* SGR state (fg, bg, flags) */
+
+    TermStyle *styles;    /* style id -> style */
+    int        nstyles, cap_styles;
+    int32_t   *style_hash;  /* open addressing over ids, -1 = empty */
+    int        style_hash_cap;
+    unsigned   pair_epoch;  /* renderer: color-pair generation of the last full draw */
+
+    uint8_t g0_charset;
+    uint8_t g1_charset;
+    bool    use_g1;
+
+    bool    app_cursor;
+    bool    app_keypad;
+    bool    bracketed_paste; /* DEC mode 2004 set by the child */
+    bool    sync_update;     /* DEC mode 2026: child is in the middle of a frame */
+
+    /* DECSTBM scroll region (inclusive). Ncurses apps (e.g. htop) rely on it,
+     * especially after resize where insert/delete-line is used in a region.
+     */
+    int     scroll_top;
+    int     scroll_bottom;
+
+    int cx, cy;
+    int saved_cx, saved_cy;
+    bool    wrap_pending; /* VT100 autowrap pending at last column */
+
+    /* UTF-8 decoder state, kept across term_feed calls (reads split
+     * characters anywhere) */
+    uint32_t u8_cp;
+    uint8_t  u8_need;     /* continuation bytes still expected */
+
+    /* escape parser state (VT500 model, see term_feed) */
+    uint8_t  vt_state;
+    char     vt_priv;        /* private marker '<' '=' '>' '?' or 0 */
+    char     vt_inter[2];    /* intermediate bytes */
+    int      vt_ninter;      /* > 2: too many, sequence is ignored */
+    int      vt_nparams;
+    uint32_t vt_sub;         /* bit i: vt_params[i] follows ':' */
+    int      vt_params[TERM_MAX_PARAMS];
+
+    /* answers to queries (DECRQM), sent to the child after term_feed */
+    char     reply[256];
+    int      reply_len;
+
+    /* OSC string being collected (TERM_OSC_MAX, allocated on first use);
+     * osc_len > TERM_OSC_MAX marks an overlong string that is dropped */
+    char    *osc;
+    int      osc_len;
+    /* private OSC TERM_OSC_APP messages received, each payload followed by
+     * a NUL; the caller consumes them after term_feed and resets app_len */
+    char    *app;
+    int      app_len, app_cap;
+} TermView;
+
+/* Private OSC for hot commands: ESC ] 7717 ; <key>=<text> (BEL or ST).
+ * The emulator only queues <key>=<text>; mterm.c defines the keys. */
+#define TERM_OSC_APP     7717
+#define TERM_OSC_MAX     4096
+#define TERM_APP_MAX     (64 * 1024)   /* queued bytes; later messages are dropped */
+
+#define TERM_SB_MAX_COLS 4096
+
+void   term_init(TermView *t, int rows, int cols);
+void   term_free(TermView *t);
+void   term_resize(TermView *t, int rows, int cols);
+void   term_clear_all(TermView *t);                    /* RIS */
+void   term_clear_screenbuf_keep_modes(TermView *t);
+size_t term_mem_bytes(const TermView *t);
+
+/* Emulate n bytes of child output. Answers to queries are appended to
+ * t->reply; the caller sends them to the child and resets reply_len.
+ * Private OSC messages are queued in t->app likewise. */
+void   term_feed(TermView *t, const unsigned char *buf, int n);
+/* Backlog fast-forward: leading bytes of buf that can be dropped without
+ * changing the resulting screen (see mterm_core.c). */
+int    term_ff_skip(TermView *t, const unsigned char *buf, int n);
+
+/* Logical row r -> its storage. Rows are reached through t->rowmap, so
+ * scrolling rotates row indices instead of moving cells. */
+static inline TermCell *term_row(const TermView *t, int r) {
+    return t->cells + (size_t)t->rowmap[r] * (size_t)t->cols;
+}
+
+/* Row extent: cells of a row at or past its rowext are blanks with the
+ * default attribute by definition and may hold stale data. Clearing a line
+ * to defaults (every scrolled-in line) only resets the extent; writers open
+ * the columns [from, to) they are about to store first. */
+static inline int term_ext(const TermView *t, int r) {
+    return t->rowext[t->rowmap[r]];
+}
+
+/* Scrollback (t->sb, NULL = off). Lines are numbered from 0 = oldest kept. */
+TermScrollback      *term_sb_new(size_t max_bytes);
+const unsigned char *term_sb_line(const TermScrollback *sb, int i);
+void    term_sb_decode(const unsigned char *rec, TermCell *cells, int cols);
+int64_t term_sb_search(const TermScrollback *sb, uint64_t before, const char *q, int *col);
+
+/* Session recordings (PERFTUI_HOT_RECORD, replayed by mterm_bench): a
+ * TermRecFileHdr and the command line, then records, each a TermRecHdr
+ * followed by len payload bytes. Integers are in host byte order. */
+#define TERM_REC_MAGIC  "PTREC1\n"   /* 8 bytes with the NUL */
+#define TERM_REC_OUTPUT 1u            /* payload: bytes the child wrote */
+#define TERM_REC_RESIZE 2u            /* payload: uint32_t rows, cols */
+
+typedef struct {
+    char     magic[8];
+    uint32_t rows, cols;        /* initial size */
+    uint64_t start_unix_us;     /* wall clock at start */
+    uint32_t cmd_len;           /* command line bytes after the header */
+    uint32_t pad;
+} TermRecFileHdr;
+
+typedef struct {
+    uint64_t t_us;              /* since the start (CLOCK_MONOTONIC) */
+    uint32_t kind;              /* TERM_REC_* */
+    uint32_t len;
+} TermRecHdr;
+
+/* Helpers shared with the renderer. */
+int term_u8_width(const char *s, int n);      /* display columns of UTF-8 text */
+int term_u8_put(char *d, uint32_t cp);        /* encode cp (<= 4 bytes), returns length */
+int term_rgb_to_xterm256(int r, int g, int b);
+int term_xterm256_to_ansi8(int n);
+
+#endif